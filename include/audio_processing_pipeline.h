@@ -1,5 +1,5 @@
-#ifndef IMAGE_PROCESS_PIPELINE_H
-#define IMAGE_PROCESS_PIPELINE_H
+#ifndef AUDIO_PROCESSING_PIPELINE_H
+#define AUDIO_PROCESSING_PIPELINE_H
 
 #include <iostream>
 //#include <Eigen/Dense>
@@ -11,6 +11,8 @@
 #include <fstream>
 #include <cstdlib>
 
+#include "model_registry.h"
+
 
 #define AUDIO_SAMPLE_RATE 22050
 #define AUDIO_WINDOW_SIZE 2048
@@ -19,9 +21,14 @@
 #define AUDIO_PCA_FEATURES 12
 #define AUDIO_PCA_COMPONENTS 12
 
+// The audio PCA basis in the model registry
+#define AUDIO_PCA_MODEL "audio_pca"
+#define AUDIO_PCA_COMPONENTS_PATH "./data/pca_components_audio.csv"
+#define AUDIO_PCA_MEAN_PATH "./data/mean_audio.csv"
 
-extern std::vector<std::vector<double>> __pca_components;
-extern std::vector<double> __mean_vector;
 
+// Registers and loads AUDIO_PCA_MODEL; exits if it cannot be loaded
 void audio_processing_init();
+// MFCC features of the loudest segment, projected onto the audio PCA basis
+void process_audio(const std::vector<float> &audio_data, int sample_rate, std::vector<double> &out_features);
 #endif
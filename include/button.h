@@ -0,0 +1,138 @@
+#ifndef BUTTON_H
+#define BUTTON_H
+
+#include <cstdint>
+#include <string>
+#include <deque>
+#include <mutex>
+
+#define BUTTON_GPIO 27
+#define BUTTON_GPIO_CHIP "/dev/gpiochip0"
+#define BUTTON_DEBOUNCE_US 5000
+#define BUTTON_POLL_INTERVAL_MS 10
+#define BUTTON_EVENT_BUFFER 16
+
+struct ButtonPress {
+    uint64_t timestamp_ns;  // CLOCK_MONOTONIC of the edge (when it was seen, for polled sources)
+    uint32_t seqno;         // counts presses, including ones nobody waited for
+};
+
+// Where presses of the capture button come from. The daemon watches fd() on
+// its reactor (or samples sources without one from a timer) and collects
+// presses with read_press(); wait_press() blocks on its own for tools and
+// tests.
+class ButtonSource {
+public:
+    ButtonSource();
+    virtual ~ButtonSource();
+
+    ButtonSource(const ButtonSource &) = delete;
+    ButtonSource &operator=(const ButtonSource &) = delete;
+
+    virtual const char *name() const = 0;
+
+    // Readable when a press may be waiting; -1 if the source has to be sampled
+    // every BUTTON_POLL_INTERVAL_MS instead
+    virtual int fd() const = 0;
+    // Take the next press without blocking; false if there is none
+    virtual bool read_press(ButtonPress &press) = 0;
+
+    // Block until a press, the timeout (-1 waits forever) or interrupt();
+    // returns true with the press, false on timeout or interrupt
+    bool wait_press(ButtonPress &press, int timeout_ms);
+
+    // Wake a thread blocked in wait_press(), e.g. to shut it down
+    void interrupt();
+
+protected:
+    // poll() fd (may be -1) together with the interrupt: 1 if fd is readable,
+    // 0 on timeout, -1 if interrupted
+    int wait_readable(int fd, int timeout_ms);
+
+    int wake_fd_ = -1;
+};
+
+// Line events from the GPIO character device (uAPI v2): the kernel debounces
+// the line and timestamps each edge, and the waiting thread sleeps in poll()
+// until one arrives.
+class ChardevButton : public ButtonSource {
+public:
+    ~ChardevButton() override;
+
+    // The button pulls the line low; it is requested as an input with the pull-up enabled
+    bool open(const std::string &chip = BUTTON_GPIO_CHIP, int line = BUTTON_GPIO,
+              int debounce_us = BUTTON_DEBOUNCE_US);
+    void close();
+
+    const char *name() const override { return name_.c_str(); }
+    int fd() const override { return fd_; }
+    bool read_press(ButtonPress &press) override;
+
+private:
+    int fd_ = -1;
+    std::string name_;
+};
+
+// Fallback for kernels without the v2 uAPI: samples the level through the
+// /dev/mem register mapping every 10 ms and stamps the press when it is seen.
+class RegisterButton : public ButtonSource {
+public:
+    // read returns the pin level, e.g. gpio_read from gpio.h
+    RegisterButton(uint8_t (*read)(uint8_t pin), int pin = BUTTON_GPIO);
+
+    const char *name() const override { return "gpio-registers"; }
+    int fd() const override { return -1; }
+    bool read_press(ButtonPress &press) override;
+
+private:
+    uint8_t (*read_)(uint8_t pin);
+    int pin_;
+    int last_level_ = 1;
+    uint32_t seqno_ = 0;
+};
+
+// Presses written to a named pipe by another process (tools/load_gen.cpp, or a
+// script): each press is its CLOCK_MONOTONIC timestamp as 8 native-endian
+// bytes, 0 meaning "now". A queued press keeps the time it was meant to
+// happen, so latency includes any time it spent waiting.
+class PipeButton : public ButtonSource {
+public:
+    ~PipeButton() override;
+
+    // Creates the FIFO if it does not exist
+    bool open(const std::string &path);
+    void close();
+
+    const char *name() const override { return path_.c_str(); }
+    int fd() const override { return fd_; }
+    bool read_press(ButtonPress &press) override;
+
+private:
+    int fd_ = -1;
+    std::string path_;
+    uint8_t partial_[8];
+    size_t partial_len_ = 0;
+    uint32_t seqno_ = 0;
+};
+
+// Presses injected by press(), for tests and benchmarks without the hardware
+class MockButton : public ButtonSource {
+public:
+    MockButton();
+    ~MockButton() override;
+
+    const char *name() const override { return "mock"; }
+    int fd() const override { return event_fd_; }
+    bool read_press(ButtonPress &press) override;
+
+    // Queue a press stamped now (or at timestamp_ns)
+    void press(uint64_t timestamp_ns = 0);
+
+private:
+    int event_fd_ = -1;             // readable while presses are queued
+    std::mutex mutex_;
+    std::deque<ButtonPress> pending_;
+    uint32_t seqno_ = 0;
+};
+
+#endif
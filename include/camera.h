@@ -13,7 +13,33 @@
 #include <chrono>
 #include <cstring>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cmath>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
 #include <sys/mman.h>
+#include <sys/eventfd.h>
+
+#include "deadline.h"
+#include "camera_source.h"
+
+#define CAMERA_PROFILE_PATH "./data/camera_profiles.csv"
+#define CAMERA_CALIBRATION_FRAME_TIMEOUT_MS 1000
+
+// Fixed exposure/white balance/focus settings measured once under the LED ring.
+// Applying them as manual controls means the first frame after start() is usable
+// instead of waiting for AE/AWB/AF to converge on every capture.
+struct CameraProfile {
+    std::string name;
+    int32_t exposure_time_us = 0;
+    float analogue_gain = 0.0f;
+    float lens_position = -1.0f;
+    float red_gain = 0.0f;
+    float blue_gain = 0.0f;
+};
 
 struct CameraContext {
     std::shared_ptr<libcamera::Camera> camera;
@@ -27,6 +53,9 @@ struct CameraContext {
     bool isStreaming = false;
     size_t next_buffer_index = 0;
     float manual_focus = -1.0f;
+    bool has_profile = false;
+    CameraProfile profile;
+    int completion_fd = -1;     // eventfd written from libcamera's thread as requests complete
 };
 
 bool init_camera(CameraContext &ctx, int width = 640, int height = 480, float manual_focus = -1.0f) {
@@ -75,6 +104,15 @@ bool init_camera(CameraContext &ctx, int width = 640, int height = 480, float ma
 
     ctx.buffers = &ctx.allocator->buffers(ctx.stream);
 
+    // Capture sleeps on this instead of polling the request status
+    ctx.completion_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int fd = ctx.completion_fd;
+    ctx.camera->requestCompleted.connect(&ctx, [fd](Request *) {
+        uint64_t one = 1;
+        if (write(fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+            std::cerr << "Failed to signal request completion\n";
+    });
+
     return true;
 }
 
@@ -87,15 +125,206 @@ void *map_framebuffer(libcamera::FrameBuffer *fb) {
     return memory;
 }
 
-bool capture_grayscale_image(CameraContext &ctx, std::vector<uint8_t> &image_out) {
+// Returns false if the deadline passed before the request completed
+bool wait_for_request(CameraContext &ctx, libcamera::Request *request, const Deadline &deadline = Deadline::never()) {
+    while (request->status() == libcamera::Request::RequestPending) {
+        if (deadline.expired())
+            return false;
+        struct pollfd pfd = { ctx.completion_fd, POLLIN, 0 };
+        if (poll(&pfd, 1, deadline.remaining_ms()) > 0) {
+            uint64_t count;
+            if (read(ctx.completion_fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+                std::cerr << "Failed to read request completions\n";
+        }
+    }
+    return request->status() == libcamera::Request::RequestComplete;
+}
+
+// Fill in the start controls: a loaded profile pins exposure, gain, colour gains
+// and lens position, otherwise only the manual focus (if any) is applied.
+void set_capture_controls(const CameraContext &ctx, libcamera::ControlList &controls) {
     using namespace libcamera;
 
-    ControlList controls = ctx.camera->controls();
-    if (ctx.manual_focus >= 0.0f) {
+    if (!ctx.has_profile) {
+        if (ctx.manual_focus >= 0.0f) {
+            controls.set(controls::AfMode, controls::AfModeManual);
+            controls.set(controls::LensPosition, ctx.manual_focus);
+        }
+        return;
+    }
+
+    const CameraProfile &p = ctx.profile;
+    controls.set(controls::AeEnable, false);
+    controls.set(controls::ExposureTime, p.exposure_time_us);
+    controls.set(controls::AnalogueGain, p.analogue_gain);
+
+    if (p.red_gain > 0.0f && p.blue_gain > 0.0f) {
+        float gains[2] = { p.red_gain, p.blue_gain };
+        controls.set(controls::AwbEnable, false);
+        controls.set(controls::ColourGains, Span<const float, 2>(gains));
+    }
+
+    float lens = p.lens_position >= 0.0f ? p.lens_position : ctx.manual_focus;
+    if (lens >= 0.0f) {
         controls.set(controls::AfMode, controls::AfModeManual);
-        controls.set(controls::LensPosition, ctx.manual_focus);
+        controls.set(controls::LensPosition, lens);
+    }
+}
+
+void use_camera_profile(CameraContext &ctx, const CameraProfile &profile) {
+    ctx.profile = profile;
+    ctx.has_profile = profile.exposure_time_us > 0 && profile.analogue_gain > 0.0f;
+}
+
+// Profiles are stored one per line: name,exposure_us,analogue_gain,lens_position,red_gain,blue_gain
+bool load_camera_profile(const std::string &filename, const std::string &name, CameraProfile &profile) {
+    std::ifstream file(filename);
+    if (!file.is_open())
+        return false;
+
+    std::string line;
+    while (getline(file, line)) {
+        std::stringstream lineStream(line);
+        std::string cell;
+        getline(lineStream, cell, ',');
+        if (cell != name)
+            continue;
+
+        CameraProfile p;
+        p.name = cell;
+        char comma;
+        lineStream >> p.exposure_time_us >> comma >> p.analogue_gain >> comma
+                   >> p.lens_position >> comma >> p.red_gain >> comma >> p.blue_gain;
+        if (lineStream.fail()) {
+            std::cerr << "Malformed camera profile '" << name << "' in " << filename << "\n";
+            return false;
+        }
+        profile = p;
+        return true;
+    }
+    return false;
+}
+
+bool save_camera_profile(const std::string &filename, const CameraProfile &profile) {
+    // keep every other profile, replace the one with the same name
+    std::vector<std::string> lines;
+    std::ifstream in(filename);
+    std::string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line.compare(0, profile.name.size() + 1, profile.name + ",") != 0)
+            lines.push_back(line);
+    }
+    in.close();
+
+    std::ofstream out(filename);
+    if (!out.is_open()) {
+        std::cerr << "Failed to open " << filename << " for writing\n";
+        return false;
+    }
+    for (const std::string &l : lines)
+        out << l << "\n";
+    out << profile.name << "," << profile.exposure_time_us << "," << profile.analogue_gain << ","
+        << profile.lens_position << "," << profile.red_gain << "," << profile.blue_gain << "\n";
+    return true;
+}
+
+// Run the camera with AE/AWB/AF enabled until exposure and gain settle, then
+// record the converged values as a profile. Call with the LED ring already lit.
+bool calibrate_camera_profile(CameraContext &ctx, const std::string &name, CameraProfile &profile,
+                              int max_frames = 60) {
+    using namespace libcamera;
+
+    ControlList controls = ctx.camera->controls();
+    controls.set(controls::AeEnable, true);
+    controls.set(controls::AwbEnable, true);
+    controls.set(controls::AfMode, controls::AfModeAuto);
+
+    if (ctx.camera->start(&controls) < 0) {
+        std::cerr << "Failed to start camera for calibration\n";
+        return false;
+    }
+
+    FrameBuffer *fb = ctx.buffers->at(0).get();
+    std::unique_ptr<Request> request = ctx.camera->createRequest();
+    if (!request || request->addBuffer(ctx.stream, fb) < 0) {
+        std::cerr << "Failed to create calibration request\n";
+        ctx.camera->stop();
+        return false;
+    }
+    request->controls().set(controls::AfTrigger, controls::AfTriggerStart);
+
+    CameraProfile p;
+    p.name = name;
+    int stable_frames = 0;
+    bool focus_done = false;
+
+    for (int frame = 0; frame < max_frames && stable_frames < 3; ++frame) {
+        if (ctx.camera->queueRequest(request.get()) < 0) {
+            std::cerr << "Failed to queue calibration request\n";
+            ctx.camera->stop();
+            return false;
+        }
+        if (!wait_for_request(ctx, request.get(), Deadline::after_ms(CAMERA_CALIBRATION_FRAME_TIMEOUT_MS))) {
+            // stopping the camera cancels the outstanding request
+            std::cerr << "Calibration frame did not complete, aborting calibration\n";
+            ctx.camera->stop();
+            return false;
+        }
+
+        const ControlList &meta = request->metadata();
+        auto exposure = meta.get(controls::ExposureTime);
+        auto gain = meta.get(controls::AnalogueGain);
+        auto lens = meta.get(controls::LensPosition);
+        auto colour = meta.get(controls::ColourGains);
+        auto af_state = meta.get(controls::AfState);
+
+        if (af_state && (*af_state == controls::AfStateFocused || *af_state == controls::AfStateFailed))
+            focus_done = true;
+        if (!af_state)
+            focus_done = true;
+
+        if (exposure && gain) {
+            bool settled = p.exposure_time_us > 0 &&
+                           std::abs(*exposure - p.exposure_time_us) <= p.exposure_time_us / 50 &&
+                           std::fabs(*gain - p.analogue_gain) <= p.analogue_gain * 0.02f;
+            stable_frames = (settled && focus_done) ? stable_frames + 1 : 0;
+            p.exposure_time_us = *exposure;
+            p.analogue_gain = *gain;
+        }
+        if (lens && af_state && *af_state == controls::AfStateFocused)
+            p.lens_position = *lens;
+        if (colour) {
+            p.red_gain = (*colour)[0];
+            p.blue_gain = (*colour)[1];
+        }
+
+        request->reuse(Request::ReuseBuffers);
     }
 
+    ctx.camera->stop();
+
+    if (p.exposure_time_us <= 0 || p.analogue_gain <= 0.0f) {
+        std::cerr << "Camera calibration did not report exposure metadata\n";
+        return false;
+    }
+    if (stable_frames < 3)
+        std::cerr << "Camera calibration did not fully converge, using last values\n";
+    if (p.lens_position < 0.0f)
+        p.lens_position = ctx.manual_focus;
+
+    std::cerr << "Camera profile '" << p.name << "': exposure " << p.exposure_time_us
+              << "us, gain " << p.analogue_gain << ", lens " << p.lens_position << "\n";
+    profile = p;
+    return true;
+}
+
+bool capture_grayscale_image(CameraContext &ctx, std::vector<uint8_t> &image_out,
+                             const Deadline &deadline = Deadline::never()) {
+    using namespace libcamera;
+
+    ControlList controls = ctx.camera->controls();
+    set_capture_controls(ctx, controls);
+
     if (ctx.camera->start(&controls) < 0) {
         std::cerr << "Failed to start camera\n";
         return false;
@@ -123,8 +352,11 @@ bool capture_grayscale_image(CameraContext &ctx, std::vector<uint8_t> &image_out
         return false;
     }
 
-    while (request->status() != Request::RequestComplete) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    if (!wait_for_request(ctx, request.get(), deadline)) {
+        // stopping the camera cancels the outstanding request
+        std::cerr << "Capture deadline expired\n";
+        ctx.camera->stop();
+        return false;
     }
 
     auto buffer_map = request->buffers();
@@ -176,3 +408,20 @@ void cleanup_camera(CameraContext &ctx) {
     ctx.allocator.reset();
     ctx.buffers = nullptr;
 }
+
+// The Pi camera behind the CameraSource interface; init, calibration and the
+// profile still go through context()
+class LibcameraSource : public CameraSource {
+public:
+    ~LibcameraSource() override { cleanup_camera(ctx_); }
+
+    CameraContext &context() { return ctx_; }
+
+    const char *name() const override { return "libcamera"; }
+    bool capture(std::vector<uint8_t> &image, const Deadline &deadline) override {
+        return capture_grayscale_image(ctx_, image, deadline);
+    }
+
+private:
+    CameraContext ctx_;
+};
@@ -0,0 +1,40 @@
+#ifndef CAMERA_SOURCE_H
+#define CAMERA_SOURCE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "deadline.h"
+
+// Where the capture stage gets its grayscale frames: the Pi camera
+// (LibcameraSource in camera.h) or recorded images.
+class CameraSource {
+public:
+    virtual ~CameraSource() = default;
+
+    virtual const char *name() const = 0;
+    // One width x height 8-bit frame; false on failure or if the deadline passed
+    virtual bool capture(std::vector<uint8_t> &image, const Deadline &deadline) = 0;
+};
+
+// Replays image files in a loop, for running the daemon without a camera. The
+// images are decoded once, cropped to a centered square and scaled to the
+// capture size; each capture then takes capture_us, like exposure and readout.
+class ReplayCamera : public CameraSource {
+public:
+    // path is one image or a directory of .jpg/.png files
+    bool open(const std::string &path, int width, int height, int capture_us = 0);
+
+    const char *name() const override { return "replay"; }
+    bool capture(std::vector<uint8_t> &image, const Deadline &deadline) override;
+
+    size_t frames() const { return frames_.size(); }
+
+private:
+    std::vector<std::vector<uint8_t>> frames_;
+    size_t next_ = 0;
+    int capture_us_ = 0;
+};
+
+#endif
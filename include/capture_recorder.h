@@ -0,0 +1,77 @@
+#ifndef CAPTURE_RECORDER_H
+#define CAPTURE_RECORDER_H
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#include "segment_log.h"
+#include "image_process_pipeline.h"
+
+#define RECORDER_DIR "./data/archive"
+#define RECORDER_SEGMENT_SIZE (256u << 20)
+// With memory locked (real-time mode) the mapped segment and its spare stay
+// resident, so they are kept small there (about 8 frames each)
+#define RECORDER_LOCKED_SEGMENT_SIZE (16u << 20)
+#define RECORDER_QUEUE_DEPTH 4
+#define RECORDER_SOFTMAX_SIZE 10
+
+#define RECORD_TYPE_CAPTURE 1
+
+// Metadata stored in front of each raw Y-plane frame in the archive
+struct CaptureRecord {
+    uint64_t timestamp_ns;   // CLOCK_REALTIME at capture
+    uint32_t width;
+    uint32_t height;
+    BoundingBox bbox;
+    float coefficients[COMPONENTS];
+    float softmax[RECORDER_SOFTMAX_SIZE];
+};
+
+// Archives captured frames on a background thread. Frames are copied into a
+// fixed pool of preallocated slots; when every slot is busy the frame is dropped
+// so the capture path never waits on storage.
+class CaptureRecorder {
+public:
+    CaptureRecorder() = default;
+    ~CaptureRecorder();
+
+    bool start(const std::string &dir = RECORDER_DIR,
+               size_t segment_size = RECORDER_SEGMENT_SIZE,
+               int queue_depth = RECORDER_QUEUE_DEPTH,
+               size_t max_frame_bytes = 1440 * 1440);
+    void stop();
+
+    // Returns false if the frame was dropped
+    bool submit(const CaptureRecord &record, const uint8_t *pixels, size_t length);
+
+    uint64_t recorded() const { return recorded_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        CaptureRecord record;
+        std::vector<uint8_t> pixels;
+        size_t length = 0;
+    };
+
+    void run();
+
+    SegmentLog log_;
+    std::vector<Slot> slots_;
+    std::vector<Slot *> free_;
+    std::deque<Slot *> ready_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+    bool running_ = false;
+    std::atomic<uint64_t> recorded_{0};
+    std::atomic<uint64_t> dropped_{0};
+};
+
+#endif
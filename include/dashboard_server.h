@@ -0,0 +1,133 @@
+#ifndef DASHBOARD_SERVER_H
+#define DASHBOARD_SERVER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "reactor.h"
+
+// TCP server for the operator dashboards, speaking the framing of
+// model/transmitter.py:
+//   [u64 BE size of the rest]
+//   [u64 BE raw length][raw JPEG]
+//   [u64 BE processed length][processed JPEG]
+//   [u8 softmax length][float32 softmax x10][0x00]
+// Accept and send run as handlers on a Reactor, the daemon's or one of the
+// server's own. broadcast() only appends the frame to a pending list and posts
+// a delivery to the reactor, so the inference loop never waits on a client. Every client queue holds a reference to the same frame
+// and sends straight from its buffers with a gather write.
+
+#define DASHBOARD_PORT 2663
+#define DASHBOARD_MAX_CLIENTS 16
+#define DASHBOARD_QUEUE_FRAMES 2
+#define DASHBOARD_STALL_TIMEOUT_MS 5000
+#define DASHBOARD_STALL_CHECK_MS 1000
+#define DASHBOARD_SOFTMAX_SIZE 10
+
+// What happens when a client's queue is full
+enum DashboardDropPolicy {
+    DROP_OLDEST,    // discard the oldest frame not yet being sent
+    DROP_NEWEST,    // discard the incoming frame
+    DROP_CLIENT     // disconnect the client
+};
+
+struct DashboardFrame {
+    std::vector<uint8_t> raw_jpg;
+    std::vector<uint8_t> processed_jpg;
+    float softmax[DASHBOARD_SOFTMAX_SIZE] = {};
+
+    // Framing around the images, filled in by finish()
+    uint8_t head[16];       // total size, raw length
+    uint8_t middle[8];      // processed length
+    uint8_t tail[1 + DASHBOARD_SOFTMAX_SIZE * sizeof(float) + 1];
+
+    // Call once the images and softmax are set, before broadcasting
+    void finish();
+    size_t size() const;
+};
+
+struct DashboardConfig {
+    std::string bind_address = "0.0.0.0";
+    int port = DASHBOARD_PORT;          // 0 picks a free port (see DashboardServer::port)
+    int max_clients = DASHBOARD_MAX_CLIENTS;
+    size_t queue_frames = DASHBOARD_QUEUE_FRAMES;
+    DashboardDropPolicy policy = DROP_OLDEST;
+    int stall_timeout_ms = DASHBOARD_STALL_TIMEOUT_MS;  // disconnect a client making no progress
+};
+
+struct DashboardStats {
+    uint64_t accepted = 0;
+    uint64_t rejected = 0;
+    uint64_t disconnected = 0;
+    uint64_t frames_broadcast = 0;
+    uint64_t frames_sent = 0;
+    uint64_t frames_dropped = 0;
+    uint64_t clients_dropped = 0;   // by DROP_CLIENT or the stall timeout
+    size_t clients = 0;
+};
+
+class DashboardServer {
+public:
+    DashboardServer() = default;
+    ~DashboardServer();
+
+    DashboardServer(const DashboardServer &) = delete;
+    DashboardServer &operator=(const DashboardServer &) = delete;
+
+    // Without a reactor the server starts a thread with one of its own
+    bool start(const DashboardConfig &config = DashboardConfig(), Reactor *reactor = nullptr);
+    void stop();
+
+    // Queue a finished frame for every connected client
+    void broadcast(std::shared_ptr<const DashboardFrame> frame);
+
+    bool running() const { return running_.load(); }
+    int port() const { return port_; }
+    DashboardStats stats() const;
+
+private:
+    struct Client {
+        int fd = -1;
+        std::string peer;
+        std::deque<std::shared_ptr<const DashboardFrame>> queue;
+        size_t sent = 0;            // bytes of queue.front() already written
+        bool writable_armed = false;
+        std::chrono::steady_clock::time_point last_progress;
+    };
+
+    void deliver();
+    void check_stalls();
+    void on_client(int fd, uint32_t events);
+    void accept_clients();
+    void enqueue(Client &client, const std::shared_ptr<const DashboardFrame> &frame);
+    bool flush(Client &client);
+    void arm(Client &client, bool writable);
+    void disconnect(int fd, bool dropped);
+
+    DashboardConfig config_;
+    int listen_fd_ = -1;
+    int port_ = 0;
+    Reactor *reactor_ = nullptr;
+    std::unique_ptr<Reactor> own_reactor_;
+    int stall_timer_ = -1;
+    std::atomic<bool> running_{false};
+
+    std::mutex pending_mutex_;          // also orders broadcast() against stop()
+    std::vector<std::shared_ptr<const DashboardFrame>> pending_;
+
+    std::map<int, Client> clients_;     // owned by the reactor thread
+
+    mutable std::mutex stats_mutex_;
+    DashboardStats stats_;
+};
+
+#endif
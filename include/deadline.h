@@ -0,0 +1,81 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include <chrono>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+
+// Stages an inference request passes through; used to attribute timeouts
+enum Stage {
+    STAGE_CAPTURE = 0,
+    STAGE_PREPROCESS,
+    STAGE_LINK,
+    STAGE_PUBLISH,
+    STAGE_COUNT
+};
+
+inline const char *stage_name(int stage) {
+    static const char *names[STAGE_COUNT] = { "capture", "preprocess", "link", "publish" };
+    return stage >= 0 && stage < STAGE_COUNT ? names[stage] : "unknown";
+}
+
+// Absolute point in time by which a request must be finished. Blocking waits
+// take remaining_ms() as their timeout; stage boundaries check expired().
+struct Deadline {
+    std::chrono::steady_clock::time_point at = std::chrono::steady_clock::time_point::max();
+
+    static Deadline after_ms(int ms) {
+        Deadline d;
+        d.at = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+        return d;
+    }
+
+    static Deadline never() { return Deadline(); }
+
+    bool is_never() const { return at == std::chrono::steady_clock::time_point::max(); }
+
+    bool expired() const { return !is_never() && std::chrono::steady_clock::now() >= at; }
+
+    // Milliseconds left, rounded up so a wait never spins on 0 before the
+    // deadline (0 once expired), -1 for no deadline; suitable for poll()
+    int remaining_ms() const {
+        if (is_never())
+            return -1;
+        auto left = std::chrono::duration_cast<std::chrono::microseconds>(at - std::chrono::steady_clock::now()).count();
+        return left > 0 ? static_cast<int>((left + 999) / 1000) : 0;
+    }
+
+    // The earlier of this deadline and now + ms
+    int remaining_ms(int cap_ms) const {
+        int left = remaining_ms();
+        return left < 0 || left > cap_ms ? cap_ms : left;
+    }
+};
+
+struct StageCounters {
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> timeouts[STAGE_COUNT] = {};
+
+    void timeout(int stage) {
+        uint64_t n = timeouts[stage].fetch_add(1, std::memory_order_relaxed) + 1;
+        std::cerr << "Request timed out in " << stage_name(stage) << " (" << n << " so far)\n";
+    }
+
+    // Requests counted so far, to tell whether a report would say anything new
+    uint64_t total() const {
+        uint64_t n = completed.load(std::memory_order_relaxed);
+        for (int s = 0; s < STAGE_COUNT; s++)
+            n += timeouts[s].load(std::memory_order_relaxed);
+        return n;
+    }
+
+    void report(std::ostream &os) const {
+        os << "completed " << completed.load(std::memory_order_relaxed);
+        for (int s = 0; s < STAGE_COUNT; s++)
+            os << ", " << stage_name(s) << " timeouts " << timeouts[s].load(std::memory_order_relaxed);
+        os << "\n";
+    }
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef DEBUG_ENCODER_H
+#define DEBUG_ENCODER_H
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+#include "image_process_pipeline.h"
+#include "result_ring.h"
+
+#define DEBUG_ENCODER_QUEUE_DEPTH 2
+
+// Dashboard copy of the rotated capture; the processed 24x24 is kept as is
+#define DEBUG_RAW_SIZE 720
+#define DEBUG_RAW_QUALITY 90
+#define DEBUG_PROCESSED_SIZE 0
+#define DEBUG_PROCESSED_QUALITY 100
+
+enum DebugStage {
+    DEBUG_STAGE_RAW = 0,        // PipelineImages::rotated
+    DEBUG_STAGE_PROCESSED,      // PipelineImages::processed
+    DEBUG_STAGE_COUNT
+};
+
+struct DebugStageSettings {
+    int size = 0;       // output is size x size; 0 keeps the stage's own resolution
+    int quality = 100;
+};
+
+// One inference's images and result. process_image fills `images` in place,
+// the encoder fills `jpeg`. has_images is false for a snapshot whose images
+// were dropped because a newer one replaced it.
+struct DebugSnapshot {
+    ResultRecord result = {};
+    PipelineImages images;
+    std::vector<uint8_t> jpeg[DEBUG_STAGE_COUNT];
+    bool has_images = false;
+};
+
+// Encodes debug/dashboard JPEGs on a background thread. Snapshots come from a
+// fixed pool, so handing one over is a pointer move. When the encoder falls
+// behind, acquire() takes back the oldest queued snapshot: the newest images
+// win, and the superseded result is still passed to the sink without images.
+class DebugImageEncoder {
+public:
+    using Sink = std::function<void(DebugSnapshot &)>;
+
+    DebugImageEncoder();
+    ~DebugImageEncoder();
+
+    // The sink runs on the encoder thread, once per submitted snapshot, in order.
+    // filling is how many snapshots callers may hold between acquire() and submit().
+    bool start(Sink sink, int queue_depth = DEBUG_ENCODER_QUEUE_DEPTH, int filling = 1);
+    void stop();
+
+    // May be changed while running; applies from the next snapshot encoded
+    void set_stage(int stage, const DebugStageSettings &settings);
+
+    // A snapshot to fill; nullptr only if the encoder is not running
+    DebugSnapshot *acquire();
+    void submit(DebugSnapshot *snapshot);
+    // Give back a snapshot that will not be submitted
+    void release(DebugSnapshot *snapshot);
+
+    uint64_t encoded() const { return encoded_.load(std::memory_order_relaxed); }
+    uint64_t superseded() const { return superseded_.load(std::memory_order_relaxed); }
+
+private:
+    struct Pending {
+        DebugSnapshot *snapshot;    // nullptr for a superseded result
+        ResultRecord result;
+    };
+
+    void run();
+    void encode(DebugSnapshot &snapshot, const DebugStageSettings *stages);
+
+    DebugStageSettings stages_[DEBUG_STAGE_COUNT];
+    Sink sink_;
+    std::vector<DebugSnapshot> pool_;
+    std::vector<DebugSnapshot *> free_;
+    std::deque<Pending> ready_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+    bool running_ = false;
+    std::vector<uint8_t> scaled_;
+    std::atomic<uint64_t> encoded_{0};
+    std::atomic<uint64_t> superseded_{0};
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef DIGITAL_INFERENCE_H
+#define DIGITAL_INFERENCE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <random>
+#include <Eigen/Dense>
+
+#include "inference_backend.h"
+
+#define DIGITAL_WEIGHTS_PATH "./data/ann_weights.bin"
+
+// Weight file, little endian:
+//   char[4] "ANNW", u32 version (1), u32 layer count, then per layer
+//   u32 inputs, u32 outputs, u32 activation,
+//   f32 weights[outputs][inputs], f32 bias[outputs]
+// model/export_weights.py writes this format.
+#define ANN_WEIGHTS_MAGIC "ANNW"
+#define ANN_WEIGHTS_VERSION 1
+// Larger files are rejected before anything is allocated
+#define ANN_WEIGHTS_MAX_LAYERS 16
+#define ANN_WEIGHTS_MAX_UNITS 4096
+
+enum Activation {
+    ACTIVATION_LINEAR = 0,
+    ACTIVATION_RELU = 1,
+    ACTIVATION_TANH = 2,
+    ACTIVATION_SIGMOID = 3,
+    ACTIVATION_SOFTMAX = 4
+};
+
+// Non-idealities of the analog board, all off by default
+struct AnalogModel {
+    int input_bits = 0;              // quantize inputs to the DAC (12 on the real board), 0 = off
+    double weight_mismatch = 0.0;    // relative static error per weight, drawn once at load
+    double activation_noise = 0.0;   // additive gaussian noise on each pre-activation, per inference
+    int output_bits = 0;             // quantize the softmax like the ADC/wire encoding, 0 = off
+    uint32_t seed = 1;
+};
+
+// Host-side MLP computing the same softmax as the analog network from the PCA
+// coefficients. Serves as a reference for accuracy and latency and as a
+// fallback when the boards are busy or missing. Results are computed in
+// submit() and handed out by the next poll().
+class DigitalInference : public InferenceBackend {
+public:
+    // The network must take COMPONENTS coefficients and give SOFTMAX_SIZE outputs
+    bool load(const std::string &filename, const AnalogModel &model = AnalogModel());
+
+    // Synchronous evaluation
+    void infer(const std::vector<double> &coefficients, std::vector<double> &softmax);
+
+    const char *name() const override { return "digital"; }
+    int submit(uint64_t tag, const std::vector<double> &coefficients, int timeout_ms,
+               int exclude_board = -1) override;
+    int poll(std::vector<InferenceResult> &out, int timeout_ms) override;
+    void cancel(uint64_t tag) override;
+    bool has_capacity() const override { return loaded(); }
+    int in_flight() const override { return done_.size(); }
+
+    bool loaded() const { return !layers_.empty(); }
+    int inputs() const { return layers_.empty() ? 0 : layers_.front().weights.cols(); }
+    int outputs() const { return layers_.empty() ? 0 : layers_.back().weights.rows(); }
+
+private:
+    struct Layer {
+        Eigen::MatrixXf weights;
+        Eigen::VectorXf bias;
+        Activation activation;
+    };
+
+    std::vector<Layer> layers_;
+    AnalogModel model_;
+    std::mt19937 rng_;
+    Eigen::VectorXf x_, y_;
+    std::deque<InferenceResult> done_;
+};
+
+#endif
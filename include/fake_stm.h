@@ -0,0 +1,41 @@
+#ifndef FAKE_STM_H
+#define FAKE_STM_H
+
+#include <cstdint>
+#include <thread>
+#include <atomic>
+
+#include "stm_link.h"
+
+// STM stand-in that speaks the framed protocol on the master side of a pty
+// (see open_pty_pair). Used by the link benchmark and host-side simulation.
+struct FakeStmConfig {
+    int version = STM_PROTOCOL_VERSION;
+    uint8_t capabilities = STM_CAP_PACKED | STM_CAP_BAUD;
+    int max_baud = 4000000;
+    int infer_delay_us = 0;            // analog evaluation time per inference, served one at a time
+    double corrupt_probability = 0.0;  // chance of flipping a byte in each reply frame
+};
+
+class FakeStm {
+public:
+    ~FakeStm();
+
+    bool start(int fd, const FakeStmConfig &config = FakeStmConfig());
+    void stop();
+
+    uint64_t requests() const { return requests_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void handle(const StmFrame &frame, std::vector<uint8_t> &out);
+
+    int fd_ = -1;
+    int stop_fd_ = -1;
+    FakeStmConfig config_;
+    std::thread thread_;
+    std::atomic<uint64_t> requests_{0};
+    uint32_t rng_ = 0x12345678u;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <ostream>
+#include <functional>
+
+#include "spsc_ring.h"
+#include "deadline.h"
+#include "capture_recorder.h"
+#include "debug_encoder.h"
+#include "telemetry.h"
+
+// The button path as four threads, one per Stage, each optionally pinned to
+// its own core:
+//
+//   capture --> preprocess --> link --> publish
+//      ^                                   |
+//      +------------ free slots -----------+
+//
+// Frames travel in a fixed set of preallocated slots over single-producer/
+// single-consumer rings, so while frame N is on the analog board frame N+1 is
+// already being preprocessed and throughput is set by the slowest stage rather
+// than the sum of all of them. When every slot is in flight, capture waits.
+
+#define PIPELINE_SLOTS 4
+// How long capture waits for a trigger that cannot be interrupted before
+// checking for stop()
+#define PIPELINE_WAIT_MS 100
+
+struct FrameSlot {
+    std::vector<uint8_t> image;
+    std::vector<double> coefficients;
+    std::vector<double> softmax;
+    CaptureRecord record;
+    TelemetryRecord telemetry;
+    Deadline deadline;
+    uint64_t trigger_ns = 0;                // CLOCK_MONOTONIC of the press, 0 if unknown
+    DebugSnapshot *snapshot = nullptr;      // kept across frames until handed to the encoder
+    bool failed = false;                    // a stage gave up; the rest go straight to publish
+};
+
+// A stage returns false to give up on the frame. Publish runs for every frame,
+// failed or not, and the slot is recycled when it returns.
+using FrameStage = std::function<bool(FrameSlot &slot)>;
+// Waits up to timeout_ms (-1 forever) for a reason to capture and sets
+// trigger_ns to when it happened; false if there was none
+using FrameTrigger = std::function<bool(int timeout_ms, uint64_t &trigger_ns)>;
+
+struct FramePipelineConfig {
+    int slots = PIPELINE_SLOTS;
+    size_t frame_bytes = 1440 * 1440;
+    int cpus[STAGE_COUNT] = { 0, 1, 2, 3 };  // -1 leaves a stage unpinned
+};
+
+class FramePipeline {
+public:
+    FramePipeline() = default;
+    ~FramePipeline();
+
+    FramePipeline(const FramePipeline &) = delete;
+    FramePipeline &operator=(const FramePipeline &) = delete;
+
+    // Set everything before start(); each function only runs on its stage's thread.
+    // With an interrupt that makes the trigger return early, capture waits for
+    // it without a timeout and stop() calls the interrupt.
+    void set_trigger(FrameTrigger trigger, std::function<void()> interrupt = nullptr) {
+        trigger_ = std::move(trigger);
+        interrupt_ = std::move(interrupt);
+    }
+    void set_stage(int stage, FrameStage fn) { stages_[stage] = std::move(fn); }
+
+    bool start(const FramePipelineConfig &config = FramePipelineConfig());
+    void stop();
+
+    uint64_t frames() const { return frames_[STAGE_PUBLISH].load(std::memory_order_relaxed); }
+    // Frames and busy time per stage, and the throughput the slowest one allows
+    void report(std::ostream &os) const;
+
+private:
+    void run(int stage, int cpu);
+    void run_stage(int stage, FrameSlot &slot);
+
+    FrameTrigger trigger_;
+    std::function<void()> interrupt_;
+    FrameStage stages_[STAGE_COUNT];
+    std::vector<std::unique_ptr<FrameSlot>> slots_;
+    // in_[s] feeds stage s; in_[STAGE_CAPTURE] carries free slots back from publish
+    std::unique_ptr<SpscRing<FrameSlot *>> in_[STAGE_COUNT];
+    std::vector<std::thread> threads_;
+    std::atomic<bool> running_{false};
+
+    std::atomic<uint64_t> frames_[STAGE_COUNT] = {};
+    std::atomic<uint64_t> busy_ns_[STAGE_COUNT] = {};
+};
+
+#endif
@@ -4,12 +4,18 @@
 #include <iostream>
 //#include <Eigen/Dense>
 #include <cstdint>
+#include <string>
 #include <vector>
 #include <cmath>
 #include <algorithm>
 #include <cmath>
 #include <cstdint>
 
+#include "deadline.h"
+#include "model_registry.h"
+
+// Defaults for the preprocessing stages (preprocess_graph.h); the stages
+// and their parameters come from data/preprocess.csv
 #define BLACK_THRESHOLD 130
 #define WHITE_THRESHOLD 200
 
@@ -17,13 +23,47 @@
 
 #define FEATURES 576
 #define COMPONENTS 12
+
+// The PCA basis in the model registry; replacing either file reloads it
+#define IMAGE_PCA_MODEL "image_pca"
+#define IMAGE_PCA_COMPONENTS_PATH "./data/pca_components.csv"
+#define IMAGE_PCA_MEAN_PATH "./data/mean.csv"
+
+// Coefficients are quantized to the 12-bit DAC codes driving the analog network
+#define DAC_LEVELS 4096
+#define DAC_FULL_SCALE 2.75
 // typedef enum{
 //     THRESHOLD_UP = 0,
 //     THRESHOLD_DOWN = 1,
 // }DIRECTION
 
-extern std::vector<std::vector<double>> __pca_components;
-extern std::vector<double> __mean_vector;
+// Digit bounds found by crop_to_square, in (rotated) capture coordinates
+struct BoundingBox {
+    int min_x = 0;
+    int max_x = 0;
+    int min_y = 0;
+    int max_y = 0;
+};
+
+// A preprocessing stage's output copied for inspection (stage_taps.h)
+struct TapImage {
+    int stage = 0;                   // index in the plan
+    std::string name;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// Intermediate images kept for the dashboard
+struct PipelineImages {
+    std::vector<uint8_t> rotated;    // width x height capture after rotation
+    std::vector<uint8_t> processed;  // 24x24 input to the PCA projection
+    // Set by the caller: the stages of preprocessing plan version tap_plan to
+    // copy into taps (bit = stage index), usually none
+    uint64_t tap_mask = 0;
+    uint64_t tap_plan = 0;
+    std::vector<TapImage> taps;
+};
 
 const float GAUSSIAN_KERNEL[3][3] = {
   { 1/16.0, 2/16.0, 1/16.0 },
@@ -31,27 +71,71 @@ const float GAUSSIAN_KERNEL[3][3] = {
   { 1/16.0, 2/16.0, 1/16.0 } 
 };
 
-void image_processing_init();
+// Registers and loads IMAGE_PCA_MODEL and the preprocessing stages from
+// preprocess_path; exits if either cannot be loaded
+void image_processing_init(const std::string &preprocess_path);
+// The current basis; hold on to it for the whole projection
+std::shared_ptr<const PcaModel> image_pca_model();
 
-void process_image(const std::vector<uint8_t>& image, 
+// The preprocessing stages up to the 24x24 PCA input; false if the deadline
+// passes between stages
+bool prepare_image(const std::vector<uint8_t>& image, 
                    int width,
                    int height,
-                   std::vector<double>& out);
-                   
-                   
-/*
-void downsampleInterArea(const std::vector<uint8_t>& image, 
-                         int oldWidth, 
-                         int oldHeight, 
-                         int newWidth, 
+                   std::vector<uint8_t>& output_for_pca,
+                   BoundingBox *bbox = nullptr,
+                   const Deadline &deadline = Deadline::never(),
+                   PipelineImages *images = nullptr);
+
+// prepare_image plus the PCA projection. Returns false (and leaves out empty)
+// if the deadline passes between steps
+bool process_image(const std::vector<uint8_t>& image, 
+                   int width,
+                   int height,
+                   std::vector<double>& out,
+                   BoundingBox *bbox = nullptr,
+                   const Deadline &deadline = Deadline::never(),
+                   PipelineImages *images = nullptr);
+
+// Kernels the preprocessing stages are built from
+void downsampleInterArea(const std::vector<uint8_t>& image,
+                         int oldWidth,
+                         int oldHeight,
+                         int newWidth,
                          int newHeight,
                          std::vector<uint8_t>& out);
 
+void crop(const std::vector<uint8_t>& image,
+          int input_width, int input_height,
+          int crop_width, int crop_height,
+          std::vector<uint8_t>& out);
+
+void crop_to_square(const std::vector<uint8_t>& image, int width, int height,
+                    std::vector<uint8_t>& cropped, int& new_size, uint8_t threshold,
+                    BoundingBox *bbox = nullptr);
+
+void gaussian_blur(const std::vector<uint8_t>& image,
+                   int width,
+                   int height,
+                   std::vector<uint8_t>& out);
+
+void find_digit_cubic(const std::vector<uint8_t>& image, int width, int height,
+                      std::vector<uint8_t>& out, int target_width = 24, int target_height = 24);
+                   
+/*
 void threshold(const std::vector<uint8_t>& image,
                uint8_t threshold,
                std::vector<uint8_t>& out);
 */
 
-void pcaProject(const std::vector<double>& image, 
+// Both return false (and leave no coefficients) when an image does not match
+// the loaded basis
+bool pcaProject(const std::vector<uint8_t>& image, 
                 std::vector<double>& out);
+
+bool pcaProjectBatch(const std::vector<const std::vector<uint8_t>*>& images,
+                     std::vector<std::vector<double>>& out);
+
+// Normalize projected coefficients and round them to DAC steps
+void quantizeCoefficients(std::vector<double>& out);
 #endif
@@ -0,0 +1,70 @@
+#ifndef INFERENCE_BACKEND_H
+#define INFERENCE_BACKEND_H
+
+#include <cstdint>
+#include <vector>
+
+#define SOFTMAX_SIZE 10
+
+struct InferenceResult {
+    uint64_t tag = 0;
+    int board = -1;               // analog board that answered, -1 for host backends
+    bool ok = false;              // false: timed out or the board failed, the request may be retried
+    std::vector<double> softmax;
+    double latency_us = 0.0;
+    uint32_t crc_errors = 0;      // frames with bad CRCs on the answering board's link so far
+};
+
+// Something that turns PCA coefficients into a softmax: the analog boards
+// behind the UARTs, or the host-side digital model. Requests are asynchronous
+// and identified by a caller-chosen tag.
+class InferenceBackend {
+public:
+    virtual ~InferenceBackend() = default;
+
+    virtual const char *name() const = 0;
+
+    // Queue an inference; returns a non-negative value on success, -1 if it was
+    // not accepted. exclude_board keeps a retry off the board that just failed.
+    virtual int submit(uint64_t tag, const std::vector<double> &coefficients, int timeout_ms,
+                       int exclude_board = -1) = 0;
+
+    // Wait up to timeout_ms for finished requests and append them to out
+    virtual int poll(std::vector<InferenceResult> &out, int timeout_ms) = 0;
+
+    // Give up on a request; no result will be reported for it
+    virtual void cancel(uint64_t tag) = 0;
+
+    virtual bool has_capacity() const = 0;
+    virtual int in_flight() const = 0;
+
+    // Make a poll() blocked on another thread return early; safe from any thread
+    virtual void interrupt() {}
+};
+
+// Sends work to the primary backend while it has room and spills the rest (and
+// retries of failed primary requests) to the secondary one.
+class OverflowBackend : public InferenceBackend {
+public:
+    OverflowBackend(InferenceBackend &primary, InferenceBackend &secondary);
+
+    const char *name() const override { return "overflow"; }
+    int submit(uint64_t tag, const std::vector<double> &coefficients, int timeout_ms,
+               int exclude_board = -1) override;
+    int poll(std::vector<InferenceResult> &out, int timeout_ms) override;
+    void cancel(uint64_t tag) override;
+    bool has_capacity() const override;
+    int in_flight() const override;
+    void interrupt() override { primary_.interrupt(); }
+
+    uint64_t overflowed() const { return overflowed_; }
+
+private:
+    InferenceBackend &primary_;
+    InferenceBackend &secondary_;
+    std::vector<std::pair<uint64_t, std::vector<double>>> primary_inputs_;
+    std::vector<InferenceResult> scratch_;
+    uint64_t overflowed_ = 0;
+};
+
+#endif
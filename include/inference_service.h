@@ -0,0 +1,183 @@
+#ifndef INFERENCE_SERVICE_H
+#define INFERENCE_SERVICE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+#include "inference_backend.h"
+#include "deadline.h"
+#include "telemetry.h"
+#include "reactor.h"
+
+// Local inference service. Other processes submit images over a Unix stream
+// socket; the button path in main() submits its coefficients in-process. Both
+// go through the same queues:
+//
+//   socket (reactor) --> preprocessing workers --> dispatcher --> backend
+//        ^                                         |
+//        +------------- replies -------------------+
+//
+// The dispatcher owns the InferenceBackend. It takes everything that is ready,
+// projects the pending 24x24 inputs as one batch and submits the whole batch
+// to the backend before waiting for results, so the boards' windows fill up.
+//
+// Wire format (host byte order): a client sends InferenceRequestHeader plus
+// payload_len bytes and gets one InferenceReply per request, in completion
+// order, matched by id. Several requests may be outstanding on a connection,
+// and a client may shut down its sending side once the last one is out.
+
+#define INFERENCE_SOCKET_PATH "/tmp/ann_inference.sock"
+#define INFERENCE_REQUEST_MAGIC 0x514E4E41  // "ANNQ"
+#define INFERENCE_REPLY_MAGIC 0x524E4E41    // "ANNR"
+#define INFERENCE_MAX_PAYLOAD (16u << 20)
+#define INFERENCE_WORKERS 2
+#define INFERENCE_MAX_BATCH 16
+#define INFERENCE_MAX_QUEUED 64
+#define INFERENCE_MAX_QUEUED_BYTES (64u << 20)   // payloads held by queued requests
+#define INFERENCE_DEFAULT_DEADLINE_MS 2000
+#define INFERENCE_PIXELS 576                // 24x24 input to the PCA projection
+#define INFERENCE_COEFFICIENTS 12
+#define INFERENCE_ATTEMPTS 2
+
+enum InferenceInput {
+    INPUT_RAW = 1,          // width x height 8-bit grayscale capture
+    INPUT_ENCODED = 2,      // JPEG/PNG/BMP file contents, converted to grayscale
+    INPUT_PIXELS = 3        // 576 bytes, already preprocessed
+};
+
+enum InferenceStatus {
+    INFER_OK = 0,
+    INFER_BAD_REQUEST = 1,
+    INFER_DECODE_FAILED = 2,
+    INFER_BUSY = 3,
+    INFER_TIMEOUT = 4,
+    INFER_FAILED = 5
+};
+
+inline const char *inference_status_name(int status) {
+    static const char *names[] = { "ok", "bad_request", "decode_failed", "busy", "timeout", "failed" };
+    return status >= INFER_OK && status <= INFER_FAILED ? names[status] : "unknown";
+}
+
+struct InferenceRequestHeader {
+    uint32_t magic;
+    uint32_t id;            // echoed in the reply
+    uint8_t input;          // InferenceInput
+    uint8_t reserved[3];
+    uint32_t width;         // INPUT_RAW only
+    uint32_t height;
+    uint32_t deadline_ms;   // 0 for the default
+    uint32_t payload_len;
+};
+
+struct InferenceReply {
+    uint32_t magic;
+    uint32_t id;
+    int32_t status;         // InferenceStatus
+    int32_t board;          // analog board that answered, -1 for the host model
+    uint32_t latency_us;    // from receipt to result
+    uint32_t batch_size;    // requests dispatched together with this one
+    float coefficients[INFERENCE_COEFFICIENTS];
+    float softmax[SOFTMAX_SIZE];
+};
+
+static_assert(sizeof(InferenceRequestHeader) == 28, "InferenceRequestHeader is part of the socket protocol");
+static_assert(sizeof(InferenceReply) == 112, "InferenceReply is part of the socket protocol");
+
+struct InferenceServiceStats {
+    uint64_t requests = 0;
+    uint64_t completed = 0;
+    uint64_t failed = 0;        // bad requests, decode failures, timeouts, board failures
+    uint64_t rejected = 0;      // INFER_BUSY
+    uint64_t batches = 0;
+    uint64_t batched = 0;       // requests dispatched in those batches
+    uint64_t max_batch = 0;
+};
+
+class InferenceService {
+public:
+    InferenceService(InferenceBackend &backend, StageCounters &counters);
+    ~InferenceService();
+
+    InferenceService(const InferenceService &) = delete;
+    InferenceService &operator=(const InferenceService &) = delete;
+
+    // An empty socket_path runs the service for in-process callers only. The
+    // socket is served on the given reactor, or on one of the service's own.
+    bool start(const std::string &socket_path = INFERENCE_SOCKET_PATH, int workers = INFERENCE_WORKERS,
+               Reactor *reactor = nullptr);
+    void stop();
+
+    // Run projected coefficients through the backend; blocks until the result
+    // or the deadline. Returns false on timeout or failure. With telemetry, the
+    // submit/answer stamps, status and link fields of the record are filled in.
+    bool infer(const std::vector<double> &coefficients, const Deadline &deadline, InferenceResult &result,
+               TelemetryRecord *telemetry = nullptr);
+
+    // Socket requests are logged here when they complete; set before start()
+    void set_telemetry(TelemetryLog *log) { telemetry_ = log; }
+
+    InferenceServiceStats stats() const;
+
+private:
+    struct Job;
+    struct Client;
+
+    void worker_loop();
+    void dispatch_loop();
+
+    void accept_clients();
+    void on_client(int fd, uint32_t events);
+    void send_replies();
+    bool read_client(Client &client);
+    bool parse_requests(Client &client);
+    bool write_client(Client &client);
+    void close_client(int fd);
+    void admit(std::shared_ptr<Job> job);
+    void complete(const std::shared_ptr<Job> &job, int status, int stage = -1);
+    void wake_io();
+
+    InferenceBackend &backend_;
+    StageCounters &counters_;
+    TelemetryLog *telemetry_ = nullptr;
+    std::string socket_path_;
+    std::atomic<bool> running_{false};
+
+    int listen_fd_ = -1;
+    Reactor *reactor_ = nullptr;
+    std::unique_ptr<Reactor> own_reactor_;
+    std::map<int, std::unique_ptr<Client>> clients_;   // owned by the reactor thread
+    uint64_t next_connection_ = 1;
+
+    std::vector<std::thread> workers_;
+    std::mutex work_mutex_;
+    std::condition_variable work_cv_;
+    std::deque<std::shared_ptr<Job>> work_;
+
+    std::thread dispatch_thread_;
+    std::mutex ready_mutex_;
+    std::condition_variable ready_cv_;
+    std::deque<std::shared_ptr<Job>> ready_;
+    std::atomic<int> queued_{0};
+    std::atomic<size_t> queued_bytes_{0};
+
+    // replies waiting for the reactor thread, by connection id
+    std::mutex reply_mutex_;
+    std::vector<std::pair<uint64_t, InferenceReply>> replies_;
+    bool io_open_ = false;          // replies may be posted to the reactor
+    bool reply_posted_ = false;     // a send_replies() is already on its way
+
+    mutable std::mutex stats_mutex_;
+    InferenceServiceStats stats_;
+};
+
+#endif
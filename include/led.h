@@ -1,5 +1,6 @@
 // WS2811 LED Ring Control for Raspberry Pi 4B (C++)
 // For a 6-unit LED ring
+#pragma once
 #include <iostream>
 #include <stdint.h>
 #include <stdio.h>
@@ -9,6 +10,8 @@
 #include <signal.h>
 #include <ws2811.h>
 
+#include "led_engine.h"
+
 // LED strip configuration
 #define LED_COUNT      8      // Number of LED pixels in your ring
 #define LED_PIN        18     // GPIO pin connected to the pixels (18 uses PWM)
@@ -18,24 +21,21 @@
 #define LED_CHANNEL    0      // PWM channel to use
 #define LED_INVERT     0      // Invert the signal (when using NPN transistor level shift)
 
-// Color definitions
-#define COLOR_RED       0x00FF0000
-#define COLOR_GREEN     0x0000FF00
-#define COLOR_BLUE      0x000000FF
-#define COLOR_WHITE     0x00FFE6E6
-#define COLOR_PURPLE    0x008000FF
-#define COLOR_YELLOW    0x00FFFF00
-#define COLOR_CYAN      0x0000FFFF
-#define COLOR_BLACK     0x00000000
-
 extern ws2811_t ledstring;
 
-// Function forward declarations
+// Frames from LedEngine to the strip
+class Ws2811Renderer : public LedRenderer {
+public:
+    bool render(const uint32_t *leds, int count) override;
+};
+
+// Function forward declarations. These block the caller between frames; the
+// daemon animates the ring through LedEngine instead.
 void colorWipe(uint32_t color, int wait_ms);
 void theaterChase(uint32_t color, int wait_ms, int iterations);
 void rainbow(int wait_ms, int iterations);
 void rainbowCycle(int wait_ms, int iterations);
 void solidColor(uint32_t color);
 void pulse(uint32_t color, int cycles, int wait_ms);
-uint32_t wheel(uint8_t pos);
-void setup_ws2811(void);
+// False (and reported) if the driver cannot be initialised
+bool setup_ws2811(void);
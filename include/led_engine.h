@@ -0,0 +1,135 @@
+#ifndef LED_ENGINE_H
+#define LED_ENGINE_H
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+// Color definitions
+#define COLOR_RED       0x00FF0000
+#define COLOR_GREEN     0x0000FF00
+#define COLOR_BLUE      0x000000FF
+#define COLOR_WHITE     0x00FFE6E6
+#define COLOR_PURPLE    0x008000FF
+#define COLOR_YELLOW    0x00FFFF00
+#define COLOR_CYAN      0x0000FFFF
+#define COLOR_BLACK     0x00000000
+
+#define LED_ENGINE_FPS 50
+// The render thread runs below everything on the button path
+#define LED_ENGINE_NICE 10
+
+// Where frames go: the ws2811 strip (Ws2811Renderer in led.h) or a mock
+class LedRenderer {
+public:
+    virtual ~LedRenderer() = default;
+    // One 0x00RRGGBB value per LED; false if the frame could not be shown
+    virtual bool render(const uint32_t *leds, int count) = 0;
+};
+
+enum LedEffectType {
+    LED_SOLID,              // color at once
+    LED_BLEND,              // fade from what is shown to color over period_ms
+    LED_PULSE,              // fade color in and out, period_ms per cycle
+    LED_WIPE,               // light one LED after another, period_ms apart
+    LED_CHASE,              // every third LED lit, moving every period_ms
+    LED_RAINBOW,            // whole ring through the color wheel, one step per period_ms
+    LED_RAINBOW_CYCLE,      // the wheel spread around the ring, rotating
+};
+
+struct LedEffect {
+    LedEffectType type = LED_SOLID;
+    uint32_t color = COLOR_BLACK;
+    int period_ms = 0;
+    int cycles = 0;         // pulses, chase turns or wheel turns; 0 runs until cancelled
+};
+
+// Renders effects on its own low-priority thread, frame-timed at LED_ENGINE_FPS.
+// Callers only queue a command and return; nothing on the button path waits
+// for the strip.
+//
+// The ring has a base state (set(), blend() or a wipe) and at most one effect
+// on top of it (pulse() and the other animations). When an effect finishes or
+// is cancelled the ring goes back to the base. While nothing moves the thread
+// sleeps.
+class LedEngine {
+public:
+    explicit LedEngine(int count = 8);
+    ~LedEngine();
+
+    LedEngine(const LedEngine &) = delete;
+    LedEngine &operator=(const LedEngine &) = delete;
+
+    bool start(LedRenderer &renderer, int fps = LED_ENGINE_FPS);
+    void stop();
+    bool running() const { return running_; }
+
+    void set(uint32_t color);
+    void blend(uint32_t color, int ms);
+    void pulse(uint32_t color, int period_ms, int cycles = 0);
+    void play(const LedEffect &effect);
+    // End the running effect (not the base color)
+    void cancel();
+
+    // Wait until everything queued so far has been rendered; false on timeout.
+    // For when the light matters, e.g. before the camera meters the scene.
+    bool wait_rendered(int timeout_ms);
+
+    uint64_t frames() const { return frames_.load(std::memory_order_relaxed); }
+
+private:
+    struct Command {
+        enum { EFFECT, CANCEL } kind;
+        LedEffect effect;
+    };
+    struct Running {
+        LedEffect effect;
+        uint64_t start_ns = 0;
+        std::vector<uint32_t> from;     // what was shown when it started, for blends
+        bool active = false;
+    };
+
+    void post(const Command &command);
+    void run();
+    void begin(Running &r, const LedEffect &effect, uint64_t now_ns);
+    // Fills frame_; false once the effect is over
+    bool draw(Running &r, uint64_t now_ns);
+
+    int count_;
+    LedRenderer *renderer_ = nullptr;
+    uint64_t frame_ns_ = 0;
+    std::vector<uint32_t> frame_;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cv_;            // commands and stop for the render thread
+    std::condition_variable rendered_cv_;   // wait_rendered()
+    std::deque<Command> commands_;
+    uint64_t posted_ = 0;
+    uint64_t rendered_ = 0;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> frames_{0};
+};
+
+// Keeps the last frame and counts them, for tests without the strip
+class MockLedRenderer : public LedRenderer {
+public:
+    bool render(const uint32_t *leds, int count) override;
+
+    uint64_t frames();
+    std::vector<uint32_t> last();
+
+private:
+    std::mutex mutex_;
+    uint64_t frames_ = 0;
+    std::vector<uint32_t> last_;
+};
+
+// Color wheel position 0-255 to 0x00RRGGBB
+uint32_t wheel(uint8_t pos);
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef LINK_POOL_H
+#define LINK_POOL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <atomic>
+
+#include "uart_transport.h"
+#include "stm_link.h"
+#include "inference_backend.h"
+
+#define LINK_POOL_REPLY_TIMEOUT_MS 500
+#define LINK_POOL_MAX_FAILURES 3       // consecutive failures before a board leaves rotation
+#define LINK_POOL_PROBE_INTERVAL_MS 2000
+// HELLOs at startup before a board counts as silent, the wait doubling after each
+#define LINK_POOL_HELLO_ATTEMPTS 3
+#define LINK_POOL_HELLO_BACKOFF_MS 50
+
+struct BoardStats {
+    bool healthy = false;
+    int in_flight = 0;
+    uint64_t completed = 0;
+    uint64_t failures = 0;
+    int consecutive_failures = 0;
+    double latency_ewma_us = 0.0;
+};
+
+// Several analog boards, each on its own UART. Each inference goes to the
+// healthy board with the fewest requests in flight; a board that keeps failing
+// is taken out of rotation and re-probed with HELLO in the background, at its
+// last rate and at UART_DEFAULT_BAUD in turn (a power-cycled STM starts over
+// at the default). An answer renegotiates the encoding and the rate on a
+// thread of its own, so the other boards keep serving meanwhile; the board
+// rejoins once the new rate is confirmed.
+class LinkPool : public InferenceBackend {
+public:
+    explicit LinkPool(int max_in_flight_per_board = STM_DEFAULT_IN_FLIGHT);
+    ~LinkPool();
+
+    // Takes ownership of the transport; returns the board index
+    int add_board(std::unique_ptr<UartTransport> uart);
+
+    // HELLO (and baud negotiation) on every board; returns the number of healthy boards
+    int start(const std::vector<int> &baud_candidates, int timeout_ms);
+
+    // One more HELLO to each board out of rotation, waiting for the answer;
+    // returns the number of healthy boards. For callers that own the UARTs
+    // while the pool is not polled (the legacy exchange).
+    int reprobe(int timeout_ms);
+
+    const char *name() const override { return "analog"; }
+
+    // Queue an inference on any board but exclude_board; returns the board it
+    // went to, or -1 if none has room
+    int submit(uint64_t tag, const std::vector<double> &coefficients, int timeout_ms,
+               int exclude_board = -1) override;
+
+    // Wait up to timeout_ms for replies on any board, appending finished requests
+    // (successful or not) to out. Also expires overdue requests and re-probes boards.
+    int poll(std::vector<InferenceResult> &out, int timeout_ms) override;
+
+    // Give up on a request before its reply arrives
+    void cancel(uint64_t tag) override;
+
+    bool has_capacity() const override;
+    int in_flight() const override;
+    void interrupt() override;
+
+    size_t size() const { return boards_.size(); }
+    int healthy() const;
+
+    const BoardStats &stats(int board) const { return boards_[board]->stats; }
+    UartTransport &transport(int board) { return *boards_[board]->uart; }
+
+    void set_reply_timeout_ms(int ms) { reply_timeout_ms_ = ms; }
+
+private:
+    struct Pending {
+        uint64_t tag;
+        std::chrono::steady_clock::time_point sent_at;
+    };
+
+    struct Board {
+        std::unique_ptr<UartTransport> uart;
+        std::unique_ptr<StmLink> link;
+        std::map<uint16_t, Pending> pending;
+        BoardStats stats;
+        int probe_sequence = -1;
+        int probes = 0;
+        int rate = UART_DEFAULT_BAUD;   // as last negotiated
+        std::chrono::steady_clock::time_point next_probe;
+        // renegotiation after a probe answer; poll() leaves the board alone
+        // while the thread exists and joins it once reconnecting is cleared
+        std::thread reconnect;
+        std::atomic<bool> reconnecting{false};
+        bool reconnected = false;
+    };
+
+    // HELLO (retried with backoff) and the fastest baud rate both sides pass
+    bool connect(int index, int timeout_ms, int attempts);
+    void start_reconnect(int index);
+    void finish_reconnect(int index);
+    void drain(int index, std::vector<InferenceResult> &out);
+    void record_failure(int index);
+
+    std::vector<std::unique_ptr<Board>> boards_;
+    int max_in_flight_;
+    std::vector<int> baud_candidates_;
+    int reply_timeout_ms_ = LINK_POOL_REPLY_TIMEOUT_MS;
+    int wake_fd_ = -1;              // polled with the UARTs so interrupt() ends a wait
+};
+
+#endif
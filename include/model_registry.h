@@ -0,0 +1,102 @@
+#ifndef MODEL_REGISTRY_H
+#define MODEL_REGISTRY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <functional>
+
+// Named models the pipelines read while the daemon runs (image PCA, audio PCA).
+//
+// A model is immutable once published. Readers take a reference with get()
+// and keep using that version for the whole inference, even if a newer one is
+// swapped in meanwhile; the old version is freed when its last reader lets
+// go. Replacing a model's files in the data directory (write a temporary file
+// and mv it over, so nothing reads a half-written file) loads the new version
+// without a restart. A version that fails to load is reported and the running
+// one stays.
+
+// A model's files are usually replaced together; wait this long after the
+// last change before loading
+#define MODEL_RELOAD_SETTLE_MS 250
+
+class Model {
+public:
+    virtual ~Model() = default;
+
+    std::string name;
+    uint64_t version = 0;   // 1 for the version loaded at startup
+};
+
+// Projection onto a PCA basis: out[i] = sum_j basis[i][j] * (x[j] - mean[j])
+class PcaModel : public Model {
+public:
+    int components = 0;
+    int features = 0;
+    std::vector<double> basis;  // components x features, row-major
+    std::vector<double> mean;
+
+    const double *row(int component) const { return &basis[(size_t)component * features]; }
+};
+
+// Builds a new version, or returns null (after reporting why) if it cannot
+using ModelLoader = std::function<std::shared_ptr<Model>()>;
+
+// The basis (one comma-separated row per component) and the mean (one value
+// per line) must have exactly the given shape; null otherwise
+std::shared_ptr<Model> load_pca_model(const std::string &components_path, const std::string &mean_path,
+                                      int components, int features);
+
+class ModelRegistry {
+public:
+    ModelRegistry() = default;
+    ~ModelRegistry();
+
+    ModelRegistry(const ModelRegistry &) = delete;
+    ModelRegistry &operator=(const ModelRegistry &) = delete;
+
+    // Register a model and the files it is built from. Registration happens
+    // at startup, before any reader or watch(); it is not thread-safe.
+    void add(const std::string &name, const std::vector<std::string> &files, ModelLoader loader);
+
+    // Build and publish a new version now; false (and the old version kept) on failure
+    bool load(const std::string &name);
+
+    // The current version, null if never loaded. Lock-free with respect to
+    // loads; safe from any thread.
+    std::shared_ptr<const Model> get(const std::string &name) const;
+    template <class T> std::shared_ptr<const T> get_as(const std::string &name) const {
+        return std::dynamic_pointer_cast<const T>(get(name));
+    }
+
+    // Reload models whose files change, from a thread of its own
+    bool watch();
+    void unwatch();
+
+private:
+    struct Entry {
+        std::string name;
+        std::vector<std::pair<std::string, std::string>> files;     // directory, file name
+        ModelLoader loader;
+        std::shared_ptr<const Model> current;   // std::atomic_load/atomic_store only
+        uint64_t version = 0;
+    };
+
+    void run();
+
+    std::map<std::string, std::unique_ptr<Entry>> entries_;
+    std::mutex load_mutex_;                 // one load at a time
+    int inotify_fd_ = -1;
+    int stop_fd_ = -1;
+    std::map<int, std::string> watched_;    // inotify watch descriptor -> directory
+    std::thread thread_;
+};
+
+// The process-wide registry the pipelines register with
+ModelRegistry &model_registry();
+
+#endif
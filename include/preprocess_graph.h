@@ -0,0 +1,157 @@
+#ifndef PREPROCESS_GRAPH_H
+#define PREPROCESS_GRAPH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "deadline.h"
+#include "model_registry.h"
+#include "image_process_pipeline.h"
+
+// The steps from a capture to the 24x24 PCA input, as data instead of code.
+// data/preprocess.csv lists the stages in order, each with its parameters:
+//
+//   # stage[,param=value...]
+//   rotate
+//   vignette,gain=2.5,gamma=3.5
+//   threshold,level=130
+//   digit_crop,level=130
+//   downsample,size=24
+//
+// Planning checks the file against the stage table, works out every stage's
+// output size and fuses runs of per-pixel stages into one pass over the
+// image: point stages (threshold, invert, darken, lighten) collapse into a
+// single 256-entry table, vignette's gain is computed once per image size
+// instead of once per frame, and rotate becomes the order the run reads its
+// input in. The plan is a model in the registry, so a changed file is planned
+// and swapped in without a restart (and a broken one keeps the running plan).
+
+#define PREPROCESS_MODEL "preprocess"
+#define PREPROCESS_CONFIG_PATH "./data/preprocess.csv"
+#define PREPROCESS_MAX_PARAMS 3
+// One bit per stage in a tap mask (stage_taps.h)
+#define PREPROCESS_MAX_STAGES 64
+// A plan must turn a capture this size into FEATURES pixels
+#define PREPROCESS_CHECK_SIZE 1440
+// Pixels a fused pass takes through all of its stages at a time (stays in L1)
+#define PREPROCESS_TILE 4096
+
+enum StageKind {
+    STAGE_POINT,        // output from the pixel's own value: fused into a table
+    STAGE_GAIN,         // the value times a factor that depends on the position: fused
+    STAGE_REVERSE,      // every pixel from the mirrored position: fused as a run's read order
+    STAGE_IMAGE         // needs neighbours, bounds or a new size: a pass of its own
+};
+
+struct StageParam {
+    const char *name;   // null ends the list
+    double value;       // default
+    double min;
+    double max;
+};
+
+struct StageDef {
+    const char *name;
+    StageKind kind;
+    StageParam params[PREPROCESS_MAX_PARAMS + 1];
+    // STAGE_POINT
+    uint8_t (*point)(uint8_t value, const double *params);
+    // STAGE_GAIN: the factor at (x, y) of a width x height image
+    float (*gain)(int x, int y, int width, int height, const double *params);
+    // STAGE_IMAGE: the largest output for an input size, and the stage itself
+    // (out is resized to the output actually produced)
+    void (*shape)(int width, int height, const double *params, int &out_width, int &out_height);
+    void (*run)(const std::vector<uint8_t> &in, int width, int height, const double *params,
+                std::vector<uint8_t> &out, int &out_width, int &out_height, BoundingBox *bbox);
+};
+
+// The stage table; null for an unknown name
+const StageDef *find_stage(const std::string &name);
+
+struct PlannedStage {
+    const StageDef *def;
+    double params[PREPROCESS_MAX_PARAMS];
+};
+
+// One fused step: a table for one or more point stages, or a gain stage
+struct FusedOp {
+    int first;                  // stages first..stage are folded in
+    int stage;
+    const StageDef *gain;       // null for a table
+    uint8_t table[256];
+    // The table up to each folded stage before the last, 256 entries each, so
+    // a tap on one of them costs a lookup instead of an unfused plan
+    std::vector<uint8_t> prefix;
+    // The gain for a PREPROCESS_CHECK_SIZE capture, computed with the plan so
+    // no thread's first frame pays for it
+    int width = 0;
+    int height = 0;
+    std::vector<float> factors;
+};
+
+// One pass over the image: a STAGE_IMAGE stage, or a fused run of stages
+struct PreprocessPass {
+    int first = 0;              // stages first..last
+    int last = 0;
+    const StageDef *image = nullptr;
+    bool reverse = false;       // the run starts with rotate
+    std::vector<FusedOp> ops;
+};
+
+class PreprocessPlan : public Model {
+public:
+    std::vector<PlannedStage> stages;
+    std::vector<PreprocessPass> passes;
+    // PipelineImages::rotated is this stage's output (-1: the capture itself)
+    int raw_stage = -1;
+    // Tap name of each stage: the stage's name, with ".2", ".3"... on repeats
+    std::vector<std::string> taps;
+
+    int find_tap(const std::string &name) const;
+
+    // "rotate+vignette+threshold > digit_crop > ..."
+    std::string describe() const;
+};
+
+// Parse and plan a stage list (fuse = false gives every stage a pass of its
+// own, for comparison); false after reporting the first problem
+bool plan_preprocess(const std::string &text, const std::string &source, bool fuse, PreprocessPlan &plan);
+// Loader for the registry: the file at path, or the built-in default list
+// (the stages the daemon has always run) if there is no such file
+std::shared_ptr<Model> load_preprocess_plan(const std::string &path, bool fuse = true);
+
+// Buffers for running plans on one thread. They are sized when the plan or the
+// image size changes, so a frame of the same size does not allocate.
+class PreprocessWorkspace {
+public:
+    // The 24x24 PCA input in out; false if the deadline passes between passes.
+    // With images, the raw stage's output and the stages in images->tap_mask
+    // are copied there as well.
+    bool run(const std::shared_ptr<const PreprocessPlan> &plan, const std::vector<uint8_t> &image,
+             int width, int height, std::vector<uint8_t> &out, BoundingBox *bbox,
+             const Deadline &deadline, PipelineImages *images);
+
+private:
+    struct Gain {
+        int width = 0;
+        int height = 0;
+        std::vector<float> factors;
+    };
+
+    void size_for(const std::shared_ptr<const PreprocessPlan> &plan, int width, int height);
+    const float *gain_map(size_t slot, const FusedOp &op, const double *params, int width, int height);
+    void run_fused(const PreprocessPlan &plan, const PreprocessPass &pass, size_t &gain_slot,
+                   const uint8_t *in, int width, int height, uint8_t *out, uint64_t copy);
+
+    std::shared_ptr<const PreprocessPlan> plan_;
+    int width_ = 0;
+    int height_ = 0;
+    std::vector<uint8_t> buffers_[2];
+    std::vector<Gain> gains_;   // one per gain op, in plan order, for other sizes
+    std::vector<const float *> factors_;  // the current pass's gain maps
+    std::vector<uint8_t> *copies_[PREPROCESS_MAX_STAGES];   // where this frame's copied stages go
+};
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+// One epoll loop on its own thread for the daemon's descriptors: the button
+// line, the inference and dashboard sockets, and timers. Handlers run on the
+// loop thread and should only move data and hand work to the queues of the
+// threads that do it; they never sleep.
+//
+// add()/modify()/remove(), post() and the timer calls are safe from any thread.
+// A handler removed from another thread may still be running; owners tear down
+// through call(), which runs on the loop thread.
+
+using ReactorHandler = std::function<void(uint32_t events)>;
+
+class Reactor {
+public:
+    Reactor() = default;
+    ~Reactor();
+
+    Reactor(const Reactor &) = delete;
+    Reactor &operator=(const Reactor &) = delete;
+
+    bool start(const char *thread_name = "ann-reactor");
+    void stop();
+    bool running() const { return running_.load(); }
+    bool in_loop() const { return std::this_thread::get_id() == thread_.get_id(); }
+
+    // Watch fd for EPOLLIN/EPOLLOUT/...; the handler gets the ready events
+    bool add(int fd, uint32_t events, ReactorHandler handler);
+    bool modify(int fd, uint32_t events);
+    void remove(int fd);
+
+    // Run fn on the loop thread
+    void post(std::function<void()> fn);
+    // Run fn on the loop thread and wait for it (directly when already on it)
+    void call(std::function<void()> fn);
+
+    // timerfd that fires every interval_ms (once if !repeat); returns an id for cancel_timer()
+    int add_timer(int interval_ms, std::function<void()> fn, bool repeat = true);
+    void cancel_timer(int id);
+
+private:
+    struct Watch {
+        int fd;
+        uint64_t id;
+        ReactorHandler handler;
+    };
+
+    void run();
+    void run_posted();
+
+    int epoll_fd_ = -1;
+    int post_fd_ = -1;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+
+    std::mutex mutex_;                  // guards the maps and posted_
+    std::map<int, std::shared_ptr<Watch>> by_fd_;
+    std::map<uint64_t, std::shared_ptr<Watch>> by_id_;
+    uint64_t next_id_ = 1;              // 0 is the post eventfd
+    std::vector<std::function<void()>> posted_;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <ostream>
+
+// Real-time setup done by the daemon itself instead of chrt/taskset in run.sh.
+//
+// data/realtime.csv assigns a priority and a CPU to each thread by name:
+//
+//   # thread,priority,cpu[,exclusive]
+//   ann-dispatch,90,3,exclusive
+//   ann-capture,80,0
+//
+// A priority of 1-99 runs the thread SCHED_FIFO, 0 leaves it SCHED_OTHER; cpu
+// -1 leaves it unpinned. An exclusive CPU is taken out of the affinity mask of
+// every thread not listed on it, so only its owner (the board exchange) runs
+// there. Boot with isolcpus= on the same CPU to keep the rest of the system off
+// it too.
+//
+// Call realtime_lock_memory() first, before threads and buffers are created, and
+// realtime_apply_threads() once everything is running.
+
+#define REALTIME_CONFIG_PATH "./data/realtime.csv"
+// Default stack for threads created after realtime_lock_memory(); every byte of
+// it is locked, so the glibc default of 8 MB per thread is too much
+#define REALTIME_STACK_SIZE (512 * 1024)
+// How much of the calling thread's stack realtime_prefault_stack() touches
+#define REALTIME_STACK_PREFAULT (64 * 1024)
+// Jitter measurement wake-up period and histogram range
+#define REALTIME_JITTER_INTERVAL_US 1000
+#define REALTIME_JITTER_MAX_US 10000
+
+struct RealtimeThread {
+    std::string name;       // as set with pthread_setname_np()
+    int priority = 0;
+    int cpu = -1;
+    bool exclusive = false;
+};
+
+struct RealtimeConfig {
+    std::vector<RealtimeThread> threads;
+};
+
+// Fills in the default layout: the board exchange alone on CPU 3, the pipeline
+// stages on 0-2
+void realtime_default_config(RealtimeConfig &config);
+// False (and config untouched) if the file does not exist or is malformed
+bool load_realtime_config(const std::string &filename, RealtimeConfig &config);
+
+// mlockall() current and future mappings, keep freed heap memory mapped and
+// shrink the default thread stack. Returns false if the pages could not be
+// locked (no CAP_IPC_LOCK); the rest is done anyway.
+bool realtime_lock_memory();
+// Touch REALTIME_STACK_PREFAULT bytes of the calling thread's stack
+void realtime_prefault_stack();
+// Write every page of [data, data + bytes)
+void realtime_prefault(void *data, size_t bytes);
+
+// Set the scheduling policy, priority and affinity of the calling thread
+bool realtime_setup_thread(int priority, int cpu);
+// Apply the config to every thread of the process by name; returns how many
+// threads were configured
+int realtime_apply_threads(const RealtimeConfig &config);
+
+// cyclictest-style measurement: one thread per configured entry, with its
+// priority and CPU, wakes every REALTIME_JITTER_INTERVAL_US for the given time
+// and records how late it woke. Prints percentiles per thread, CPU migrations
+// and the page faults taken during the run.
+void realtime_measure_jitter(const RealtimeConfig &config, int seconds, std::ostream &os);
+
+#endif
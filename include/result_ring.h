@@ -0,0 +1,98 @@
+#ifndef RESULT_RING_H
+#define RESULT_RING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// Shared-memory ring of inference results for the dashboard process
+// (model/result_ring.py), replacing the softmax CSV, the step JPEGs on disk
+// and the FIFO trigger.
+//
+// Layout of /dev/shm/<name>:
+//   ResultRingHeader                      (64 bytes)
+//   ResultRecord[record_count]            (slot = seq % record_count)
+//   image slab                            (slab_size bytes, from slab_offset)
+//
+// There is one writer and it never waits for readers. A record's seq field is
+// set to 0 while the slot is rewritten and to the record's sequence number
+// once it is complete; head is bumped last. Images are written into the slab
+// at increasing logical offsets (offset % slab_size, never split across the
+// end); an image is still intact while slab_head - offset <= slab_size.
+// After each publish the notify word is incremented and futex waiters on it
+// are woken, so a reader sleeps in FUTEX_WAIT instead of polling.
+
+#define RESULT_RING_NAME "/ann_results"
+#define RESULT_RING_MAGIC "ANNRING1"
+#define RESULT_RING_VERSION 1
+#define RESULT_RING_RECORDS 64
+#define RESULT_RING_SLAB_SIZE (32 * 1024 * 1024)
+#define RESULT_RING_COEFFICIENTS 12
+#define RESULT_RING_SOFTMAX 10
+
+struct ResultRingHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t record_count;
+    uint32_t notify;            // futex word
+    uint64_t slab_offset;
+    uint64_t slab_size;
+    uint64_t head;              // sequence of the newest complete record, 0 if none
+    uint64_t slab_head;         // logical bytes handed out in the slab
+    uint8_t reserved[8];
+};
+
+struct ResultRecord {
+    uint64_t seq;
+    uint64_t capture_ns;        // CLOCK_REALTIME at the button press
+    uint64_t publish_ns;        // CLOCK_REALTIME when the record was published
+    uint64_t raw_offset;        // logical slab offset of the capture JPEG
+    uint64_t processed_offset;  // logical slab offset of the 24x24 JPEG
+    uint32_t raw_len;
+    uint32_t processed_len;
+    uint32_t width;
+    uint32_t height;
+    int32_t bbox[4];            // min_x, max_x, min_y, max_y
+    float coefficients[RESULT_RING_COEFFICIENTS];
+    float softmax[RESULT_RING_SOFTMAX];
+};
+
+static_assert(sizeof(ResultRingHeader) == 64, "ResultRingHeader layout is shared with Python");
+static_assert(sizeof(ResultRecord) == 160, "ResultRecord layout is shared with Python");
+
+class ResultRing {
+public:
+    ResultRing() = default;
+    ~ResultRing();
+
+    ResultRing(const ResultRing &) = delete;
+    ResultRing &operator=(const ResultRing &) = delete;
+
+    // Create or reopen the shared memory object. A ring with the same geometry
+    // is continued so readers that stay attached across restarts keep working.
+    bool create(const std::string &name = RESULT_RING_NAME,
+                uint32_t record_count = RESULT_RING_RECORDS,
+                uint64_t slab_size = RESULT_RING_SLAB_SIZE);
+    void close();
+
+    // Copy the images into the slab, fill in seq/offsets/lengths/publish_ns,
+    // publish the record and wake readers. Returns the record's sequence.
+    uint64_t publish(ResultRecord &record,
+                     const uint8_t *raw, size_t raw_len,
+                     const uint8_t *processed, size_t processed_len);
+
+    bool is_open() const { return header_ != nullptr; }
+    uint64_t head() const;
+
+private:
+    uint64_t write_image(const uint8_t *data, size_t len);
+
+    int fd_ = -1;
+    size_t size_ = 0;
+    ResultRingHeader *header_ = nullptr;
+    ResultRecord *records_ = nullptr;
+    uint8_t *slab_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef SEGMENT_LOG_H
+#define SEGMENT_LOG_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Append-only log split into fixed-size, memory-mapped segment files
+// (<dir>/<prefix>_000000.bin, _000001.bin, ...). Appending is a memcpy into the
+// mapping; a new segment is started when a record no longer fits.
+//
+// Segment layout: SegmentHeader, then records of
+//   [u32 size][u32 type][payload, padded to 8 bytes]
+// where size covers the 8-byte record header and the padded payload. The file
+// is zero-filled beyond the last record, so a size of 0 marks the end even
+// after a crash.
+
+#define SEGMENT_MAGIC "ANNSEG01"
+#define SEGMENT_VERSION 1
+
+struct SegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t segment_index;
+    uint64_t created_ns;
+};
+
+struct SegmentRecordHeader {
+    uint32_t size;
+    uint32_t type;
+};
+
+// A mapped segment file other than the one being appended to
+struct SegmentMapping {
+    int fd = -1;
+    uint8_t *base = nullptr;
+    uint64_t index = 0;
+    size_t used = 0;
+};
+
+class SegmentLog {
+public:
+    SegmentLog() = default;
+    ~SegmentLog();
+
+    SegmentLog(const SegmentLog &) = delete;
+    SegmentLog &operator=(const SegmentLog &) = delete;
+
+    bool open(const std::string &dir, const std::string &prefix, size_t segment_size);
+    void close();
+
+    // Append one record made of up to two parts (e.g. a fixed header and pixels).
+    bool append(uint32_t type, const void *a, size_t a_len, const void *b = nullptr, size_t b_len = 0);
+
+    bool is_open() const { return base_ != nullptr; }
+    uint64_t segment_index() const { return index_; }
+    uint64_t records() const { return records_; }
+
+    // Spare segments. With one installed, append() switches to it without a
+    // syscall and leaves the full segment in take_retired() for someone else
+    // to trim. Mapping and releasing run outside the log; only wants_spare(),
+    // install_spare() and take_retired() need the lock that guards append().
+    bool wants_spare() const { return base_ != nullptr && spare_.base == nullptr; }
+    uint64_t next_index() const { return index_ + 1; }
+    bool map_segment(uint64_t index, SegmentMapping &out) const;
+    void install_spare(SegmentMapping &spare);
+    bool take_retired(SegmentMapping &out);
+    // Unmap, trim to the used length and close; an unused spare is deleted
+    void release_segment(SegmentMapping &mapping) const;
+
+private:
+    bool open_segment(uint64_t index);
+    void close_segment();
+
+    std::string dir_;
+    std::string prefix_;
+    size_t segment_size_ = 0;
+    int fd_ = -1;
+    uint8_t *base_ = nullptr;
+    size_t used_ = 0;
+    uint64_t index_ = 0;
+    uint64_t records_ = 0;
+    SegmentMapping spare_;
+    SegmentMapping retired_;
+};
+
+// Iterate the records of one segment file; returns false if it is not a valid segment.
+// The callback gets the record type, payload pointer and padded payload length.
+bool segment_for_each(const std::string &filename,
+                      void (*fn)(uint32_t type, const uint8_t *payload, size_t len, void *user),
+                      void *user);
+
+// The segment files <dir>/<prefix>_NNNNNN.bin, oldest first
+std::vector<std::string> segment_files(const std::string &dir, const std::string &prefix);
+
+#endif
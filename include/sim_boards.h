@@ -0,0 +1,34 @@
+#ifndef SIM_BOARDS_H
+#define SIM_BOARDS_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "fake_stm.h"
+#include "uart_transport.h"
+
+// Boards for main.exe --sim. Each one is a FakeStm on the master side of a
+// pty; the daemon opens the slave paths like any other --uart device, so the
+// link, framing and the pool are the real ones and only the STM is played.
+#define SIM_BOARDS 1
+// Analog evaluation time per inference on a simulated board
+#define SIM_INFER_US 2000
+
+class SimBoards {
+public:
+    ~SimBoards();
+
+    bool start(int count, const FakeStmConfig &config);
+    void stop();
+
+    // Slave pty paths, one per board, for TtyUartTransport::open()
+    std::vector<std::string> devices() const;
+    uint64_t requests() const;
+
+private:
+    std::vector<PtyPair> ptys_;
+    std::vector<std::unique_ptr<FakeStm>> boards_;
+};
+
+#endif
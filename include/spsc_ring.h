@@ -0,0 +1,114 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <climits>
+#include <vector>
+#include <atomic>
+#include <ctime>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+// Bounded single-producer/single-consumer queue. push() and pop() never take a
+// lock; pop_wait() sleeps on a futex when the ring is empty, and push() only
+// makes the wake-up syscall when the consumer is actually asleep.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) {
+        size_t n = 1;
+        while (n < capacity) n <<= 1;
+        items_.resize(n);
+        mask_ = n - 1;
+    }
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Producer side; false if the ring is full
+    bool push(const T &item) {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail - head_cache_ > mask_)
+                return false;
+        }
+        items_[tail & mask_] = item;
+        tail_.store(tail + 1, std::memory_order_release);
+
+        // pairs with the fence in pop_wait(): either the consumer sees the new
+        // tail or we see that it is waiting
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting_.load(std::memory_order_relaxed))
+            wake();
+        return true;
+    }
+
+    // Consumer side; false if the ring is empty
+    bool pop(T &item) {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_)
+                return false;
+        }
+        item = items_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side; waits up to timeout_ms (-1 forever) for an item. Returns
+    // false on timeout or once the ring is closed and empty.
+    bool pop_wait(T &item, int timeout_ms) {
+        if (pop(item))
+            return true;
+
+        uint32_t seen = signal_.load(std::memory_order_acquire);
+        waiting_.store(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!pop(item)) {
+            if (closed_.load(std::memory_order_acquire)) {
+                waiting_.store(0, std::memory_order_relaxed);
+                return false;
+            }
+            struct timespec ts = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+            syscall(SYS_futex, reinterpret_cast<uint32_t *>(&signal_), FUTEX_WAIT_PRIVATE, seen,
+                    timeout_ms < 0 ? nullptr : &ts, nullptr, 0);
+            waiting_.store(0, std::memory_order_relaxed);
+            return pop(item);
+        }
+        waiting_.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Make pop_wait() return instead of sleeping, now and from then on
+    void close() {
+        closed_.store(1, std::memory_order_release);
+        wake();
+    }
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+    void wake() {
+        signal_.fetch_add(1, std::memory_order_release);
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&signal_), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+private:
+    std::vector<T> items_;
+    size_t mask_ = 0;
+
+    // producer and consumer indices on separate cache lines
+    alignas(64) std::atomic<uint64_t> tail_{0};
+    uint64_t head_cache_ = 0;
+    alignas(64) std::atomic<uint64_t> head_{0};
+    uint64_t tail_cache_ = 0;
+    alignas(64) std::atomic<uint32_t> signal_{0};
+    std::atomic<uint32_t> waiting_{0};
+    std::atomic<uint32_t> closed_{0};
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef STAGE_TAPS_H
+#define STAGE_TAPS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <atomic>
+
+#include "image_process_pipeline.h"
+
+class Reactor;
+
+// Copies of chosen preprocessing stage outputs from live frames, to see what
+// each stage does on a unit without slowing the frames nobody asked about. A
+// tap is a stage of the running plan, named as PreprocessPlan::taps names it.
+// Armed taps copy those outputs of the next frame, or of one frame in every N,
+// into the frame's debug snapshot; the debug encoder thread then writes them
+// out as PGM files. With nothing armed a frame costs one relaxed load, and the
+// preprocessing passes test a zero mask.
+//
+// Taps are armed over a Unix socket, one text command per line, each answered
+// with one line starting "ok" or "error":
+//
+//   list                      the running plan's taps
+//   tap NAME[,NAME...] [N]    the next frame, or one frame in every N; "all" for every stage
+//   off
+//   status
+//
+// e.g. echo "tap threshold,digit_crop" | socat - UNIX-CONNECT:/tmp/ann_taps.sock
+// Commands sent before the client shuts down its side are still answered,
+// including a last one without a newline.
+
+#define TAP_SOCKET_PATH "/tmp/ann_taps.sock"
+#define TAP_DIR "./data/taps"
+#define TAP_MAX_LINE 256
+
+class StageTaps {
+public:
+    StageTaps() = default;
+    ~StageTaps();
+
+    StageTaps(const StageTaps &) = delete;
+    StageTaps &operator=(const StageTaps &) = delete;
+
+    // every = 0 for the next frame only; false (with why in error) if a name
+    // is not a tap of the running plan
+    bool arm(const std::vector<std::string> &names, int every, std::string &error);
+    void disarm();
+
+    // Per frame, from the preprocessing thread: the stages to copy and the
+    // plan version they are numbered for, 0 when nothing is armed
+    uint64_t frame_mask(uint64_t &plan_version) {
+        if (!armed_.load(std::memory_order_relaxed)) return 0;
+        return select(plan_version);
+    }
+
+    // Write a frame's taps as <dir>/<capture_ns>_<stage>_<name>.pgm; from the
+    // encoder thread
+    void write(const std::string &dir, uint64_t capture_ns, const std::vector<TapImage> &taps);
+
+    std::string status() const;
+
+    // Take commands on a Unix socket served by the reactor
+    bool serve(const std::string &path, Reactor &reactor);
+    void stop();
+
+private:
+    uint64_t select(uint64_t &plan_version);
+    std::string command(const std::string &line);
+    void accept_clients();
+    void on_client(int fd);
+    void close_client(int fd);
+
+    mutable std::mutex mutex_;          // guards names_, every_ and counter_
+    std::atomic<bool> armed_{false};
+    std::vector<std::string> names_;
+    int every_ = 0;
+    uint64_t counter_ = 0;
+    std::atomic<uint64_t> frames_{0};   // frames tapped
+    std::atomic<uint64_t> files_{0};    // images written
+    std::atomic<uint64_t> failed_{0};   // images that could not be written
+
+    Reactor *reactor_ = nullptr;
+    std::string path_;
+    int listen_fd_ = -1;
+    std::map<int, std::string> clients_;    // fd -> unanswered input; loop thread only
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include <ostream>
+
+// Daemon startup as a graph of named steps. Each step runs on a thread of its
+// own as soon as the steps it comes after have finished, so the slow ones
+// (board handshakes, model files, camera enumeration, the LED driver) overlap
+// instead of queueing. Steps only touch what they set up and what their
+// dependencies set up; finishing a step publishes its work to the steps after
+// it.
+
+// A step's function returns false when the daemon cannot run without it; the
+// steps after it are skipped and run() returns false
+using StartupFn = std::function<bool()>;
+
+class StartupGraph {
+public:
+    // after names steps added earlier; an unknown name fails run(), since the
+    // step would otherwise race the one it was meant to wait for
+    void add(const std::string &name, const std::vector<std::string> &after, StartupFn fn);
+
+    bool run();
+
+    // Per step: when it started and for how long it ran, in milliseconds from
+    // run(); then the critical path and the total
+    void report(std::ostream &os) const;
+    // Wall time of run(), and the sum of the step times (what running them
+    // one after another would have cost)
+    double total_ms() const;
+    double serial_ms() const;
+
+private:
+    struct Step {
+        std::string name;
+        std::vector<int> after;
+        StartupFn fn;
+        uint64_t start_ns = 0;      // once the dependencies were done
+        uint64_t end_ns = 0;
+        bool ok = false;
+        bool skipped = false;
+    };
+
+    std::vector<Step> steps_;
+    bool unknown_dep_ = false;
+    uint64_t begin_ns_ = 0;
+    uint64_t end_ns_ = 0;
+};
+
+// Seconds since the system booted (CLOCK_BOOTTIME), for time from power-up to ready
+double startup_uptime_s();
+
+// sd_notify(3) without libsystemd: send state (e.g. "READY=1\nSTATUS=...") to
+// $NOTIFY_SOCKET. False if not started by systemd with Type=notify.
+bool startup_notify(const std::string &state);
+
+// Write text to path through a temporary file and rename, so a reader never
+// sees half of it
+bool startup_write_ready_file(const std::string &path, const std::string &text);
+
+#endif
@@ -0,0 +1,188 @@
+#ifndef STM_LINK_H
+#define STM_LINK_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <map>
+#include <chrono>
+
+#include "uart_transport.h"
+
+// Binary frames exchanged with the STM:
+//
+//   0  u8   0xA5        sync word
+//   1  u8   0x5A
+//   2  u16  length      payload bytes (little endian)
+//   4  u16  sequence    echoed back in the response
+//   6  u8   type        responses set bit 7 of the request type
+//   7  ...  payload
+//   n  u16  CRC-16/CCITT-FALSE over bytes 2 .. n-1
+//
+// A receiver that sees a bad CRC or an impossible length drops one byte and
+// hunts for the next sync word, so a lost byte costs one frame, not the link.
+
+#define STM_SYNC0 0xA5
+#define STM_SYNC1 0x5A
+#define STM_FRAME_HEADER 7
+#define STM_FRAME_OVERHEAD (STM_FRAME_HEADER + 2)
+#define STM_MAX_PAYLOAD 256
+
+#define STM_MSG_INFER        0x01  // 12 x int32 coefficients * 10000
+#define STM_MSG_SOFTMAX      0x81  // 10 x int32 softmax * 10000
+#define STM_MSG_HELLO        0x02  // u8 protocol version, u8 capabilities (both directions)
+#define STM_MSG_HELLO_ACK    0x82
+#define STM_MSG_INFER_PACKED 0x03  // 12 x 12-bit DAC codes, two per three bytes
+#define STM_MSG_SOFTMAX_PACKED 0x83  // 10 x u16 softmax, 65535 = 1.0
+#define STM_MSG_SET_BAUD     0x04  // u32 baud; acked at the old rate, then both sides switch
+#define STM_MSG_SET_BAUD_ACK 0x84
+#define STM_MSG_BAUD_COMMIT  0x06  // confirms the new rate, see StmLink::negotiate_baud
+#define STM_MSG_BAUD_COMMIT_ACK 0x86
+#define STM_MSG_ECHO         0x05  // payload is returned unchanged
+#define STM_MSG_ECHO_REPLY   0x85
+#define STM_MSG_ERROR        0xFF  // u8 error code, sent when a request cannot be served
+
+// Protocol versions: 1 = framed int32 only (answers HELLO with STM_MSG_ERROR),
+// 2 = HELLO plus the packed encoding. Firmware that does not answer HELLO at
+// all only speaks the raw "ANN-E" exchange.
+#define STM_PROTOCOL_VERSION 2
+#define STM_CAP_PACKED       (1 << 0)
+#define STM_CAP_BAUD         (1 << 1)  // SET_BAUD / BAUD_COMMIT / ECHO
+
+// The STM returns to its previous rate if no BAUD_COMMIT arrives this long after switching
+#define STM_BAUD_COMMIT_WINDOW_MS 500
+
+// Rates tried, fastest first, when the STM supports changing baud
+static const std::vector<int> STM_BAUD_CANDIDATES = { 3000000, 2000000, 1500000, 1000000, 921600, 460800, 230400 };
+
+#define STM_PACKED_COEFF_BYTES(n) (((n) * 12 + 7) / 8)
+
+#define STM_RESPONSE(type) ((type) | 0x80)
+
+#define STM_SOFTMAX_SIZE 10
+#define STM_DEFAULT_IN_FLIGHT 4
+
+struct StmFrame {
+    uint16_t sequence = 0;
+    uint8_t type = 0;
+    std::vector<uint8_t> payload;
+};
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF);
+
+// Append one encoded frame to out
+void stm_encode_frame(uint16_t sequence, uint8_t type, const uint8_t *payload, size_t len,
+                      std::vector<uint8_t> &out);
+
+// Two 12-bit codes per three bytes, little endian nibble order:
+//   b0 = a[7:0], b1 = a[11:8] | b[3:0] << 4, b2 = b[11:4]
+void stm_pack_codes(const uint16_t *codes, int count, uint8_t *out);
+void stm_unpack_codes(const uint8_t *in, int count, uint16_t *codes);
+
+// Quantized coefficient (a multiple of 2*DAC_FULL_SCALE/DAC_LEVELS) <-> offset-binary DAC code
+uint16_t coefficient_to_dac_code(double coefficient);
+double dac_code_to_coefficient(uint16_t code);
+
+// Incremental decoder with resynchronisation
+class StmFrameParser {
+public:
+    // Feed received bytes, appending every complete valid frame to frames
+    void feed(const uint8_t *data, size_t len, std::vector<StmFrame> &frames);
+    void reset() { buf_.clear(); }
+
+    uint64_t crc_errors() const { return crc_errors_; }
+    uint64_t dropped_bytes() const { return dropped_bytes_; }
+
+private:
+    std::vector<uint8_t> buf_;
+    uint64_t crc_errors_ = 0;
+    uint64_t dropped_bytes_ = 0;
+};
+
+struct StmLinkStats {
+    uint64_t requests = 0;
+    uint64_t responses = 0;
+    uint64_t unmatched = 0;   // responses for unknown or cancelled sequences
+    uint64_t errors = 0;      // STM_MSG_ERROR responses
+    uint64_t cancelled = 0;
+};
+
+// Host side of the framed protocol. Several requests may be in flight; responses
+// are matched to requests by sequence id, whatever order they arrive in.
+class StmLink {
+public:
+    explicit StmLink(UartTransport &uart, int max_in_flight = STM_DEFAULT_IN_FLIGHT);
+
+    // Send a request; returns its sequence id, or -1 if the window is full or the write failed
+    int send(uint8_t type, const uint8_t *payload, size_t len, int timeout_ms);
+
+    // Read whatever arrives within timeout_ms and match it to outstanding requests.
+    // Returns the number of responses matched.
+    int poll(int timeout_ms);
+
+    // Take the response for a sequence if it has arrived
+    bool take(uint16_t sequence, StmFrame &out);
+
+    // poll() until the response for sequence arrives or timeout_ms expires
+    bool wait(uint16_t sequence, StmFrame &out, int timeout_ms);
+
+    // Forget a request; a late response to it is dropped
+    void cancel(uint16_t sequence);
+
+    // Forget every request and any partial frame, e.g. after a rate change
+    void reset();
+
+    // Take any completed response (oldest sequence first)
+    bool take_any(StmFrame &out);
+
+    size_t in_flight() const { return pending_.size(); }
+    bool window_full() const { return (int)pending_.size() >= max_in_flight_; }
+
+    UartTransport &transport() { return uart_; }
+    const StmLinkStats &stats() const { return stats_; }
+    const StmFrameParser &parser() const { return parser_; }
+
+    // Send HELLO with this host's version and capabilities; returns its sequence
+    // id like send(). Every HELLO goes through here so all of them say the same.
+    int send_hello(int timeout_ms);
+
+    // Exchange HELLO to pick the encoding. Returns false if the STM did not answer
+    // at all, in which case only the legacy raw exchange will work.
+    bool negotiate(int timeout_ms);
+    int peer_version() const { return peer_version_; }
+    bool packed() const { return packed_; }
+    bool can_change_baud() const { return baud_capable_; }
+
+    // Step the link up to the fastest candidate (tried in the given order) that
+    // passes an error-free echo test; on any failure both sides fall back to the
+    // current rate. A lost BAUD_COMMIT_ACK is resolved by asking HELLO at both
+    // rates once the STM's commit window has passed. Returns the rate in use
+    // afterwards.
+    int negotiate_baud(const std::vector<int> &candidates, int timeout_ms);
+
+    // Send len bytes of test pattern and check they come back intact
+    bool echo_test(int frames, size_t len, int timeout_ms);
+
+    // Send coefficients with the negotiated encoding (STM_MSG_INFER or STM_MSG_INFER_PACKED)
+    int send_coefficients(const std::vector<double> &coefficients, int timeout_ms);
+    static bool decode_softmax(const StmFrame &frame, std::vector<double> &softmax);
+
+private:
+    // Any reply to HELLO at the current rate (two tries); changes no state
+    bool hello_answered(int timeout_ms);
+
+    UartTransport &uart_;
+    StmFrameParser parser_;
+    int max_in_flight_;
+    uint16_t next_sequence_ = 0;
+    int peer_version_ = 1;
+    bool packed_ = false;
+    bool baud_capable_ = false;
+    std::map<uint16_t, std::chrono::steady_clock::time_point> pending_;
+    std::map<uint16_t, StmFrame> completed_;
+    std::vector<uint8_t> tx_;
+    std::vector<StmFrame> rx_frames_;
+    StmLinkStats stats_;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#include "segment_log.h"
+
+// Per-inference telemetry in a segment log (<dir>/telemetry_000000.bin, ...).
+// append() is a memcpy into the current mapping under a mutex: stage stamps
+// come from the vDSO clock, the next segment is mapped and prefaulted ahead of
+// time and full segments are trimmed by a helper thread, so the inference path
+// makes no syscalls. tools/telemetry_dump.cpp reads the segments back.
+
+#define TELEMETRY_DIR "./data/telemetry"
+#define TELEMETRY_PREFIX "telemetry"
+#define TELEMETRY_SEGMENT_SIZE (4u << 20)
+#define TELEMETRY_COEFFICIENTS 12
+#define TELEMETRY_SOFTMAX 10
+
+#define RECORD_TYPE_TELEMETRY 2
+#define RECORD_TYPE_THERMAL 3
+
+// Monotonic stamps taken as a request moves through the pipeline; 0 if the
+// request never got there
+enum TelemetryStamp {
+    STAMP_START,            // button press or socket request received
+    STAMP_CAPTURED,
+    STAMP_PREPROCESSED,     // 24x24 input ready
+    STAMP_SUBMITTED,        // last submit to the backend
+    STAMP_ANSWERED,         // softmax back (or given up on)
+    STAMP_PUBLISHED,        // handed to the recorder and debug encoder
+    STAMP_COUNT
+};
+
+enum TelemetrySource {
+    TELEMETRY_BUTTON = 1,
+    TELEMETRY_SOCKET = 2
+};
+
+struct TelemetryRecord {
+    uint64_t seq;
+    uint64_t wall_ns;                       // CLOCK_REALTIME at STAMP_START
+    uint64_t stamp_ns[STAMP_COUNT];         // CLOCK_MONOTONIC
+    uint8_t source;                         // TelemetrySource
+    uint8_t status;                         // InferenceStatus
+    int8_t board;                           // -1 for the host model or no answer
+    uint8_t attempts;
+    uint8_t batch_size;
+    int8_t digit;                           // argmax of the softmax, -1 without one
+    int8_t timeout_stage;                   // Stage that ran out of time, -1 for none
+    uint8_t thermal_level;                  // ThermalLevel when the record was written
+    int16_t bbox[4];                        // min_x, max_x, min_y, max_y
+    uint16_t coefficients[TELEMETRY_COEFFICIENTS];  // DAC codes as sent to the boards
+    uint16_t softmax[TELEMETRY_SOFTMAX];    // Q0.16, 65535 = 1.0
+    uint32_t link_latency_us;               // submit to reply on the answering board
+    uint32_t crc_errors;                    // on that board's link so far
+};
+
+static_assert(sizeof(TelemetryRecord) == 136, "TelemetryRecord is stored in telemetry segments");
+
+// One ThermalMonitor sample, logged between the inference records
+struct ThermalRecord {
+    uint64_t stamp_ns;                      // CLOCK_MONOTONIC
+    int32_t temp_mc;                        // millidegrees C
+    uint32_t freq_khz;
+    uint32_t max_freq_khz;
+    uint32_t throttled;                     // firmware get_throttled flags
+    uint8_t level;                          // ThermalLevel
+    uint8_t reserved[7];
+};
+
+static_assert(sizeof(ThermalRecord) == 32, "ThermalRecord is stored in telemetry segments");
+
+// Records read back from telemetry segments by the tools
+struct TelemetrySegments {
+    std::vector<TelemetryRecord> records;
+    std::vector<ThermalRecord> thermal;
+};
+
+// segment_for_each() callback filling the TelemetrySegments passed as user
+inline void telemetry_collect(uint32_t type, const uint8_t *payload, size_t len, void *user) {
+    TelemetrySegments *c = static_cast<TelemetrySegments *>(user);
+    if (type == RECORD_TYPE_TELEMETRY && len >= sizeof(TelemetryRecord)) {
+        TelemetryRecord record;
+        std::memcpy(&record, payload, sizeof(record));
+        c->records.push_back(record);
+    } else if (type == RECORD_TYPE_THERMAL && len >= sizeof(ThermalRecord)) {
+        ThermalRecord record;
+        std::memcpy(&record, payload, sizeof(record));
+        c->thermal.push_back(record);
+    }
+}
+
+uint64_t telemetry_now_ns();
+uint16_t telemetry_quantize_probability(double p);
+double telemetry_probability(uint16_t q);
+// Quantize coefficients and softmax into the record and set the digit
+void telemetry_set_result(TelemetryRecord &record, const std::vector<double> &coefficients,
+                          const std::vector<double> &softmax);
+
+class TelemetryLog {
+public:
+    TelemetryLog() = default;
+    ~TelemetryLog();
+
+    TelemetryLog(const TelemetryLog &) = delete;
+    TelemetryLog &operator=(const TelemetryLog &) = delete;
+
+    bool start(const std::string &dir = TELEMETRY_DIR, size_t segment_size = TELEMETRY_SEGMENT_SIZE);
+    void stop();
+
+    // Assigns record.seq; returns false if the log is not running or the
+    // segment could not be written. Safe to call from any thread.
+    bool append(TelemetryRecord &record);
+    bool append(const ThermalRecord &record);
+
+    // Stamped into every TelemetryRecord appended from now on
+    void set_thermal_level(int level) { thermal_level_.store(level, std::memory_order_relaxed); }
+
+    bool running() const { return running_.load(std::memory_order_relaxed); }
+    uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+    uint64_t failed() const { return failed_.load(std::memory_order_relaxed); }
+
+private:
+    // seq, if given, is assigned the record's sequence number under the lock
+    bool write(uint32_t type, const void *data, size_t len, uint64_t *seq);
+    void housekeeping();
+
+    SegmentLog log_;
+    std::mutex mutex_;                      // guards log_ and seq_
+    uint64_t seq_ = 0;
+    std::thread thread_;
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+    bool wake_requested_ = false;           // set by append() after a rotation
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<int> thermal_level_{0};
+};
+
+#endif
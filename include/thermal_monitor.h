@@ -0,0 +1,103 @@
+#ifndef THERMAL_MONITOR_H
+#define THERMAL_MONITOR_H
+
+#include <cstdint>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+class Reactor;
+
+// Watches the SoC temperature, CPU clock and the firmware's throttle flags
+// and turns them into a level the daemon sheds optional work by, so that a
+// hot Pi gives up dashboard images and capture rate before it gives up
+// latency. Everything is read from sysfs under a configurable root; point it
+// at a directory tree of the same shape to test without the hardware.
+
+#define THERMAL_SYSFS_ROOT "/sys"
+#define THERMAL_INTERVAL_MS 1000
+// The Pi 4 firmware starts capping the clock at 80 C (soft limit) and
+// throttles hard at 85 C; shed before it does
+#define THERMAL_WARM_C 70.0
+#define THERMAL_HOT_C 77.0
+// A level is only left once the temperature is this far below its threshold
+#define THERMAL_HYSTERESIS_C 3.0
+
+// Files under the root
+#define THERMAL_TEMP_FILE "class/thermal/thermal_zone0/temp"                     // millidegrees C
+#define THERMAL_FREQ_FILE "devices/system/cpu/cpu0/cpufreq/scaling_cur_freq"     // kHz
+#define THERMAL_MAX_FREQ_FILE "devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq"
+#define THERMAL_THROTTLED_FILE "devices/platform/soc/soc:firmware/get_throttled" // hex, as vcgencmd get_throttled
+
+// Current-state bits of get_throttled (bits 16-19 are the same, since boot)
+#define THROTTLE_UNDERVOLTAGE   (1u << 0)
+#define THROTTLE_FREQ_CAPPED    (1u << 1)
+#define THROTTLE_THROTTLED      (1u << 2)
+#define THROTTLE_SOFT_TEMP      (1u << 3)
+
+enum ThermalLevel {
+    THERMAL_NORMAL = 0,
+    THERMAL_WARM,       // clock capped or above THERMAL_WARM_C: no full-size dashboard frames
+    THERMAL_HOT,        // throttling or above THERMAL_HOT_C: no debug images, slower --continuous
+    THERMAL_LEVEL_COUNT
+};
+
+const char *thermal_level_name(int level);
+
+struct ThermalConfig {
+    std::string root = THERMAL_SYSFS_ROOT;
+    int interval_ms = THERMAL_INTERVAL_MS;
+    double warm_c = THERMAL_WARM_C;
+    double hot_c = THERMAL_HOT_C;
+    double hysteresis_c = THERMAL_HYSTERESIS_C;
+};
+
+struct ThermalSample {
+    uint64_t stamp_ns = 0;          // CLOCK_MONOTONIC
+    int32_t temp_mc = 0;            // millidegrees C
+    uint32_t freq_khz = 0;
+    uint32_t max_freq_khz = 0;
+    uint32_t throttled = 0;         // get_throttled flags
+    bool has_temp = false;          // which files could be read
+    bool has_freq = false;
+    bool has_throttled = false;
+    int level = THERMAL_NORMAL;
+};
+
+class ThermalMonitor {
+public:
+    using Listener = std::function<void(const ThermalSample &)>;
+
+    ThermalMonitor() = default;
+    ~ThermalMonitor();
+
+    ThermalMonitor(const ThermalMonitor &) = delete;
+    ThermalMonitor &operator=(const ThermalMonitor &) = delete;
+
+    // Samples every interval on the reactor; the listener runs there after
+    // each sample. False if none of the files can be read.
+    bool start(const ThermalConfig &config, Reactor &reactor, Listener listener = nullptr);
+    void stop();
+
+    // Read the files once and classify (no state is changed)
+    bool sample(ThermalSample &out) const;
+
+    // Cheap enough for every frame
+    int level() const { return level_.load(std::memory_order_relaxed); }
+    ThermalSample last() const;
+
+private:
+    void tick();
+    int classify(const ThermalSample &s, int previous) const;
+
+    ThermalConfig config_;
+    Reactor *reactor_ = nullptr;
+    int timer_ = -1;
+    Listener listener_;
+    std::atomic<int> level_{THERMAL_NORMAL};
+    mutable std::mutex mutex_;      // guards last_
+    ThermalSample last_;
+};
+
+#endif
@@ -9,6 +9,8 @@
 #include <cstdlib>
 #include <vector>
 
+#include "deadline.h"
+
 // UART Base Address
 #define UART0_BASE  0xFE201000
 #define UART3_OFFSET 0x600
@@ -22,41 +24,99 @@
 #define UART_LCRH   0x2C  // Line Control Register -> configures data format and other things fr
 #define UART_CR     0x30  // Control Register -> uart enable
 
-volatile uint32_t* uart_base;
+#define UART_CLOCK_HZ 48000000  // PL011 reference clock (init_uart_clock)
+// A full 32-byte TX FIFO drains in under 3 ms at 115200 baud
+#define UART_BUSY_TIMEOUT_MS 50
+
+inline volatile uint32_t* uart_base;
 
-void uart_init() {
+// Map the PL011 register block at UART0_BASE + offset (UART2..5 are 0x400..0xA00)
+inline volatile uint32_t* uart_map(uint32_t offset) {
     int fd = open("/dev/mem", O_RDWR | O_SYNC);
     if (fd < 0) {
         std::cerr << "Failed to open /dev/mem. Try running with sudo." << std::endl;
-        exit(1);
+        return nullptr;
     }
 
-    uart_base = (volatile uint32_t*) mmap(NULL, BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, UART0_BASE);
+    void *base = mmap(NULL, BLOCK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, UART0_BASE);
     close(fd);
 
-    if (uart_base == MAP_FAILED) {
+    if (base == MAP_FAILED) {
         std::cerr << "Memory mapping failed." << std::endl;
-        exit(1);
+        return nullptr;
     }
 
-    uart_base = (volatile uint32_t*)((char*)uart_base + UART3_OFFSET);
+    return (volatile uint32_t*)((char*)base + offset);
+}
+
+// Baud divisor = clock / (16 * baud), split into a 16-bit integer part and a
+// 6-bit fraction. 48 MHz / 115200 gives IBRD=26, FBRD=3.
+inline bool uart_compute_divisors(uint32_t clock_hz, uint32_t baud, uint32_t &ibrd, uint32_t &fbrd) {
+    if (baud == 0 || baud > clock_hz / 16)
+        return false;
+
+    // work in 1/64ths and round once so the fraction can carry into the integer part
+    uint64_t div64 = ((uint64_t)clock_hz * 4 + baud / 2) / baud;
+    ibrd = div64 >> 6;
+    fbrd = div64 & 0x3F;
+    return ibrd >= 1 && ibrd <= 0xFFFF;
+}
+
+// Reset and configure a mapped PL011: 8N1, FIFOs enabled
+inline void uart_configure(volatile uint32_t* base, uint32_t baud = 115200) {
+    uint32_t ibrd = 26, fbrd = 3;
+    if (!uart_compute_divisors(UART_CLOCK_HZ, baud, ibrd, fbrd))
+        std::cerr << "Unsupported baud rate " << baud << ", using 115200" << std::endl;
 
     // Configure UART
-    uart_base[UART_CR / 4] = 0;  
+    base[UART_CR / 4] = 0;  
     
     // this flushes the rx and tx fifo
-    uart_base[UART_LCRH / 4] |= (1 << 4);
-    uart_base[UART_LCRH / 4] &= ~(1 << 4);
+    base[UART_LCRH / 4] |= (1 << 4);
+    base[UART_LCRH / 4] &= ~(1 << 4);
     
     // this sets the baud rate
-    uart_base[UART_IBRD / 4] = 26; 
-    uart_base[UART_FBRD / 4] = 3;
+    base[UART_IBRD / 4] = ibrd; 
+    base[UART_FBRD / 4] = fbrd;
     
     // word is 8-hit + enables fifo  
-    uart_base[UART_LCRH / 4] = (3 << 5) | (1 << 4);
+    base[UART_LCRH / 4] = (3 << 5) | (1 << 4);
     
     // master enable
-    uart_base[UART_CR / 4] = (1 << 0) | (1 << 8) | (1 << 9);
+    base[UART_CR / 4] = (1 << 0) | (1 << 8) | (1 << 9);
+}
+
+// Change the rate of a running PL011; the divisors only latch on an LCRH write.
+// False if the transmitter is still busy at the deadline (a stuck line).
+inline bool uart_set_baud(volatile uint32_t* base, uint32_t baud, const Deadline &deadline) {
+    uint32_t ibrd, fbrd;
+    if (!uart_compute_divisors(UART_CLOCK_HZ, baud, ibrd, fbrd))
+        return false;
+
+    while (base[UART_FR / 4] & (1 << 3)) { // wait while BUSY transmitting
+        if (deadline.expired()) {
+            std::cerr << "UART still busy, baud rate not changed" << std::endl;
+            return false;
+        }
+    }
+    uint32_t cr = base[UART_CR / 4];
+    base[UART_CR / 4] = 0;
+    base[UART_IBRD / 4] = ibrd;
+    base[UART_FBRD / 4] = fbrd;
+    base[UART_LCRH / 4] = base[UART_LCRH / 4];
+    base[UART_CR / 4] = cr;
+    return true;
+}
+
+// False if the registers could not be mapped
+inline bool uart_init() {
+    uart_base = uart_map(UART3_OFFSET);
+    if (!uart_base) {
+        return false;
+    }
+
+    uart_configure(uart_base);
+    return true;
     
     /*
     
@@ -69,19 +129,19 @@ void uart_init() {
     */   
 }
 
-void uart_clear_rx_buffer() {
+inline void uart_clear_rx_buffer() {
     while (!(uart_base[UART_FR / 4] & (1 << 4))) {
         volatile uint32_t dummy = uart_base[UART_DR / 4];
         (void)dummy;
     }
 }
 
-void uart_send_char(char c) {
+inline void uart_send_char(char c) {
     while (uart_base[UART_FR / 4] & (1 << 5)) {} // wait for TX ready
     uart_base[UART_DR / 4] = c;
 }
 
-void uart_send_int32(int32_t int32) {
+inline void uart_send_int32(int32_t int32) {
     uint8_t bytes[4]; 
 
     // convert int32 to byte array 
@@ -97,19 +157,19 @@ void uart_send_int32(int32_t int32) {
     }
 }
 
-void uart_send_string(const char* str) {
+inline void uart_send_string(const char* str) {
     while (*str) {
         uart_send_char(*str++);
     }
 }
 
-char uart_receive_char() {
+inline char uart_receive_char() {
     
     while (uart_base[UART_FR / 4] & (1 << 4)) {} // wait for RX ready
     return uart_base[UART_DR / 4] & 0xFF;
 }
 
-void uart_receive_string(int length, char* buf) {
+inline void uart_receive_string(int length, char* buf) {
     
     int i = 0;
     
@@ -122,7 +182,7 @@ void uart_receive_string(int length, char* buf) {
     
 }
 
-void uart_send_pca_data(std::vector<int32_t> &pca_projection) {
+inline void uart_send_pca_data(std::vector<int32_t> &pca_projection) {
     
     uart_send_string("ANN-E");
     
@@ -0,0 +1,103 @@
+#ifndef UART_TRANSPORT_H
+#define UART_TRANSPORT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <sys/types.h>
+
+#define UART_DEFAULT_DEVICE "/dev/ttyAMA1"
+#define UART_DEFAULT_BAUD 115200
+
+// Byte transport to the STM. Every call takes a timeout in milliseconds
+// (-1 waits forever) so no exchange can hang the daemon.
+class UartTransport {
+public:
+    virtual ~UartTransport() = default;
+
+    // Transfer whatever is possible, waiting at most timeout_ms for the first byte.
+    // Returns the number of bytes moved (0 on timeout) or -1 on error.
+    virtual ssize_t read_some(uint8_t *buf, size_t len, int timeout_ms) = 0;
+    virtual ssize_t write_some(const uint8_t *buf, size_t len, int timeout_ms) = 0;
+
+    // Drop anything already received
+    virtual void flush_input() = 0;
+
+    // File descriptor that becomes readable when data arrives, -1 if the backend has none
+    virtual int fd() const { return -1; }
+
+    virtual const char *name() const = 0;
+
+    // Switch the line rate once pending output has been sent
+    virtual bool set_baud(int baud) = 0;
+    int baud() const { return baud_; }
+
+    // Transfer exactly len bytes unless the timeout (for the whole call) expires first.
+    // Returns the number of bytes moved or -1 on error.
+    ssize_t read(uint8_t *buf, size_t len, int timeout_ms);
+    ssize_t write(const uint8_t *buf, size_t len, int timeout_ms);
+
+    uint64_t rx_bytes() const { return rx_bytes_.load(std::memory_order_relaxed); }
+    uint64_t tx_bytes() const { return tx_bytes_.load(std::memory_order_relaxed); }
+
+protected:
+    int baud_ = UART_DEFAULT_BAUD;
+    std::atomic<uint64_t> rx_bytes_{0};
+    std::atomic<uint64_t> tx_bytes_{0};
+};
+
+// Kernel tty driver (/dev/ttyAMA*) in raw mode; waits block in poll() instead of spinning
+class TtyUartTransport : public UartTransport {
+public:
+    ~TtyUartTransport() override;
+
+    bool open(const std::string &path, int baud = UART_DEFAULT_BAUD);
+    void close();
+
+    ssize_t read_some(uint8_t *buf, size_t len, int timeout_ms) override;
+    ssize_t write_some(const uint8_t *buf, size_t len, int timeout_ms) override;
+    void flush_input() override;
+    int fd() const override { return fd_; }
+    const char *name() const override { return path_.c_str(); }
+    bool set_baud(int baud) override;
+
+private:
+    int fd_ = -1;
+    std::string path_;
+};
+
+// Direct PL011 register access through /dev/mem. There is no interrupt to wait
+// on, so this still polls the flag register, but every wait is bounded.
+class RegisterUartTransport : public UartTransport {
+public:
+    bool open(uint32_t offset, int baud = UART_DEFAULT_BAUD);
+
+    ssize_t read_some(uint8_t *buf, size_t len, int timeout_ms) override;
+    ssize_t write_some(const uint8_t *buf, size_t len, int timeout_ms) override;
+    void flush_input() override;
+    const char *name() const override { return "pl011-registers"; }
+    bool set_baud(int baud) override;
+
+private:
+    volatile uint32_t *base_ = nullptr;
+};
+
+// Pseudo-terminal standing in for the STM: open a TtyUartTransport on
+// slave_path and play the STM side on master_fd.
+struct PtyPair {
+    int master_fd = -1;
+    std::string slave_path;
+};
+
+bool open_pty_pair(PtyPair &pty);
+void close_pty_pair(PtyPair &pty);
+
+// Legacy exchange: "ANN-E" followed by the raw little-endian int32 coefficients
+bool uart_send_pca_data(UartTransport &uart, const std::vector<int32_t> &pca_projection, int timeout_ms);
+
+// Read count little-endian int32 values
+bool uart_receive_int32s(UartTransport &uart, int32_t *out, int count, int timeout_ms);
+
+#endif
@@ -5,6 +5,7 @@
 #include <vector>
 #include <sstream>
 #include <fstream>
+#include <cstdint>
 
 // Function to load a CSV file into a 2D vector (Matrix)
 std::vector<std::vector<double>> loadMatrixCSV(const std::string& filename, int rows, int cols);
@@ -14,4 +15,7 @@ std::vector<double> loadVectorCSV(const std::string& filename, int size);
 
 void writeVectorToCSV(const std::string& filename, const std::vector<double>& data);
 
+// Encode a grayscale image as JPEG into memory (out is replaced)
+bool encodeJPEG(const uint8_t *pixels, int width, int height, int quality, std::vector<uint8_t>& out);
+
 #endif
@@ -0,0 +1,40 @@
+import struct
+import sys
+import numpy as np
+
+# Write MLP weights in the binary format read by DigitalInference (include/digital_inference.h)
+#
+# usage: python3 export_weights.py weights.npz ann_weights.bin [activations]
+#   weights.npz holds W0, b0, W1, b1, ... with W_i shaped (outputs, inputs)
+#   activations is a comma separated list per layer: linear, relu, tanh, sigmoid, softmax
+#   (default: relu for hidden layers, softmax for the last one)
+
+ACTIVATIONS = {'linear': 0, 'relu': 1, 'tanh': 2, 'sigmoid': 3, 'softmax': 4}
+
+
+def export(layers, activations, path):
+    with open(path, 'wb') as f:
+        f.write(b'ANNW')
+        f.write(struct.pack('<II', 1, len(layers)))
+        for (weights, bias), activation in zip(layers, activations):
+            weights = np.asarray(weights, dtype='<f4')
+            bias = np.asarray(bias, dtype='<f4').reshape(-1)
+            outputs, inputs = weights.shape
+            assert bias.shape[0] == outputs
+            f.write(struct.pack('<III', inputs, outputs, ACTIVATIONS[activation]))
+            f.write(np.ascontiguousarray(weights).tobytes())
+            f.write(bias.tobytes())
+
+
+if __name__ == '__main__':
+    data = np.load(sys.argv[1])
+    count = len([k for k in data.files if k.startswith('W')])
+    layers = [(data['W%d' % i], data['b%d' % i]) for i in range(count)]
+
+    if len(sys.argv) > 3:
+        activations = sys.argv[3].split(',')
+    else:
+        activations = ['relu'] * (count - 1) + ['softmax']
+
+    export(layers, activations, sys.argv[2])
+    print("Wrote %d layers to %s" % (count, sys.argv[2]))
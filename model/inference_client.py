@@ -0,0 +1,77 @@
+"""Client for the inference service socket in main.exe (include/inference_service.h)."""
+
+import socket
+import struct
+
+import numpy as np
+
+SOCKET_PATH = '/tmp/ann_inference.sock'
+REQUEST_MAGIC = 0x514E4E41
+REPLY_MAGIC = 0x524E4E41
+
+INPUT_RAW = 1
+INPUT_ENCODED = 2
+INPUT_PIXELS = 3
+
+STATUS = {0: 'ok', 1: 'bad request', 2: 'decode failed', 3: 'busy', 4: 'timeout', 5: 'failed'}
+
+# struct InferenceRequestHeader / struct InferenceReply
+REQUEST = struct.Struct('=IIB3xIIII')
+REPLY = struct.Struct('=IIiiII12f10f')
+
+
+class InferenceClient:
+    """Submit() returns the request id; replies come back in completion order."""
+
+    def __init__(self, path=SOCKET_PATH):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.next_id = 0
+
+    def submit(self, data, input_kind=INPUT_ENCODED, width=0, height=0, deadline_ms=0):
+        data = bytes(data)
+        request_id = self.next_id
+        self.next_id = (self.next_id + 1) & 0xFFFFFFFF
+        header = REQUEST.pack(REQUEST_MAGIC, request_id, input_kind, width, height, deadline_ms, len(data))
+        self.sock.sendall(header + data)
+        return request_id
+
+    def submit_image(self, image, deadline_ms=0):
+        """A 2-D uint8 grayscale array, sent uncompressed."""
+        image = np.ascontiguousarray(image, dtype=np.uint8)
+        return self.submit(image.tobytes(), INPUT_RAW, image.shape[1], image.shape[0], deadline_ms)
+
+    def submit_pixels(self, pixels, deadline_ms=0):
+        """576 preprocessed pixels (the 24x24 PCA input)."""
+        return self.submit(np.asarray(pixels, dtype=np.uint8).tobytes(), INPUT_PIXELS, deadline_ms=deadline_ms)
+
+    def receive(self):
+        data = b''
+        while len(data) < REPLY.size:
+            chunk = self.sock.recv(REPLY.size - len(data))
+            if not chunk:
+                raise ConnectionError('inference service closed the connection')
+            data += chunk
+        fields = REPLY.unpack(data)
+        if fields[0] != REPLY_MAGIC:
+            raise ValueError('bad reply magic')
+        return {
+            'id': fields[1],
+            'status': STATUS.get(fields[2], 'failed'),
+            'board': fields[3],
+            'latency_us': fields[4],
+            'batch_size': fields[5],
+            'coefficients': np.array(fields[6:18], dtype=np.float32),
+            'softmax': np.array(fields[18:28], dtype=np.float32),
+        }
+
+    def infer(self, data, input_kind=INPUT_ENCODED, **kwargs):
+        """Submit one request and wait for its reply."""
+        request_id = self.submit(data, input_kind, **kwargs)
+        while True:
+            reply = self.receive()
+            if reply['id'] == request_id:
+                return reply
+
+    def close(self):
+        self.sock.close()
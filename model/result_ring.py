@@ -0,0 +1,126 @@
+"""Reader for the shared-memory result ring written by main.exe (include/result_ring.h)."""
+
+import ctypes
+import mmap
+import os
+import platform
+import struct
+import time
+
+import numpy as np
+
+RING_PATH = '/dev/shm/ann_results'
+RING_MAGIC = b'ANNRING1'
+RING_VERSION = 1
+
+# struct ResultRingHeader / struct ResultRecord
+HEADER = struct.Struct('<8s4I4Q8x')
+RECORD = struct.Struct('<5Q4I4i12f10f')
+HEAD_OFFSET = 40
+NOTIFY_OFFSET = 20
+
+FUTEX_WAIT = 0
+SYS_FUTEX = {'x86_64': 202, 'aarch64': 98, 'armv7l': 240, 'armv6l': 240}.get(platform.machine())
+
+_libc = ctypes.CDLL(None, use_errno=True)
+
+
+class _Timespec(ctypes.Structure):
+    _fields_ = [('tv_sec', ctypes.c_long), ('tv_nsec', ctypes.c_long)]
+
+
+class Result:
+    def __init__(self, fields, raw_jpg, processed_jpg):
+        (self.seq, self.capture_ns, self.publish_ns, _, _,
+         _, _, self.width, self.height) = fields[:9]
+        self.bbox = fields[9:13]
+        self.coefficients = np.array(fields[13:25], dtype=np.float32)
+        self.softmax = np.array(fields[25:35], dtype=np.float32)
+        self.raw_jpg = raw_jpg
+        self.processed_jpg = processed_jpg
+
+
+class ResultRing:
+    """Follows the ring from the newest record at open time.
+
+    read() returns every record published since the last call, so nothing is
+    missed as long as the reader is less than record_count results behind;
+    `lost` counts the ones it could not recover.
+    """
+
+    def __init__(self, path=RING_PATH):
+        self.file = open(path, 'r+b')
+        self.mem = mmap.mmap(self.file.fileno(), 0)
+        magic, version, record_size, self.record_count, _, self.slab_offset, self.slab_size, _, _ = \
+            HEADER.unpack_from(self.mem, 0)
+        if magic != RING_MAGIC or version != RING_VERSION or record_size != RECORD.size:
+            raise ValueError('not a version %d result ring: %s' % (RING_VERSION, path))
+        self.notify = ctypes.c_uint32.from_buffer(self.mem, NOTIFY_OFFSET)
+        self.next_seq = self.head() + 1
+        self.lost = 0
+
+    def head(self):
+        return struct.unpack_from('<Q', self.mem, HEAD_OFFSET)[0]
+
+    def wait(self, timeout=None):
+        """Block until a record newer than the last one read is published."""
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while self.head() < self.next_seq:
+            value = self.notify.value
+            if self.head() >= self.next_seq:
+                break
+            left = None if deadline is None else deadline - time.monotonic()
+            if left is not None and left <= 0:
+                return False
+            if SYS_FUTEX is None:
+                time.sleep(0.005 if left is None else min(0.005, left))
+                continue
+            ts = None
+            if left is not None:
+                ts = ctypes.byref(_Timespec(int(left), int((left % 1) * 1e9)))
+            _libc.syscall(SYS_FUTEX, ctypes.addressof(self.notify), FUTEX_WAIT, value, ts, None, 0)
+        return True
+
+    def _image(self, offset, length):
+        if length == 0:
+            return b''
+        start = self.slab_offset + offset % self.slab_size
+        data = self.mem[start:start + length]
+        slab_head = struct.unpack_from('<Q', self.mem, HEAD_OFFSET + 8)[0]
+        if slab_head - offset > self.slab_size:
+            return None  # overwritten while we copied it
+        return data
+
+    def read(self):
+        results = []
+        head = self.head()
+        if head - self.next_seq + 1 > self.record_count:
+            skip = head - self.record_count + 1
+            self.lost += skip - self.next_seq
+            self.next_seq = skip
+        while self.next_seq <= head:
+            seq = self.next_seq
+            self.next_seq += 1
+            offset = HEADER.size + (seq % self.record_count) * RECORD.size
+            fields = RECORD.unpack_from(self.mem, offset)
+            raw = self._image(fields[3], fields[5]) if fields[0] == seq else None
+            processed = self._image(fields[4], fields[6]) if fields[0] == seq else None
+            if raw is None or processed is None or RECORD.unpack_from(self.mem, offset)[0] != seq:
+                self.lost += 1
+                continue
+            results.append(Result(fields, raw, processed))
+        return results
+
+    def close(self):
+        del self.notify
+        self.mem.close()
+        self.file.close()
+
+
+def open_ring(path=RING_PATH, retry_interval=0.5):
+    """Wait for main.exe to create the ring, then attach to it."""
+    while True:
+        try:
+            return ResultRing(path)
+        except (FileNotFoundError, ValueError):
+            time.sleep(retry_interval)
@@ -1,14 +1,8 @@
-#include "audio_process_pipeline.h"
+#include "audio_processing_pipeline.h"
 #include "utilities.h"
 #include "math.h"
 
-std::vector<std::vector<double>> __pca_components;
-std::vector<double> __mean_vector;
-
-void audio_processing_init() {
-    __pca_components = loadMatrixCSV("./data/pca_components_audio.csv", 12, 12);
-    __mean_vector = loadVectorCSV("./data/mean_audio.csv", 12);
-}
+#include <complex>
 
 void hann_window(std::vector<float>& frame) {
     int N = frame.size();
@@ -63,11 +57,11 @@ std::vector<float> mel_filterbank(int n_filters, int fft_size, int sample_rate,
     float mel_max = hz_to_mel(fmax);
 
     std::vector<float> mel_points(n_filters + 2);
-    for (int i = 0; i < mel_points.size(); ++i)
+    for (size_t i = 0; i < mel_points.size(); ++i)
         mel_points[i] = mel_to_hz(mel_min + (mel_max - mel_min) * i / (n_filters + 1));
 
     std::vector<int> bin(n_filters + 2);
-    for (int i = 0; i < bin.size(); ++i)
+    for (size_t i = 0; i < bin.size(); ++i)
         bin[i] = static_cast<int>(std::floor((fft_size + 1) * mel_points[i] / sample_rate));
 
     std::vector<float> filters(fft_size / 2 * n_filters, 0.0f);
@@ -158,38 +152,6 @@ std::vector<float> polyphase_resample(const std::vector<float>& input, unsigned
     return output;
 }
 
-// === PCA Globals ===
-
-std::vector<std::vector<double>> loadMatrixCSV(const std::string& path, int rows, int cols) {
-    std::vector<std::vector<double>> matrix(rows, std::vector<double>(cols));
-    std::ifstream file(path);
-    if (!file) {
-        std::cerr << "Error: Could not open file " << path << std::endl;
-        exit(1);
-    }
-    for (int i = 0; i < rows; ++i) {
-        for (int j = 0; j < cols; ++j) {
-            file >> matrix[i][j];
-            if (file.peek() == ',') file.ignore();
-        }
-    }
-    return matrix;
-}
-
-std::vector<double> loadVectorCSV(const std::string& path, int size) {
-    std::vector<double> vec(size);
-    std::ifstream file(path);
-    if (!file) {
-        std::cerr << "Error: Could not open file " << path << std::endl;
-        exit(1);
-    }
-    for (int i = 0; i < size; ++i) {
-        file >> vec[i];
-        if (file.peek() == ',') file.ignore();
-    }
-    return vec;
-}
-
 float compute_rms(const std::vector<float>& segment) {
     float sum = 0.0f;
     for (float s : segment) {
@@ -199,8 +161,13 @@ float compute_rms(const std::vector<float>& segment) {
 }
 
 void audio_processing_init() {
-    __pca_components = loadMatrixCSV("./data/pca_components_audio.csv", 12, 12);
-    __mean_vector = loadVectorCSV("./data/mean_audio.csv", 12);
+    ModelRegistry &registry = model_registry();
+    registry.add(AUDIO_PCA_MODEL, { AUDIO_PCA_COMPONENTS_PATH, AUDIO_PCA_MEAN_PATH }, [] {
+        return load_pca_model(AUDIO_PCA_COMPONENTS_PATH, AUDIO_PCA_MEAN_PATH, AUDIO_PCA_COMPONENTS, AUDIO_PCA_FEATURES);
+    });
+    if (!registry.load(AUDIO_PCA_MODEL)) {
+        exit(1);
+    }
 }
 
 void process_audio(const std::vector<float>& audio_data,
@@ -266,22 +233,20 @@ void process_audio(const std::vector<float>& audio_data,
         }
     }
 
-    if (!save_wav("test_segment.wav", selected_audio, sample_rate, 1)) {
-        std::cerr << "[ERROR] Failed to save test_segment.wav" << std::endl;
-    }
-
     std::vector<double> mfcc = compute_mfcc(selected_audio, sample_rate);
 
+    std::shared_ptr<const PcaModel> model = model_registry().get_as<PcaModel>(AUDIO_PCA_MODEL);
     std::vector<double> centered(12);
     for (int i = 0; i < 12; ++i) {
         std::cerr << mfcc[i] << std::endl;
-        centered[i] = mfcc[i] - __mean_vector[i];
+        centered[i] = mfcc[i] - model->mean[i];
     }
 
-    out_features.assign(__pca_components.size(), 0.0);
-    for (size_t i = 0; i < __pca_components.size(); ++i) {
-        for (size_t j = 0; j < __pca_components[i].size(); ++j) {
-            out_features[i] += __pca_components[i][j] * centered[j];
+    out_features.assign(model->components, 0.0);
+    for (int i = 0; i < model->components; ++i) {
+        const double *row = model->row(i);
+        for (int j = 0; j < model->features; ++j) {
+            out_features[i] += row[j] * centered[j];
         }
     }
 
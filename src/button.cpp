@@ -0,0 +1,218 @@
+#include "button.h"
+#include "telemetry.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/gpio.h>
+
+ButtonSource::ButtonSource() {
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+ButtonSource::~ButtonSource() {
+    if (wake_fd_ >= 0) ::close(wake_fd_);
+}
+
+void ButtonSource::interrupt() {
+    uint64_t one = 1;
+    if (write(wake_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        std::cerr << "Button: failed to interrupt waiter\n";
+}
+
+bool ButtonSource::wait_press(ButtonPress &press, int timeout_ms) {
+    uint64_t start = telemetry_now_ns();
+    while (true) {
+        if (read_press(press))
+            return true;
+
+        int wait = fd() >= 0 ? timeout_ms : BUTTON_POLL_INTERVAL_MS;
+        if (timeout_ms >= 0) {
+            int left = timeout_ms - (int)((telemetry_now_ns() - start) / 1000000);
+            if (left <= 0) return false;
+            if (wait < 0 || left < wait) wait = left;
+        }
+        if (wait_readable(fd(), wait) < 0)
+            return false;
+    }
+}
+
+int ButtonSource::wait_readable(int fd, int timeout_ms) {
+    struct pollfd pfds[2] = { { fd, POLLIN, 0 }, { wake_fd_, POLLIN, 0 } };
+    int n = poll(pfds, 2, timeout_ms);
+    if (n < 0)
+        return errno == EINTR ? 0 : -1;
+    if (pfds[1].revents & POLLIN) {
+        uint64_t count;
+        if (read(wake_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN)
+            std::cerr << "Button: failed to read wake count\n";
+        return -1;
+    }
+    return (pfds[0].revents & (POLLIN | POLLERR | POLLHUP)) ? 1 : 0;
+}
+
+ChardevButton::~ChardevButton() {
+    close();
+}
+
+bool ChardevButton::open(const std::string &chip, int line, int debounce_us) {
+    close();
+    int chip_fd = ::open(chip.c_str(), O_RDONLY | O_CLOEXEC);
+    if (chip_fd < 0) {
+        std::cerr << "Failed to open " << chip << "\n";
+        return false;
+    }
+
+    struct gpio_v2_line_request request;
+    std::memset(&request, 0, sizeof(request));
+    request.offsets[0] = line;
+    request.num_lines = 1;
+    request.event_buffer_size = BUTTON_EVENT_BUFFER;
+    std::strncpy(request.consumer, "ann-button", sizeof(request.consumer) - 1);
+    // pressed pulls the line low: falling edges are presses
+    request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_FALLING | GPIO_V2_LINE_FLAG_BIAS_PULL_UP;
+    if (debounce_us > 0) {
+        request.config.num_attrs = 1;
+        request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_DEBOUNCE;
+        request.config.attrs[0].attr.debounce_period_us = debounce_us;
+        request.config.attrs[0].mask = 1;
+    }
+
+    int err = ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &request);
+    ::close(chip_fd);
+    if (err < 0) {
+        std::cerr << "Failed to request line " << line << " on " << chip << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    fd_ = request.fd;
+    fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+    name_ = chip + ":" + std::to_string(line);
+    return true;
+}
+
+void ChardevButton::close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+bool ChardevButton::read_press(ButtonPress &press) {
+    if (fd_ < 0)
+        return false;
+
+    struct gpio_v2_line_event events[BUTTON_EVENT_BUFFER];
+    while (true) {
+        ssize_t got = read(fd_, events, sizeof(events));
+        if (got < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN)
+                std::cerr << "Button: failed to read line events\n";
+            return false;
+        }
+
+        if (got == 0) return false;
+        // presses that queued up while nobody was looking count as one
+        for (ssize_t i = got / (ssize_t)sizeof(events[0]) - 1; i >= 0; i--) {
+            if (events[i].id != GPIO_V2_LINE_EVENT_FALLING_EDGE) continue;
+            press.timestamp_ns = events[i].timestamp_ns;
+            press.seqno = events[i].line_seqno;
+            return true;
+        }
+    }
+}
+
+RegisterButton::RegisterButton(uint8_t (*read)(uint8_t pin), int pin) : read_(read), pin_(pin) {
+}
+
+bool RegisterButton::read_press(ButtonPress &press) {
+    int level = read_(pin_);
+    bool pressed = !level && last_level_;
+    last_level_ = level;
+    if (!pressed)
+        return false;
+    press.timestamp_ns = telemetry_now_ns();
+    press.seqno = ++seqno_;
+    return true;
+}
+
+PipeButton::~PipeButton() {
+    close();
+}
+
+bool PipeButton::open(const std::string &path) {
+    close();
+    if (mkfifo(path.c_str(), 0660) < 0 && errno != EEXIST) {
+        std::cerr << "Failed to create " << path << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    // opened for writing too, so the pipe never reports hang-up between writers
+    fd_ = ::open(path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0) {
+        std::cerr << "Failed to open " << path << ": " << strerror(errno) << "\n";
+        return false;
+    }
+    path_ = path;
+    partial_len_ = 0;
+    return true;
+}
+
+void PipeButton::close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+bool PipeButton::read_press(ButtonPress &press) {
+    while (fd_ >= 0) {
+        ssize_t got = read(fd_, partial_ + partial_len_, sizeof(partial_) - partial_len_);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        partial_len_ += got;
+        if (partial_len_ < sizeof(partial_)) continue;
+
+        uint64_t timestamp_ns;
+        std::memcpy(&timestamp_ns, partial_, sizeof(timestamp_ns));
+        partial_len_ = 0;
+        press.timestamp_ns = timestamp_ns ? timestamp_ns : telemetry_now_ns();
+        press.seqno = ++seqno_;
+        return true;
+    }
+    return false;
+}
+
+MockButton::MockButton() {
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+MockButton::~MockButton() {
+    if (event_fd_ >= 0) ::close(event_fd_);
+}
+
+bool MockButton::read_press(ButtonPress &press) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_.empty()) {
+        // a press() after this writes the eventfd again
+        uint64_t count;
+        if (read(event_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN)
+            std::cerr << "Button: failed to read mock event count\n";
+        return false;
+    }
+    press = pending_.front();
+    pending_.pop_front();
+    return true;
+}
+
+void MockButton::press(uint64_t timestamp_ns) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back({ timestamp_ns ? timestamp_ns : telemetry_now_ns(), ++seqno_ });
+    }
+    uint64_t one = 1;
+    if (write(event_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        std::cerr << "Button: failed to signal mock press\n";
+}
@@ -0,0 +1,92 @@
+#include "camera_source.h"
+
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "stb/stb_image.h"
+
+// Bilinear scale of the centered square of a grayscale image
+static void crop_and_scale(const uint8_t *src, int src_w, int src_h, std::vector<uint8_t> &out, int width, int height) {
+    int side = std::min(src_w, src_h);
+    int x0 = (src_w - side) / 2;
+    int y0 = (src_h - side) / 2;
+    out.resize((size_t)width * height);
+    for (int y = 0; y < height; y++) {
+        double sy = std::min<double>(side - 1, (y + 0.5) * side / height - 0.5);
+        sy = std::max(0.0, sy);
+        int iy = (int)sy;
+        int iy1 = std::min(iy + 1, side - 1);
+        double fy = sy - iy;
+        for (int x = 0; x < width; x++) {
+            double sx = std::max(0.0, std::min<double>(side - 1, (x + 0.5) * side / width - 0.5));
+            int ix = (int)sx;
+            int ix1 = std::min(ix + 1, side - 1);
+            double fx = sx - ix;
+            const uint8_t *r0 = src + (size_t)(y0 + iy) * src_w + x0;
+            const uint8_t *r1 = src + (size_t)(y0 + iy1) * src_w + x0;
+            double top = r0[ix] + (r0[ix1] - r0[ix]) * fx;
+            double bottom = r1[ix] + (r1[ix1] - r1[ix]) * fx;
+            out[(size_t)y * width + x] = (uint8_t)(top + (bottom - top) * fy + 0.5);
+        }
+    }
+}
+
+bool ReplayCamera::open(const std::string &path, int width, int height, int capture_us) {
+    std::vector<std::string> files;
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+        DIR *dir = opendir(path.c_str());
+        while (struct dirent *e = dir ? readdir(dir) : nullptr) {
+            std::string name = e->d_name;
+            if (name.size() > 4 && (name.compare(name.size() - 4, 4, ".jpg") == 0 ||
+                                    name.compare(name.size() - 4, 4, ".png") == 0))
+                files.push_back(path + "/" + name);
+        }
+        if (dir) closedir(dir);
+        std::sort(files.begin(), files.end());
+    } else {
+        files.push_back(path);
+    }
+
+    frames_.clear();
+    for (const std::string &file : files) {
+        int w, h, channels;
+        uint8_t *pixels = stbi_load(file.c_str(), &w, &h, &channels, 1);
+        if (!pixels) {
+            std::cerr << "Replay camera: cannot decode " << file << "\n";
+            continue;
+        }
+        frames_.emplace_back();
+        crop_and_scale(pixels, w, h, frames_.back(), width, height);
+        stbi_image_free(pixels);
+    }
+    if (frames_.empty()) {
+        std::cerr << "Replay camera: no images in " << path << "\n";
+        return false;
+    }
+    next_ = 0;
+    capture_us_ = capture_us;
+    return true;
+}
+
+bool ReplayCamera::capture(std::vector<uint8_t> &image, const Deadline &deadline) {
+    if (frames_.empty())
+        return false;
+
+    // the sensor's exposure and readout, cut short like a real capture by the deadline
+    auto ready = std::chrono::steady_clock::now() + std::chrono::microseconds(capture_us_);
+    if (!deadline.is_never() && deadline.at < ready) {
+        std::this_thread::sleep_until(deadline.at);
+        return false;
+    }
+    std::this_thread::sleep_until(ready);
+
+    const std::vector<uint8_t> &frame = frames_[next_];
+    next_ = (next_ + 1) % frames_.size();
+    image.assign(frame.begin(), frame.end());
+    return true;
+}
@@ -0,0 +1,90 @@
+#include "capture_recorder.h"
+
+#include <iostream>
+#include <cstring>
+#include <pthread.h>
+
+CaptureRecorder::~CaptureRecorder() {
+    stop();
+}
+
+bool CaptureRecorder::start(const std::string &dir, size_t segment_size, int queue_depth, size_t max_frame_bytes) {
+    if (!log_.open(dir, "capture", segment_size))
+        return false;
+
+    slots_.assign(queue_depth, Slot());
+    free_.clear();
+    for (Slot &slot : slots_) {
+        slot.pixels.resize(max_frame_bytes);
+        free_.push_back(&slot);
+    }
+
+    running_ = true;
+    thread_ = std::thread(&CaptureRecorder::run, this);
+    return true;
+}
+
+void CaptureRecorder::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+            return;
+        running_ = false;
+    }
+    cv_.notify_one();
+    thread_.join();
+    log_.close();
+}
+
+bool CaptureRecorder::submit(const CaptureRecord &record, const uint8_t *pixels, size_t length) {
+    Slot *slot = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (running_ && !free_.empty()) {
+            slot = free_.back();
+            free_.pop_back();
+        }
+    }
+
+    if (!slot || length > slot->pixels.size()) {
+        if (slot) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.push_back(slot);
+        }
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    slot->record = record;
+    std::memcpy(slot->pixels.data(), pixels, length);
+    slot->length = length;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_.push_back(slot);
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void CaptureRecorder::run() {
+    pthread_setname_np(pthread_self(), "ann-recorder");
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return !ready_.empty() || !running_; });
+        if (ready_.empty())
+            break;
+
+        Slot *slot = ready_.front();
+        ready_.pop_front();
+        lock.unlock();
+
+        if (log_.append(RECORD_TYPE_CAPTURE, &slot->record, sizeof(slot->record), slot->pixels.data(), slot->length))
+            recorded_.fetch_add(1, std::memory_order_relaxed);
+        else
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+
+        lock.lock();
+        free_.push_back(slot);
+    }
+}
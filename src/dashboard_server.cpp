@@ -0,0 +1,346 @@
+#include "dashboard_server.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+
+using Clock = std::chrono::steady_clock;
+
+// Frames gathered into one sendmsg; five buffers each
+#define DASHBOARD_MAX_GATHER 8
+
+static void put_be64(uint8_t *dst, uint64_t value) {
+    for (int i = 7; i >= 0; i--) {
+        dst[i] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+void DashboardFrame::finish() {
+    put_be64(head, size() - 8);
+    put_be64(head + 8, raw_jpg.size());
+    put_be64(middle, processed_jpg.size());
+    tail[0] = sizeof(softmax);
+    std::memcpy(tail + 1, softmax, sizeof(softmax));
+    tail[sizeof(tail) - 1] = 0;
+}
+
+size_t DashboardFrame::size() const {
+    return sizeof(head) + raw_jpg.size() + sizeof(middle) + processed_jpg.size() + sizeof(tail);
+}
+
+// The five pieces of a frame, skipping the first `offset` bytes
+static int frame_iovecs(const DashboardFrame &frame, size_t offset, struct iovec *iov) {
+    const struct { const void *data; size_t len; } parts[5] = {
+        { frame.head, sizeof(frame.head) },
+        { frame.raw_jpg.data(), frame.raw_jpg.size() },
+        { frame.middle, sizeof(frame.middle) },
+        { frame.processed_jpg.data(), frame.processed_jpg.size() },
+        { frame.tail, sizeof(frame.tail) },
+    };
+    int n = 0;
+    for (const auto &part : parts) {
+        if (offset >= part.len) {
+            offset -= part.len;
+            continue;
+        }
+        iov[n].iov_base = const_cast<uint8_t *>(static_cast<const uint8_t *>(part.data)) + offset;
+        iov[n].iov_len = part.len - offset;
+        offset = 0;
+        n++;
+    }
+    return n;
+}
+
+DashboardServer::~DashboardServer() {
+    stop();
+}
+
+bool DashboardServer::start(const DashboardConfig &config, Reactor *reactor) {
+    stop();
+    config_ = config;
+
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        std::cerr << "Dashboard: failed to create socket\n";
+        return false;
+    }
+    int one = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config.port);
+    if (inet_pton(AF_INET, config.bind_address.c_str(), &addr.sin_addr) != 1) {
+        std::cerr << "Dashboard: bad bind address " << config.bind_address << "\n";
+        stop();
+        return false;
+    }
+    if (bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd_, 8) < 0) {
+        std::cerr << "Dashboard: cannot listen on " << config.bind_address << ":" << config.port
+                  << ": " << strerror(errno) << "\n";
+        stop();
+        return false;
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr), &len);
+    port_ = ntohs(addr.sin_port);
+
+    if (!reactor) {
+        own_reactor_.reset(new Reactor());
+        if (!own_reactor_->start("ann-dashboard")) {
+            stop();
+            return false;
+        }
+        reactor = own_reactor_.get();
+    }
+    reactor_ = reactor;
+
+    stats_ = DashboardStats();
+    running_ = true;
+    reactor_->add(listen_fd_, EPOLLIN, [this](uint32_t) { accept_clients(); });
+    stall_timer_ = reactor_->add_timer(DASHBOARD_STALL_CHECK_MS, [this] { check_stalls(); });
+    std::cerr << "Dashboard server listening on " << config.bind_address << ":" << port_ << "\n";
+    return true;
+}
+
+void DashboardServer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        running_ = false;
+    }
+    if (reactor_) {
+        // runs after any delivery already posted
+        reactor_->call([this] {
+            reactor_->cancel_timer(stall_timer_);
+            stall_timer_ = -1;
+            if (listen_fd_ >= 0) reactor_->remove(listen_fd_);
+            while (!clients_.empty())
+                disconnect(clients_.begin()->first, false);
+        });
+    }
+    if (own_reactor_) {
+        own_reactor_->stop();
+        own_reactor_.reset();
+    }
+    reactor_ = nullptr;
+    if (listen_fd_ >= 0) close(listen_fd_);
+    listen_fd_ = -1;
+    pending_.clear();
+}
+
+void DashboardServer::broadcast(std::shared_ptr<const DashboardFrame> frame) {
+    std::lock_guard<std::mutex> lock(pending_mutex_);
+    if (!running_) return;
+    pending_.push_back(std::move(frame));
+    reactor_->post([this] { deliver(); });
+}
+
+DashboardStats DashboardServer::stats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_;
+}
+
+void DashboardServer::on_client(int fd, uint32_t events) {
+    auto it = clients_.find(fd);
+    if (it == clients_.end()) return;
+    if (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+        disconnect(fd, false);
+        return;
+    }
+    if (events & EPOLLIN) {
+        // dashboards send nothing; drain and watch for EOF
+        char buf[256];
+        ssize_t got = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+        if (got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR)) {
+            disconnect(fd, false);
+            return;
+        }
+    }
+    if ((events & EPOLLOUT) && !flush(it->second))
+        disconnect(fd, false);
+}
+
+void DashboardServer::deliver() {
+    std::vector<std::shared_ptr<const DashboardFrame>> frames;
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex_);
+        frames.swap(pending_);
+    }
+    if (frames.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.frames_broadcast += frames.size();
+    }
+
+    std::vector<int> failed;
+    for (auto &entry : clients_) {
+        Client &client = entry.second;
+        for (const auto &frame : frames) {
+            if (client.fd < 0) break;
+            enqueue(client, frame);
+        }
+        if (client.fd < 0 || !flush(client))
+            failed.push_back(entry.first);
+    }
+    for (int fd : failed) {
+        auto it = clients_.find(fd);
+        disconnect(fd, it != clients_.end() && it->second.fd < 0);
+    }
+}
+
+// A client that stops reading is let go rather than held forever
+void DashboardServer::check_stalls() {
+    std::vector<int> stalled;
+    for (auto &entry : clients_) {
+        Client &client = entry.second;
+        if (!client.queue.empty() &&
+            Clock::now() - client.last_progress > std::chrono::milliseconds(config_.stall_timeout_ms)) {
+            std::cerr << "Dashboard: client " << client.peer << " stalled\n";
+            stalled.push_back(entry.first);
+        }
+    }
+    for (int fd : stalled)
+        disconnect(fd, true);
+}
+
+void DashboardServer::accept_clients() {
+    while (true) {
+        struct sockaddr_in addr;
+        socklen_t len = sizeof(addr);
+        int fd = accept4(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr), &len,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EINTR)
+                std::cerr << "Dashboard: accept failed: " << strerror(errno) << "\n";
+            return;
+        }
+
+        char ip[INET_ADDRSTRLEN] = "?";
+        inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
+        std::string peer = std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port));
+
+        if ((int)clients_.size() >= config_.max_clients) {
+            std::cerr << "Dashboard: rejecting " << peer << ", " << clients_.size() << " clients connected\n";
+            close(fd);
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.rejected++;
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        Client &client = clients_[fd];
+        client.fd = fd;
+        client.peer = peer;
+        client.last_progress = Clock::now();
+        reactor_->add(fd, EPOLLIN | EPOLLRDHUP, [this, fd](uint32_t events) { on_client(fd, events); });
+
+        std::cerr << "Dashboard: connection from " << peer << "\n";
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.accepted++;
+        stats_.clients = clients_.size();
+    }
+}
+
+void DashboardServer::enqueue(Client &client, const std::shared_ptr<const DashboardFrame> &frame) {
+    if (client.queue.size() < config_.queue_frames) {
+        client.queue.push_back(frame);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    switch (config_.policy) {
+    case DROP_OLDEST: {
+        // a partly written frame has to finish or the stream loses sync
+        size_t victim = client.sent > 0 ? 1 : 0;
+        if (victim < client.queue.size()) {
+            client.queue.erase(client.queue.begin() + victim);
+            client.queue.push_back(frame);
+        }
+        stats_.frames_dropped++;
+        break;
+    }
+    case DROP_NEWEST:
+        stats_.frames_dropped++;
+        break;
+    case DROP_CLIENT:
+        std::cerr << "Dashboard: client " << client.peer << " fell behind\n";
+        client.fd = -1;
+        break;
+    }
+}
+
+bool DashboardServer::flush(Client &client) {
+    while (!client.queue.empty()) {
+        struct iovec iov[DASHBOARD_MAX_GATHER * 5];
+        int count = 0;
+        size_t offset = client.sent;
+        for (size_t f = 0; f < client.queue.size() && f < DASHBOARD_MAX_GATHER; f++) {
+            count += frame_iovecs(*client.queue[f], offset, iov + count);
+            offset = 0;
+        }
+
+        struct msghdr msg = {};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = count;
+        ssize_t written = sendmsg(client.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        client.last_progress = Clock::now();
+
+        size_t left = written;
+        uint64_t completed = 0;
+        while (left > 0 && !client.queue.empty()) {
+            size_t remaining = client.queue.front()->size() - client.sent;
+            if (left < remaining) {
+                client.sent += left;
+                left = 0;
+            } else {
+                left -= remaining;
+                client.sent = 0;
+                client.queue.pop_front();
+                completed++;
+            }
+        }
+        if (completed) {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.frames_sent += completed;
+        }
+    }
+    arm(client, !client.queue.empty());
+    return true;
+}
+
+void DashboardServer::arm(Client &client, bool writable) {
+    if (client.writable_armed == writable) return;
+    reactor_->modify(client.fd, EPOLLIN | EPOLLRDHUP | (writable ? EPOLLOUT : 0));
+    client.writable_armed = writable;
+}
+
+void DashboardServer::disconnect(int fd, bool dropped) {
+    auto it = clients_.find(fd);
+    if (it == clients_.end()) return;
+    reactor_->remove(fd);
+    close(fd);
+    std::cerr << "Dashboard: " << it->second.peer << " disconnected\n";
+    clients_.erase(it);
+
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    stats_.disconnected++;
+    if (dropped) stats_.clients_dropped++;
+    stats_.clients = clients_.size();
+}
@@ -0,0 +1,139 @@
+#include "debug_encoder.h"
+#include "utilities.h"
+
+#include <iostream>
+#include <algorithm>
+#include <pthread.h>
+
+DebugImageEncoder::DebugImageEncoder() {
+    stages_[DEBUG_STAGE_RAW] = { DEBUG_RAW_SIZE, DEBUG_RAW_QUALITY };
+    stages_[DEBUG_STAGE_PROCESSED] = { DEBUG_PROCESSED_SIZE, DEBUG_PROCESSED_QUALITY };
+}
+
+DebugImageEncoder::~DebugImageEncoder() {
+    stop();
+}
+
+bool DebugImageEncoder::start(Sink sink, int queue_depth, int filling) {
+    if (queue_depth < 1 || filling < 1)
+        return false;
+    sink_ = std::move(sink);
+
+    // queued snapshots, plus the ones being filled and one being encoded
+    pool_.assign(queue_depth + filling + 1, DebugSnapshot());
+    free_.clear();
+    for (DebugSnapshot &snapshot : pool_)
+        free_.push_back(&snapshot);
+    ready_.clear();
+
+    running_ = true;
+    thread_ = std::thread(&DebugImageEncoder::run, this);
+    return true;
+}
+
+void DebugImageEncoder::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+            return;
+        running_ = false;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void DebugImageEncoder::set_stage(int stage, const DebugStageSettings &settings) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stage >= 0 && stage < DEBUG_STAGE_COUNT)
+        stages_[stage] = settings;
+}
+
+DebugSnapshot *DebugImageEncoder::acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_)
+        return nullptr;
+    if (!free_.empty()) {
+        DebugSnapshot *snapshot = free_.back();
+        free_.pop_back();
+        snapshot->has_images = false;
+        return snapshot;
+    }
+
+    // every slot is queued or busy: reuse the oldest queued one, keeping its result
+    for (Pending &pending : ready_) {
+        if (!pending.snapshot)
+            continue;
+        DebugSnapshot *snapshot = pending.snapshot;
+        pending.result = snapshot->result;
+        pending.snapshot = nullptr;
+        snapshot->has_images = false;
+        superseded_.fetch_add(1, std::memory_order_relaxed);
+        return snapshot;
+    }
+    return nullptr;
+}
+
+void DebugImageEncoder::submit(DebugSnapshot *snapshot) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_.push_back({ snapshot, ResultRecord() });
+    }
+    cv_.notify_one();
+}
+
+void DebugImageEncoder::release(DebugSnapshot *snapshot) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_.push_back(snapshot);
+}
+
+void DebugImageEncoder::encode(DebugSnapshot &snapshot, const DebugStageSettings *stages) {
+    const std::vector<uint8_t> *pixels[DEBUG_STAGE_COUNT] = { &snapshot.images.rotated, &snapshot.images.processed };
+    int sizes[DEBUG_STAGE_COUNT] = { (int)snapshot.result.width, DOWNSAMPLE_SIZE };
+
+    for (int s = 0; s < DEBUG_STAGE_COUNT; s++) {
+        int size = sizes[s];
+        snapshot.jpeg[s].clear();
+        if ((int)pixels[s]->size() != size * size)
+            continue;
+
+        const uint8_t *data = pixels[s]->data();
+        int out_size = stages[s].size > 0 && stages[s].size < size ? stages[s].size : size;
+        if (out_size != size) {
+            downsampleInterArea(*pixels[s], size, size, out_size, out_size, scaled_);
+            data = scaled_.data();
+        }
+        encodeJPEG(data, out_size, out_size, stages[s].quality, snapshot.jpeg[s]);
+    }
+    // a snapshot filled without images (to save the work) publishes only its result
+    snapshot.has_images = !snapshot.jpeg[DEBUG_STAGE_RAW].empty() || !snapshot.jpeg[DEBUG_STAGE_PROCESSED].empty();
+}
+
+void DebugImageEncoder::run() {
+    pthread_setname_np(pthread_self(), "ann-encoder");
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return !ready_.empty() || !running_; });
+        if (ready_.empty())
+            break;
+
+        Pending pending = ready_.front();
+        ready_.pop_front();
+        DebugStageSettings stages[DEBUG_STAGE_COUNT];
+        std::copy(stages_, stages_ + DEBUG_STAGE_COUNT, stages);
+        lock.unlock();
+
+        if (pending.snapshot) {
+            encode(*pending.snapshot, stages);
+            encoded_.fetch_add(1, std::memory_order_relaxed);
+            sink_(*pending.snapshot);
+        } else {
+            DebugSnapshot metadata;
+            metadata.result = pending.result;
+            sink_(metadata);
+        }
+
+        lock.lock();
+        if (pending.snapshot)
+            free_.push_back(pending.snapshot);
+    }
+}
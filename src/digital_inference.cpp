@@ -0,0 +1,154 @@
+#include "digital_inference.h"
+#include "stm_link.h"
+#include "image_process_pipeline.h"
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+
+static bool read_u32(std::ifstream &file, uint32_t &v) {
+    return static_cast<bool>(file.read(reinterpret_cast<char *>(&v), sizeof(v)));
+}
+
+bool DigitalInference::load(const std::string &filename, const AnalogModel &model) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error: Unable to open file " << filename << std::endl;
+        return false;
+    }
+
+    char magic[4];
+    uint32_t version, count;
+    if (!file.read(magic, 4) || std::memcmp(magic, ANN_WEIGHTS_MAGIC, 4) != 0 ||
+        !read_u32(file, version) || version != ANN_WEIGHTS_VERSION || !read_u32(file, count)) {
+        std::cerr << "Error: " << filename << " is not a version " << ANN_WEIGHTS_VERSION << " weight file\n";
+        return false;
+    }
+    if (count == 0 || count > ANN_WEIGHTS_MAX_LAYERS) {
+        std::cerr << "Error: " << filename << " has " << count << " layers\n";
+        return false;
+    }
+
+    model_ = model;
+    rng_.seed(model.seed);
+    std::normal_distribution<float> mismatch(0.0f, static_cast<float>(model.weight_mismatch));
+
+    std::vector<Layer> layers;
+    for (uint32_t l = 0; l < count; l++) {
+        uint32_t in, out, act;
+        if (!read_u32(file, in) || !read_u32(file, out) || !read_u32(file, act) ||
+            act > ACTIVATION_SOFTMAX || (l > 0 && in != (uint32_t)layers.back().weights.rows())) {
+            std::cerr << "Error: bad layer " << l << " in " << filename << "\n";
+            return false;
+        }
+        if (in == 0 || out == 0 || in > ANN_WEIGHTS_MAX_UNITS || out > ANN_WEIGHTS_MAX_UNITS) {
+            std::cerr << "Error: layer " << l << " in " << filename << " is " << in << " -> " << out << "\n";
+            return false;
+        }
+
+        Layer layer;
+        // stored row-major, Eigen defaults to column-major
+        Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> w(out, in);
+        layer.bias.resize(out);
+        if (!file.read(reinterpret_cast<char *>(w.data()), sizeof(float) * in * out) ||
+            !file.read(reinterpret_cast<char *>(layer.bias.data()), sizeof(float) * out)) {
+            std::cerr << "Error: " << filename << " is truncated\n";
+            return false;
+        }
+        layer.weights = w;
+        layer.activation = static_cast<Activation>(act);
+
+        if (model.weight_mismatch > 0.0) {
+            layer.weights = layer.weights.unaryExpr([&](float v) { return v * (1.0f + mismatch(rng_)); });
+        }
+        layers.push_back(std::move(layer));
+    }
+
+    // the coefficients come from the PCA stage and the result is read as ten digits
+    int n_in = layers.front().weights.cols(), n_out = layers.back().weights.rows();
+    if (n_in != COMPONENTS || n_out != SOFTMAX_SIZE) {
+        std::cerr << "Error: " << filename << " maps " << n_in << " -> " << n_out << ", expected "
+                  << COMPONENTS << " -> " << SOFTMAX_SIZE << "\n";
+        return false;
+    }
+
+    layers_ = std::move(layers);
+    std::cerr << "Loaded digital model: " << layers_.size() << " layers, " << inputs() << " -> " << outputs() << std::endl;
+    return true;
+}
+
+void DigitalInference::infer(const std::vector<double> &coefficients, std::vector<double> &softmax) {
+    int n = inputs();
+    x_.resize(n);
+    for (int i = 0; i < n; i++) {
+        double c = i < (int)coefficients.size() ? coefficients[i] : 0.0;
+        if (model_.input_bits > 0)
+            c = dac_code_to_coefficient(coefficient_to_dac_code(c));
+        x_[i] = static_cast<float>(c);
+    }
+
+    std::normal_distribution<float> noise(0.0f, static_cast<float>(model_.activation_noise));
+    for (size_t l = 0; l < layers_.size(); l++) {
+        const Layer &layer = layers_[l];
+        y_.noalias() = layer.weights * x_;
+        y_ += layer.bias;
+        if (model_.activation_noise > 0.0)
+            y_ = y_.unaryExpr([&](float v) { return v + noise(rng_); });
+
+        switch (layer.activation) {
+        case ACTIVATION_RELU: y_ = y_.cwiseMax(0.0f); break;
+        case ACTIVATION_TANH: y_ = y_.array().tanh(); break;
+        case ACTIVATION_SIGMOID: y_ = (1.0f + (-y_.array()).exp()).inverse(); break;
+        case ACTIVATION_LINEAR:
+        case ACTIVATION_SOFTMAX: break;
+        }
+        x_.swap(y_);
+    }
+
+    // the analog network's output is always read as a softmax
+    float max = x_.maxCoeff();
+    Eigen::VectorXf e = (x_.array() - max).exp();
+    e /= e.sum();
+
+    softmax.resize(e.size());
+    double levels = model_.output_bits > 0 ? std::ldexp(1.0, model_.output_bits) - 1.0 : 0.0;
+    for (int i = 0; i < e.size(); i++)
+        softmax[i] = levels > 0.0 ? std::round(e[i] * levels) / levels : e[i];
+}
+
+int DigitalInference::submit(uint64_t tag, const std::vector<double> &coefficients, int timeout_ms,
+                             int exclude_board) {
+    (void)timeout_ms;
+    (void)exclude_board;
+    if (!loaded())
+        return -1;
+
+    auto start = std::chrono::steady_clock::now();
+    InferenceResult r;
+    r.tag = tag;
+    infer(coefficients, r.softmax);
+    r.ok = true;
+    r.latency_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    done_.push_back(std::move(r));
+    return 0;
+}
+
+int DigitalInference::poll(std::vector<InferenceResult> &out, int timeout_ms) {
+    (void)timeout_ms;
+    int n = done_.size();
+    for (InferenceResult &r : done_)
+        out.push_back(std::move(r));
+    done_.clear();
+    return n;
+}
+
+void DigitalInference::cancel(uint64_t tag) {
+    for (auto it = done_.begin(); it != done_.end(); ++it) {
+        if (it->tag == tag) {
+            done_.erase(it);
+            return;
+        }
+    }
+}
@@ -0,0 +1,190 @@
+#include "fake_stm.h"
+
+#include <iostream>
+#include <cmath>
+#include <deque>
+#include <algorithm>
+#include <chrono>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+using Clock = std::chrono::steady_clock;
+
+struct DelayedReply {
+    Clock::time_point due;
+    std::vector<uint8_t> bytes;
+};
+
+FakeStm::~FakeStm() {
+    stop();
+}
+
+bool FakeStm::start(int fd, const FakeStmConfig &config) {
+    fd_ = fd;
+    config_ = config;
+    stop_fd_ = eventfd(0, EFD_CLOEXEC);
+    if (stop_fd_ < 0)
+        return false;
+    thread_ = std::thread(&FakeStm::run, this);
+    return true;
+}
+
+void FakeStm::stop() {
+    if (!thread_.joinable())
+        return;
+    uint64_t one = 1;
+    if (write(stop_fd_, &one, sizeof(one)) < 0)
+        std::cerr << "FakeStm: failed to signal stop\n";
+    thread_.join();
+    close(stop_fd_);
+    stop_fd_ = -1;
+}
+
+// Deterministic stand-in for the analog network: softmax over the first ten coefficients
+static void fake_softmax(const std::vector<double> &coefficients, double *out) {
+    double sum = 0.0;
+    for (int i = 0; i < STM_SOFTMAX_SIZE; i++) {
+        double c = i < (int)coefficients.size() ? coefficients[i] : 0.0;
+        out[i] = std::exp(8.0 * c);
+        sum += out[i];
+    }
+    for (int i = 0; i < STM_SOFTMAX_SIZE; i++)
+        out[i] /= sum;
+}
+
+void FakeStm::handle(const StmFrame &frame, std::vector<uint8_t> &out) {
+    const std::vector<uint8_t> &p = frame.payload;
+
+    switch (frame.type) {
+    case STM_MSG_HELLO: {
+        if (config_.version < 2) {
+            uint8_t err = 1;
+            stm_encode_frame(frame.sequence, STM_MSG_ERROR, &err, 1, out);
+            break;
+        }
+        uint8_t ack[2] = { static_cast<uint8_t>(config_.version), config_.capabilities };
+        stm_encode_frame(frame.sequence, STM_MSG_HELLO_ACK, ack, sizeof(ack), out);
+        break;
+    }
+    case STM_MSG_ECHO:
+        stm_encode_frame(frame.sequence, STM_MSG_ECHO_REPLY, p.data(), p.size(), out);
+        break;
+    case STM_MSG_SET_BAUD:
+    case STM_MSG_BAUD_COMMIT: {
+        int baud = p.size() == 4 ? (p[0] | (p[1] << 8) | (p[2] << 16) | (p[3] << 24)) : 0;
+        if (!(config_.capabilities & STM_CAP_BAUD) || baud <= 0 || baud > config_.max_baud) {
+            uint8_t err = 2;
+            stm_encode_frame(frame.sequence, STM_MSG_ERROR, &err, 1, out);
+            break;
+        }
+        stm_encode_frame(frame.sequence, STM_RESPONSE(frame.type), p.data(), p.size(), out);
+        break;
+    }
+    case STM_MSG_INFER:
+    case STM_MSG_INFER_PACKED: {
+        std::vector<double> coefficients;
+        if (frame.type == STM_MSG_INFER) {
+            for (size_t i = 0; i + 4 <= p.size(); i += 4) {
+                int32_t v = p[i] | (p[i + 1] << 8) | (p[i + 2] << 16) | (p[i + 3] << 24);
+                coefficients.push_back(v / 10000.0);
+            }
+        } else {
+            int count = p.size() * 8 / 12;
+            std::vector<uint16_t> codes(count);
+            stm_unpack_codes(p.data(), count, codes.data());
+            for (uint16_t code : codes)
+                coefficients.push_back(dac_code_to_coefficient(code));
+        }
+
+        double softmax[STM_SOFTMAX_SIZE];
+        fake_softmax(coefficients, softmax);
+
+        uint8_t reply[STM_SOFTMAX_SIZE * 4];
+        if (frame.type == STM_MSG_INFER_PACKED) {
+            for (int i = 0; i < STM_SOFTMAX_SIZE; i++) {
+                uint16_t v = static_cast<uint16_t>(std::lround(softmax[i] * 65535.0));
+                reply[i * 2] = v & 0xFF;
+                reply[i * 2 + 1] = v >> 8;
+            }
+            stm_encode_frame(frame.sequence, STM_MSG_SOFTMAX_PACKED, reply, STM_SOFTMAX_SIZE * 2, out);
+        } else {
+            for (int i = 0; i < STM_SOFTMAX_SIZE; i++) {
+                int32_t v = static_cast<int32_t>(softmax[i] * 10000);
+                reply[i * 4] = v & 0xFF;
+                reply[i * 4 + 1] = (v >> 8) & 0xFF;
+                reply[i * 4 + 2] = (v >> 16) & 0xFF;
+                reply[i * 4 + 3] = (v >> 24) & 0xFF;
+            }
+            stm_encode_frame(frame.sequence, STM_MSG_SOFTMAX, reply, sizeof(reply), out);
+        }
+        break;
+    }
+    default: {
+        uint8_t err = 1;
+        stm_encode_frame(frame.sequence, STM_MSG_ERROR, &err, 1, out);
+        break;
+    }
+    }
+}
+
+void FakeStm::run() {
+    StmFrameParser parser;
+    std::vector<StmFrame> frames;
+    std::deque<DelayedReply> replies;
+    Clock::time_point busy_until = Clock::now();
+    uint8_t buf[512];
+
+    while (true) {
+        int timeout = -1;
+        if (!replies.empty()) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(replies.front().due - Clock::now());
+            timeout = std::max<int>(0, left.count());
+        }
+
+        struct pollfd pfds[2] = { { fd_, POLLIN, 0 }, { stop_fd_, POLLIN, 0 } };
+        if (poll(pfds, 2, timeout) < 0)
+            continue;
+        if (pfds[1].revents)
+            break;
+
+        if (pfds[0].revents & POLLIN) {
+            ssize_t n = read(fd_, buf, sizeof(buf));
+            if (n > 0) {
+                frames.clear();
+                parser.feed(buf, n, frames);
+                for (const StmFrame &f : frames) {
+                    requests_.fetch_add(1, std::memory_order_relaxed);
+                    DelayedReply r;
+                    r.due = Clock::now();
+                    if (f.type == STM_MSG_INFER || f.type == STM_MSG_INFER_PACKED) {
+                        // the analog board evaluates one input at a time
+                        busy_until = std::max(busy_until, r.due) + std::chrono::microseconds(config_.infer_delay_us);
+                        r.due = busy_until;
+                    }
+                    handle(f, r.bytes);
+                    auto pos = std::upper_bound(replies.begin(), replies.end(), r.due,
+                        [](Clock::time_point due, const DelayedReply &x) { return due < x.due; });
+                    replies.insert(pos, std::move(r));
+                }
+            }
+        }
+
+        while (!replies.empty() && replies.front().due <= Clock::now()) {
+            std::vector<uint8_t> &out = replies.front().bytes;
+            rng_ = rng_ * 1103515245u + 12345u;
+            if (config_.corrupt_probability > 0.0 && !out.empty() &&
+                (rng_ >> 8) % 1000000 < config_.corrupt_probability * 1000000) {
+                out[(rng_ >> 4) % out.size()] ^= 0x10;
+            }
+            size_t done = 0;
+            while (done < out.size()) {
+                ssize_t n = write(fd_, out.data() + done, out.size() - done);
+                if (n <= 0)
+                    break;
+                done += n;
+            }
+            replies.pop_front();
+        }
+    }
+}
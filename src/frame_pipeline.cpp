@@ -0,0 +1,117 @@
+#include "frame_pipeline.h"
+#include "realtime.h"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+
+FramePipeline::~FramePipeline() {
+    stop();
+}
+
+bool FramePipeline::start(const FramePipelineConfig &config) {
+    if (running_)
+        return true;
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        if (!stages_[s]) {
+            std::cerr << "Frame pipeline: no " << stage_name(s) << " stage\n";
+            return false;
+        }
+    }
+    if (!trigger_ || config.slots < 1) {
+        std::cerr << "Frame pipeline: no trigger or no slots\n";
+        return false;
+    }
+
+    slots_.clear();
+    for (int s = 0; s < STAGE_COUNT; s++)
+        in_[s].reset(new SpscRing<FrameSlot *>(config.slots));
+    for (int i = 0; i < config.slots; i++) {
+        slots_.emplace_back(new FrameSlot());
+        // filled rather than reserved, so the first capture into it does not fault
+        slots_.back()->image.resize(config.frame_bytes);
+        in_[STAGE_CAPTURE]->push(slots_.back().get());
+    }
+
+    running_ = true;
+    int cpus = std::thread::hardware_concurrency();
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        int cpu = config.cpus[s] < cpus ? config.cpus[s] : -1;
+        threads_.emplace_back(&FramePipeline::run, this, s, cpu);
+    }
+    return true;
+}
+
+void FramePipeline::stop() {
+    if (!running_)
+        return;
+    running_ = false;
+    if (interrupt_)
+        interrupt_();
+    for (int s = 0; s < STAGE_COUNT; s++)
+        in_[s]->close();
+    for (std::thread &t : threads_)
+        t.join();
+    threads_.clear();
+}
+
+void FramePipeline::run_stage(int stage, FrameSlot &slot) {
+    auto begin = std::chrono::steady_clock::now();
+    if (!stages_[stage](slot))
+        slot.failed = true;
+    busy_ns_[stage].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - begin).count(), std::memory_order_relaxed);
+    frames_[stage].fetch_add(1, std::memory_order_relaxed);
+}
+
+void FramePipeline::run(int stage, int cpu) {
+    static const char *names[STAGE_COUNT] = { "ann-capture", "ann-preprocess", "ann-link", "ann-publish" };
+    pthread_setname_np(pthread_self(), names[stage]);
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            std::cerr << "Frame pipeline: could not pin " << stage_name(stage) << " to CPU " << cpu << "\n";
+    }
+    realtime_prefault_stack();
+
+    SpscRing<FrameSlot *> &in = *in_[stage];
+    SpscRing<FrameSlot *> &out = *in_[(stage + 1) % STAGE_COUNT];
+    while (running_) {
+        FrameSlot *slot;
+        if (!in.pop_wait(slot, -1))
+            continue;
+
+        if (stage == STAGE_CAPTURE) {
+            // a free slot in hand; now wait for the button
+            int wait_ms = interrupt_ ? -1 : PIPELINE_WAIT_MS;
+            while (running_ && !trigger_(wait_ms, slot->trigger_ns)) {}
+            if (!running_) break;
+            slot->failed = false;
+            slot->softmax.clear();
+        }
+
+        if (!slot->failed || stage == STAGE_PUBLISH)
+            run_stage(stage, *slot);
+
+        // every ring can hold all slots, so this never finds one full
+        out.push(slot);
+    }
+}
+
+void FramePipeline::report(std::ostream &os) const {
+    double slowest_ms = 0.0;
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        uint64_t n = frames_[s].load(std::memory_order_relaxed);
+        double mean_ms = n ? busy_ns_[s].load(std::memory_order_relaxed) / 1e6 / n : 0.0;
+        // capture includes waiting for the camera, not for the button
+        slowest_ms = std::max(slowest_ms, mean_ms);
+        os << stage_name(s) << " " << n << " frames, " << std::fixed << std::setprecision(2) << mean_ms << " ms; ";
+    }
+    if (slowest_ms > 0.0)
+        os << "max " << std::setprecision(1) << 1000.0 / slowest_ms << " frames/s";
+    os << "\n";
+}
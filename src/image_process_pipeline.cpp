@@ -1,18 +1,33 @@
 #include "image_process_pipeline.h"
+#include "preprocess_graph.h"
 #include "utilities.h"
 #include "stb/stb_image_write.h"
 #include "math.h"
 
-std::vector<std::vector<double>> __pca_components;
-std::vector<double> __mean_vector;
+void image_processing_init(const std::string &preprocess_path){
+    ModelRegistry &registry = model_registry();
+    // editing the stage list replans it, like new PCA files
+    registry.add(PREPROCESS_MODEL, { preprocess_path }, [preprocess_path] {
+        return load_preprocess_plan(preprocess_path);
+    });
+    if (!registry.load(PREPROCESS_MODEL)) {
+        exit(1);
+    }
 
-void image_processing_init(){
-    __pca_components = loadMatrixCSV("./data/pca_components.csv", COMPONENTS, FEATURES);
-    __mean_vector = loadVectorCSV("./data/mean.csv", FEATURES);
+    registry.add(IMAGE_PCA_MODEL, { IMAGE_PCA_COMPONENTS_PATH, IMAGE_PCA_MEAN_PATH }, [] {
+        return load_pca_model(IMAGE_PCA_COMPONENTS_PATH, IMAGE_PCA_MEAN_PATH, COMPONENTS, FEATURES);
+    });
+    if (!registry.load(IMAGE_PCA_MODEL)) {
+        exit(1);
+    }
 
-    std::cerr << "Loaded PCA Components: " << __pca_components.size() << " x " 
-              << (__pca_components.empty() ? 0 : __pca_components[0].size()) << std::endl;
-    std::cerr << "Loaded Mean Vector Size: " << __mean_vector.size() << std::endl;
+    std::shared_ptr<const PcaModel> model = image_pca_model();
+    std::cerr << "Loaded PCA Components: " << model->components << " x " << model->features << std::endl;
+    std::cerr << "Loaded Mean Vector Size: " << model->mean.size() << std::endl;
+}
+
+std::shared_ptr<const PcaModel> image_pca_model() {
+    return model_registry().get_as<PcaModel>(IMAGE_PCA_MODEL);
 }
 
 inline int clamp(int val, int min_val, int max_val) {
@@ -130,10 +145,18 @@ void add_circular_brightness(const std::vector<uint8_t>& image,
 }
 
 void crop_to_square(const std::vector<uint8_t>& image, int width, int height,
-                    std::vector<uint8_t>& cropped, int& new_size, uint8_t threshold) {
+                    std::vector<uint8_t>& cropped, int& new_size, uint8_t threshold,
+                    BoundingBox *bbox) {
     int min_x, max_x, min_y, max_y;
     find_bounding_box(image, width, height, min_x, max_x, min_y, max_y, threshold);
 
+    if (bbox) {
+        bbox->min_x = min_x;
+        bbox->max_x = max_x;
+        bbox->min_y = min_y;
+        bbox->max_y = max_y;
+    }
+
     int digit_width = max_x - min_x + 1;
     int digit_height = max_y - min_y + 1;
     new_size = (digit_width > digit_height) ? digit_width : digit_height; // square cropping logic
@@ -191,7 +214,7 @@ float bicubic_sample(const std::vector<uint8_t>& img, int width, int height, flo
 }
 
 void find_digit_cubic(const std::vector<uint8_t>& image, int width, int height,
-                                  std::vector<uint8_t>& out, int target_width = 24, int target_height = 24) {
+                                  std::vector<uint8_t>& out, int target_width, int target_height) {
     // Find bounding box
     int top = height, bottom = -1, left = width, right = -1;
 
@@ -236,42 +259,53 @@ void find_digit_cubic(const std::vector<uint8_t>& image, int width, int height,
     }
 }
 
-void pcaProject(const std::vector<uint8_t>& image, 
+bool pcaProject(const std::vector<uint8_t>& image, 
                 std::vector<double>& out) {
     
-    int num_components = __pca_components.size();  
-    int num_features = __pca_components[0].size(); 
+    // one version of the basis for the whole projection, even if a new one is loaded meanwhile
+    std::shared_ptr<const PcaModel> model = image_pca_model();
+    int num_components = model->components;
+    int num_features = model->features;
 
     out.assign(num_components, 0.0);
 
-    if (image.size() != num_features || __mean_vector.size() != num_features) {
+    if (image.size() != (size_t)num_features) {
         std::cerr << "Error: Image, mean vector, and PCA components size mismatch!\n";
-        exit(1);
+        out.clear();
+        return false;
     }
 
     std::vector<double> centered_image(num_features, 0.0);
     
     for (int i = 0; i < num_features; i++) {
-        centered_image[i] = image[i]/255.0 - __mean_vector[i];
+        centered_image[i] = image[i]/255.0 - model->mean[i];
     }
 
-    double max = 0;
-
     //std::cerr << "After projection: \n";
     
     for (int i = 0; i < num_components; i++) { 
+        const double *row = model->row(i);
         for (int j = 0; j < num_features; j++) { 
-            out[i] += __pca_components[i][j] * centered_image[j];
+            out[i] += row[j] * centered_image[j];
             
         }
-        
-        if (fabs(out[i]) > max){
-            max = fabs(out[i]);
-        }
         //std::cerr << out[i] << std::endl;
     }
     
     //std::cerr << "=======================================\n";
+    quantizeCoefficients(out);
+    return true;
+}
+
+// Scale the largest coefficient to 0.625 and round to DAC steps
+void quantizeCoefficients(std::vector<double>& out) {
+    int num_components = out.size();
+    double max = 0;
+    for (int i = 0; i < num_components; i++){
+        if (fabs(out[i]) > max){
+            max = fabs(out[i]);
+        }
+    }
     if (max == 0){
         return;
     }
@@ -284,8 +318,8 @@ void pcaProject(const std::vector<uint8_t>& image,
     }
     //std::cerr << "=======================================\n";
     
-    int levels = 4096;
-    double scale = (2.0*2.75) / ((double) levels);
+    int levels = DAC_LEVELS;
+    double scale = (2.0*DAC_FULL_SCALE) / ((double) levels);
     
     //std::cerr << "After quantization: \n";
     
@@ -296,6 +330,47 @@ void pcaProject(const std::vector<uint8_t>& image,
     //std::cerr << "=======================================\n";
 }
 
+// Project several images at once: each component row is streamed from memory
+// once for the whole batch instead of once per image.
+bool pcaProjectBatch(const std::vector<const std::vector<uint8_t>*>& images,
+                     std::vector<std::vector<double>>& out) {
+
+    // the whole batch is projected with the same version
+    std::shared_ptr<const PcaModel> model = image_pca_model();
+    int num_components = model->components;
+    int num_features = model->features;
+    int batch = images.size();
+
+    std::vector<double> centered(batch * num_features);
+    for (int b = 0; b < batch; b++) {
+        if (images[b]->size() != (size_t)num_features) {
+            std::cerr << "Error: Image, mean vector, and PCA components size mismatch!\n";
+            return false;
+        }
+        for (int j = 0; j < num_features; j++) {
+            centered[b * num_features + j] = (*images[b])[j]/255.0 - model->mean[j];
+        }
+    }
+
+    out.resize(batch);
+    for (int b = 0; b < batch; b++) out[b].assign(num_components, 0.0);
+
+    for (int i = 0; i < num_components; i++) {
+        const double *row = model->row(i);
+        for (int b = 0; b < batch; b++) {
+            const double *x = &centered[b * num_features];
+            double sum = 0;
+            for (int j = 0; j < num_features; j++) {
+                sum += row[j] * x[j];
+            }
+            out[b][i] = sum;
+        }
+    }
+
+    for (int b = 0; b < batch; b++) quantizeCoefficients(out[b]);
+    return true;
+}
+
 void downsampleInterArea(const std::vector<uint8_t>& image, 
                          int oldWidth, 
                          int oldHeight, 
@@ -481,101 +556,33 @@ void gaussian_blur(const std::vector<uint8_t>& image,
 
 }
 
-void process_image(const std::vector<uint8_t>& image, 
+bool prepare_image(const std::vector<uint8_t>& image, 
                    int width,
                    int height, 
-                   std::vector<double>& out){
-    
-    //BEHOLD! The image processing pipeline!
-
-    //Step 1: Crop the image (white border)/smart crop (digit bounds)
-    std::vector<uint8_t> cropped_centered;
-    int new_size;
-    //crop_to_square(image, width, height, cropped_centered, new_size, BLACK_THRESHOLD);
-    
-    rotate_image(image, cropped_centered);
-    
-    int quality = 100;  // JPG quality
-    bool success = stbi_write_jpg("data/step_1.jpg", width, height, 1, cropped_centered.data(), quality);    
-
-
-    std::vector<uint8_t> center_crop;
-    
-    //crop(cropped_centered, width, height, 1000, 1000, center_crop);
-    add_circular_brightness(cropped_centered, width, height, center_crop, 2.5, 3.5);
-    //success = stbi_write_jpg("data/step_1.5.jpg", width, height, 1, center_crop.data(), quality);    
-    
-
-    //Step 2: Contrast boost
-    std::vector<uint8_t> thresholded_image;
-    threshold(center_crop, BLACK_THRESHOLD, thresholded_image);
-    
-    //width = 1000; height = 1000;
-
-    //quality = 100; 
-    //success = stbi_write_jpg("data/step_2.jpg", width, height, 1, thresholded_image.data(), quality);    
-    
-    std::vector<uint8_t> digit_bound;
-    crop_to_square(thresholded_image, width, height, digit_bound, new_size, BLACK_THRESHOLD);
-    
-    //success = stbi_write_jpg("data/step_2.5.jpg", new_size, new_size, 1, digit_bound.data(), quality);  
-
-    //Step 3: Downsample the image
-    std::vector<uint8_t> downsampled_image;
-    downsampleInterArea(digit_bound, new_size, new_size, DOWNSAMPLE_SIZE, DOWNSAMPLE_SIZE, downsampled_image);
-    
-    //quality = 100; 
-    //success = stbi_write_jpg("data/step_3.jpg", DOWNSAMPLE_SIZE, DOWNSAMPLE_SIZE, 1, downsampled_image.data(), quality);    
-
-    //Step 4: Contrast boost again
-    //threshold(downsampled_image, WHITE_THRESHOLD, thresholded_image);
-    
-    //quality = 100; 
-
-    //success = stbi_write_jpg("data/step_4.jpg", DOWNSAMPLE_SIZE, DOWNSAMPLE_SIZE, 1, thresholded_image.data(), quality);    
-    
-    //Step 5: Apply a gaussian blur
-    //std::vector<uint8_t> blurred_image;
-    //gaussian_blur(thresholded_image, DOWNSAMPLE_SIZE, DOWNSAMPLE_SIZE, blurred_image);
-    
-    //quality = 100;  // JPG quality
-    //success = stbi_write_jpg("data/step_5.jpg", DOWNSAMPLE_SIZE, DOWNSAMPLE_SIZE, 1, blurred_image.data(), quality);    
-
-    //Step 6: Darken the gaussian blur
-    //darken_image(blurred_image, WHITE_THRESHOLD);
-    
-    //quality = 100;  // JPG quality
-    //success = stbi_write_jpg("data/step_6.jpg", DOWNSAMPLE_SIZE, DOWNSAMPLE_SIZE, 1, blurred_image.data(), quality);    
+                   std::vector<uint8_t>& output_for_pca,
+                   BoundingBox *bbox,
+                   const Deadline &deadline,
+                   PipelineImages *images){
+
+    //BEHOLD! The image processing pipeline! (data/preprocess.csv)
+    // one version of the stages for the whole frame; buffers are kept per thread
+    static thread_local PreprocessWorkspace workspace;
+    std::shared_ptr<const PreprocessPlan> plan = model_registry().get_as<PreprocessPlan>(PREPROCESS_MODEL);
+    return workspace.run(plan, image, width, height, output_for_pca, bbox, deadline, images);
+}
 
-    //Step 7: Invert 
-    std::vector<uint8_t> inverted;
-    invert(downsampled_image, inverted);
-    
-    quality = 100;  // JPG quality
-    //success = stbi_write_jpg("data/step_7.jpg", 24, 24, 1, inverted.data(), quality);   
-    
-    std::vector<uint8_t> output(28*28, 0);
-    
-    for (int y = 0; y < 24; y++){
-        for (int x = 0; x < 24; x++){
-            output[(y+2)*28+(x+2)] = inverted[y*24 + x];
-        }
-    }
-    
-    std::vector<uint8_t> blurred_image;
-    gaussian_blur(output, 28, 28, blurred_image);
-    
-    lighten_image(blurred_image, 2, 3.5f);
-    
-    //success = stbi_write_jpg("data/step_7.jpg", 28, 28, 1, blurred_image.data(), quality);   
-    
-    
-    std::vector<uint8_t> output_for_pca(24*24, 0);
-    find_digit_cubic(blurred_image, 28, 28, output_for_pca, 24, 24);
+bool process_image(const std::vector<uint8_t>& image, 
+                   int width,
+                   int height, 
+                   std::vector<double>& out,
+                   BoundingBox *bbox,
+                   const Deadline &deadline,
+                   PipelineImages *images){
+    out.clear();
+    std::vector<uint8_t> output_for_pca;
+    if (!prepare_image(image, width, height, output_for_pca, bbox, deadline, images)) return false;
 
-    success = stbi_write_jpg("data/step_8.jpg", 24, 24, 1, output_for_pca.data(), quality);   
     //Step 8: Project to PCA space
-    pcaProject(output_for_pca, out);
-    
+    return pcaProject(output_for_pca, out);
 }
 
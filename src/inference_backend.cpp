@@ -0,0 +1,60 @@
+#include "inference_backend.h"
+
+#include <algorithm>
+
+OverflowBackend::OverflowBackend(InferenceBackend &primary, InferenceBackend &secondary)
+    : primary_(primary), secondary_(secondary) {
+}
+
+int OverflowBackend::submit(uint64_t tag, const std::vector<double> &coefficients, int timeout_ms,
+                            int exclude_board) {
+    if (primary_.has_capacity() && primary_.submit(tag, coefficients, timeout_ms, exclude_board) >= 0) {
+        // keep the input so a failed board can be covered by the secondary
+        primary_inputs_.emplace_back(tag, coefficients);
+        return 0;
+    }
+    overflowed_++;
+    return secondary_.submit(tag, coefficients, timeout_ms);
+}
+
+int OverflowBackend::poll(std::vector<InferenceResult> &out, int timeout_ms) {
+    size_t before = out.size();
+
+    // anything the host backend already finished is returned without waiting on the boards
+    secondary_.poll(out, 0);
+    if (primary_.in_flight() > 0)
+        primary_.poll(scratch_, out.size() > before ? 0 : timeout_ms);
+
+    for (InferenceResult &r : scratch_) {
+        auto it = std::find_if(primary_inputs_.begin(), primary_inputs_.end(),
+                               [&](const std::pair<uint64_t, std::vector<double>> &p) { return p.first == r.tag; });
+        if (it == primary_inputs_.end())
+            continue;
+
+        if (!r.ok && secondary_.submit(r.tag, it->second, 0) >= 0) {
+            overflowed_++;
+            secondary_.poll(out, 0);
+        } else {
+            out.push_back(std::move(r));
+        }
+        primary_inputs_.erase(it);
+    }
+    scratch_.clear();
+    return out.size() - before;
+}
+
+void OverflowBackend::cancel(uint64_t tag) {
+    primary_.cancel(tag);
+    secondary_.cancel(tag);
+    primary_inputs_.erase(std::remove_if(primary_inputs_.begin(), primary_inputs_.end(),
+                                         [&](const std::pair<uint64_t, std::vector<double>> &p) { return p.first == tag; }),
+                          primary_inputs_.end());
+}
+
+bool OverflowBackend::has_capacity() const {
+    return primary_.has_capacity() || secondary_.has_capacity();
+}
+
+int OverflowBackend::in_flight() const {
+    return primary_.in_flight() + secondary_.in_flight();
+}
@@ -0,0 +1,652 @@
+#include "inference_service.h"
+#include "image_process_pipeline.h"
+#include "stb/stb_image.h"
+
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+
+using Clock = std::chrono::steady_clock;
+
+// Per-attempt bound on handing a request to the backend
+#define INFERENCE_SUBMIT_TIMEOUT_MS 500
+// Longest the dispatcher waits on the backend between deadline checks
+#define INFERENCE_MAX_WAIT_MS 50
+#define INFERENCE_MAX_DIMENSION 8192
+#define INFERENCE_READ_CHUNK 65536
+
+struct InferenceService::Job {
+    uint64_t connection = 0;        // 0 for in-process callers
+    uint32_t id = 0;
+    int input = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> payload;
+    std::vector<uint8_t> pixels;    // 24x24 PCA input
+    std::vector<double> coefficients;
+    bool projected = false;
+    bool admitted = false;
+    size_t charged = 0;             // payload bytes counted against INFERENCE_MAX_QUEUED_BYTES
+    Deadline deadline;
+    Clock::time_point received;
+    int attempts = 0;
+    int failed_board = -1;          // a retry goes to any other board
+    uint32_t batch_size = 0;
+    int status = -1;
+    InferenceResult result;
+    TelemetryRecord telemetry = {};
+
+    // in-process callers wait on this
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool done = false;
+};
+
+struct InferenceService::Client {
+    int fd = -1;
+    uint64_t connection = 0;
+    std::vector<uint8_t> in;
+    std::vector<uint8_t> out;
+    size_t out_sent = 0;
+    uint32_t events = EPOLLIN;
+    int unanswered = 0;             // requests read whose reply is not in out yet
+    bool eof = false;               // the peer is done sending; closed once everything is answered
+};
+
+InferenceService::InferenceService(InferenceBackend &backend, StageCounters &counters)
+    : backend_(backend), counters_(counters) {}
+
+InferenceService::~InferenceService() {
+    stop();
+}
+
+bool InferenceService::start(const std::string &socket_path, int workers, Reactor *reactor) {
+    stop();
+    socket_path_ = socket_path;
+    stats_ = InferenceServiceStats();
+
+    if (!socket_path.empty()) {
+        struct sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(addr.sun_path)) {
+            std::cerr << "Inference service: socket path too long\n";
+            return false;
+        }
+        std::strcpy(addr.sun_path, socket_path.c_str());
+
+        listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        unlink(socket_path.c_str());
+        if (listen_fd_ < 0 ||
+            bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 ||
+            listen(listen_fd_, 16) < 0) {
+            std::cerr << "Inference service: cannot listen on " << socket_path << ": " << strerror(errno) << "\n";
+            stop();
+            return false;
+        }
+        // test rigs and the labeller run as ordinary users
+        chmod(socket_path.c_str(), 0666);
+
+        if (!reactor) {
+            own_reactor_.reset(new Reactor());
+            if (!own_reactor_->start("ann-service")) {
+                stop();
+                return false;
+            }
+            reactor = own_reactor_.get();
+        }
+        reactor_ = reactor;
+    }
+
+    running_ = true;
+    dispatch_thread_ = std::thread(&InferenceService::dispatch_loop, this);
+    for (int i = 0; i < workers; i++)
+        workers_.emplace_back(&InferenceService::worker_loop, this);
+    if (listen_fd_ >= 0) {
+        {
+            std::lock_guard<std::mutex> lock(reply_mutex_);
+            io_open_ = true;
+        }
+        reactor_->add(listen_fd_, EPOLLIN, [this](uint32_t) { accept_clients(); });
+        std::cerr << "Inference service listening on " << socket_path << "\n";
+    }
+    return true;
+}
+
+void InferenceService::stop() {
+    running_ = false;
+    // taking the locks orders the flag before any waiter's predicate check
+    { std::lock_guard<std::mutex> lock(work_mutex_); }
+    { std::lock_guard<std::mutex> lock(ready_mutex_); }
+    work_cv_.notify_all();
+    ready_cv_.notify_all();
+    backend_.interrupt();
+    for (std::thread &worker : workers_)
+        worker.join();
+    workers_.clear();
+    if (dispatch_thread_.joinable()) dispatch_thread_.join();
+
+    if (reactor_) {
+        {
+            std::lock_guard<std::mutex> lock(reply_mutex_);
+            io_open_ = false;
+        }
+        // runs after any send_replies() already posted
+        reactor_->call([this] {
+            if (listen_fd_ >= 0) reactor_->remove(listen_fd_);
+            while (!clients_.empty())
+                close_client(clients_.begin()->first);
+        });
+    }
+    if (own_reactor_) {
+        own_reactor_->stop();
+        own_reactor_.reset();
+    }
+    reactor_ = nullptr;
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        unlink(socket_path_.c_str());
+    }
+    listen_fd_ = -1;
+
+    // nothing is left to run what is still queued
+    for (auto &job : work_) complete(job, INFER_FAILED);
+    for (auto &job : ready_) complete(job, INFER_FAILED);
+    work_.clear();
+    ready_.clear();
+    replies_.clear();
+}
+
+bool InferenceService::infer(const std::vector<double> &coefficients, const Deadline &deadline, InferenceResult &result,
+                             TelemetryRecord *telemetry) {
+    auto job = std::make_shared<Job>();
+    job->coefficients = coefficients;
+    job->projected = true;
+    job->deadline = deadline;
+    job->received = Clock::now();
+    admit(job);
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->cv.wait(lock, [&] { return job->done; });
+    result = job->result;
+    if (telemetry) {
+        const TelemetryRecord &t = job->telemetry;
+        telemetry->stamp_ns[STAMP_SUBMITTED] = t.stamp_ns[STAMP_SUBMITTED];
+        telemetry->stamp_ns[STAMP_ANSWERED] = t.stamp_ns[STAMP_ANSWERED];
+        telemetry->status = t.status;
+        telemetry->board = t.board;
+        telemetry->attempts = t.attempts;
+        telemetry->batch_size = t.batch_size;
+        telemetry->timeout_stage = t.timeout_stage;
+        telemetry->link_latency_us = t.link_latency_us;
+        telemetry->crc_errors = t.crc_errors;
+    }
+    return job->status == INFER_OK;
+}
+
+InferenceServiceStats InferenceService::stats() const {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_;
+}
+
+void InferenceService::admit(std::shared_ptr<Job> job) {
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        stats_.requests++;
+    }
+    if (!running_ || queued_.load() >= INFERENCE_MAX_QUEUED ||
+        queued_bytes_.load() + job->payload.size() > INFERENCE_MAX_QUEUED_BYTES) {
+        complete(job, running_ ? INFER_BUSY : INFER_FAILED);
+        return;
+    }
+    job->admitted = true;
+    job->charged = job->payload.size();
+    queued_++;
+    queued_bytes_ += job->charged;
+
+    if (job->projected || job->input == INPUT_PIXELS) {
+        if (job->input == INPUT_PIXELS) {
+            job->pixels.swap(job->payload);
+            job->telemetry.stamp_ns[STAMP_PREPROCESSED] = telemetry_now_ns();
+        }
+        {
+            std::lock_guard<std::mutex> lock(ready_mutex_);
+            ready_.push_back(std::move(job));
+            ready_cv_.notify_one();
+        }
+        // the dispatcher may be waiting on the boards rather than the queue
+        backend_.interrupt();
+    } else {
+        std::lock_guard<std::mutex> lock(work_mutex_);
+        work_.push_back(std::move(job));
+        work_cv_.notify_one();
+    }
+}
+
+void InferenceService::complete(const std::shared_ptr<Job> &job, int status, int stage) {
+    job->status = status;
+    if (job->admitted) {
+        queued_--;
+        queued_bytes_ -= job->charged;
+    }
+    if (stage >= 0) counters_.timeout(stage);
+
+    TelemetryRecord &t = job->telemetry;
+    t.stamp_ns[STAMP_ANSWERED] = telemetry_now_ns();
+    t.status = status;
+    t.board = job->result.board;
+    t.attempts = job->attempts;
+    t.batch_size = std::min<uint32_t>(job->batch_size, 255);
+    t.timeout_stage = stage;
+    t.link_latency_us = job->result.latency_us;
+    t.crc_errors = job->result.crc_errors;
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex_);
+        if (status == INFER_OK) stats_.completed++;
+        else if (status == INFER_BUSY) stats_.rejected++;
+        else stats_.failed++;
+    }
+
+    if (job->connection == 0) {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->done = true;
+        job->cv.notify_all();
+        return;
+    }
+
+    InferenceReply reply = {};
+    reply.magic = INFERENCE_REPLY_MAGIC;
+    reply.id = job->id;
+    reply.status = status;
+    reply.board = job->result.board;
+    reply.latency_us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - job->received).count();
+    reply.batch_size = job->batch_size;
+    for (int i = 0; i < INFERENCE_COEFFICIENTS && i < (int)job->coefficients.size(); i++)
+        reply.coefficients[i] = job->coefficients[i];
+    for (int i = 0; i < SOFTMAX_SIZE && i < (int)job->result.softmax.size(); i++)
+        reply.softmax[i] = job->result.softmax[i];
+    {
+        std::lock_guard<std::mutex> lock(reply_mutex_);
+        replies_.push_back({ job->connection, reply });
+    }
+    wake_io();
+
+    if (telemetry_) {
+        t.source = TELEMETRY_SOCKET;
+        t.stamp_ns[STAMP_PUBLISHED] = telemetry_now_ns();
+        telemetry_set_result(t, job->coefficients, job->result.softmax);
+        telemetry_->append(t);
+    }
+}
+
+void InferenceService::wake_io() {
+    std::lock_guard<std::mutex> lock(reply_mutex_);
+    if (!io_open_ || reply_posted_) return;
+    reply_posted_ = true;
+    reactor_->post([this] { send_replies(); });
+}
+
+void InferenceService::worker_loop() {
+    pthread_setname_np(pthread_self(), "ann-worker");
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(work_mutex_);
+            work_cv_.wait(lock, [this] { return !work_.empty() || !running_; });
+            if (!running_) return;
+            job = std::move(work_.front());
+            work_.pop_front();
+        }
+
+        if (job->deadline.expired()) {
+            complete(job, INFER_TIMEOUT, STAGE_PREPROCESS);
+            continue;
+        }
+
+        std::vector<uint8_t> image;
+        int width = job->width;
+        int height = job->height;
+        if (job->input == INPUT_ENCODED) {
+            // a small file can declare a huge image: check the header before decoding
+            int channels;
+            if (!stbi_info_from_memory(job->payload.data(), job->payload.size(), &width, &height, &channels)) {
+                complete(job, INFER_DECODE_FAILED);
+                continue;
+            }
+            if (width > INFERENCE_MAX_DIMENSION || height > INFERENCE_MAX_DIMENSION) {
+                complete(job, INFER_BAD_REQUEST);
+                continue;
+            }
+            uint8_t *decoded = stbi_load_from_memory(job->payload.data(), job->payload.size(),
+                                                     &width, &height, &channels, 1);
+            if (!decoded) {
+                complete(job, INFER_DECODE_FAILED);
+                continue;
+            }
+            image.assign(decoded, decoded + width * height);
+            stbi_image_free(decoded);
+        } else {
+            image.swap(job->payload);
+        }
+        std::vector<uint8_t>().swap(job->payload);
+
+        if (!prepare_image(image, width, height, job->pixels, nullptr, job->deadline)) {
+            // an image the stages cannot reduce to the PCA input is the caller's
+            if (job->deadline.expired()) complete(job, INFER_TIMEOUT, STAGE_PREPROCESS);
+            else complete(job, INFER_BAD_REQUEST);
+            continue;
+        }
+        job->telemetry.stamp_ns[STAMP_PREPROCESSED] = telemetry_now_ns();
+
+        {
+            std::lock_guard<std::mutex> lock(ready_mutex_);
+            ready_.push_back(std::move(job));
+            ready_cv_.notify_one();
+        }
+        backend_.interrupt();
+    }
+}
+
+void InferenceService::dispatch_loop() {
+    pthread_setname_np(pthread_self(), "ann-dispatch");
+    std::vector<std::shared_ptr<Job>> batch;
+    std::deque<std::shared_ptr<Job>> backlog;
+    std::map<uint64_t, std::shared_ptr<Job>> in_flight;
+    std::vector<const std::vector<uint8_t> *> inputs;
+    std::vector<Job *> targets;
+    std::vector<std::vector<double>> projected;
+    std::vector<InferenceResult> results;
+    uint64_t next_tag = 1;
+
+    while (running_) {
+        {
+            std::unique_lock<std::mutex> lock(ready_mutex_);
+            if (backlog.empty() && in_flight.empty())
+                ready_cv_.wait(lock, [this] { return !ready_.empty() || !running_; });
+            while (!ready_.empty() && batch.size() < INFERENCE_MAX_BATCH) {
+                batch.push_back(std::move(ready_.front()));
+                ready_.pop_front();
+            }
+        }
+
+        if (!batch.empty()) {
+            // one pass over the PCA matrix for every image in the batch
+            inputs.clear();
+            targets.clear();
+            for (auto &job : batch) {
+                if (job->projected) continue;
+                inputs.push_back(&job->pixels);
+                targets.push_back(job.get());
+            }
+            if (!inputs.empty() && pcaProjectBatch(inputs, projected)) {
+                for (size_t i = 0; i < targets.size(); i++) {
+                    targets[i]->coefficients.swap(projected[i]);
+                    targets[i]->projected = true;
+                }
+            }
+            for (auto &job : batch) {
+                job->batch_size = batch.size();
+                // the basis changed shape since the image was prepared
+                if (!job->projected) complete(job, INFER_FAILED);
+                else if (job->deadline.expired()) complete(job, INFER_TIMEOUT, STAGE_PREPROCESS);
+                else backlog.push_back(std::move(job));
+            }
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex_);
+                stats_.batches++;
+                stats_.batched += batch.size();
+                stats_.max_batch = std::max<uint64_t>(stats_.max_batch, batch.size());
+            }
+            batch.clear();
+        }
+
+        // hand the backend as much of the backlog as it will take
+        while (!backlog.empty() && backend_.has_capacity()) {
+            std::shared_ptr<Job> job = std::move(backlog.front());
+            backlog.pop_front();
+            if (job->deadline.expired()) {
+                complete(job, INFER_TIMEOUT, STAGE_LINK);
+                continue;
+            }
+            uint64_t tag = next_tag++;
+            job->attempts++;
+            job->telemetry.stamp_ns[STAMP_SUBMITTED] = telemetry_now_ns();
+            if (backend_.submit(tag, job->coefficients, job->deadline.remaining_ms(INFERENCE_SUBMIT_TIMEOUT_MS),
+                                job->failed_board) < 0) {
+                complete(job, INFER_FAILED);
+                continue;
+            }
+            in_flight[tag] = std::move(job);
+        }
+        for (auto it = backlog.begin(); it != backlog.end();) {
+            if ((*it)->deadline.expired()) {
+                complete(*it, INFER_TIMEOUT, STAGE_LINK);
+                it = backlog.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        if (in_flight.empty() && backlog.empty())
+            continue;
+
+        // Wait for replies (or room for the backlog) until the next deadline;
+        // new work interrupts the wait
+        int wait_ms = INFERENCE_MAX_WAIT_MS;
+        for (auto &entry : in_flight) wait_ms = entry.second->deadline.remaining_ms(wait_ms);
+        for (auto &job : backlog) wait_ms = job->deadline.remaining_ms(wait_ms);
+        {
+            std::lock_guard<std::mutex> lock(ready_mutex_);
+            if (!ready_.empty()) wait_ms = 0;
+        }
+
+        results.clear();
+        backend_.poll(results, wait_ms);
+        for (InferenceResult &r : results) {
+            auto it = in_flight.find(r.tag);
+            if (it == in_flight.end()) continue;
+            std::shared_ptr<Job> job = std::move(it->second);
+            in_flight.erase(it);
+
+            if (r.ok) {
+                job->result = std::move(r);
+                complete(job, INFER_OK);
+            } else if (job->attempts < INFERENCE_ATTEMPTS && !job->deadline.expired()) {
+                // retry on another board; the failed one only leaves the pool after repeated failures
+                job->failed_board = r.board;
+                backlog.push_front(std::move(job));
+            } else if (job->deadline.expired()) {
+                complete(job, INFER_TIMEOUT, STAGE_LINK);
+            } else {
+                complete(job, INFER_FAILED);
+            }
+        }
+        for (auto it = in_flight.begin(); it != in_flight.end();) {
+            if (it->second->deadline.expired()) {
+                // a late reply for this tag is discarded by the backend
+                backend_.cancel(it->first);
+                complete(it->second, INFER_TIMEOUT, STAGE_LINK);
+                it = in_flight.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    for (auto &entry : in_flight) {
+        backend_.cancel(entry.first);
+        complete(entry.second, INFER_FAILED);
+    }
+    for (auto &job : backlog) complete(job, INFER_FAILED);
+}
+
+void InferenceService::on_client(int fd, uint32_t events) {
+    auto it = clients_.find(fd);
+    if (it == clients_.end()) return;
+    Client &client = *it->second;
+    bool ok = !(events & EPOLLERR);
+    if (ok && (events & (EPOLLIN | EPOLLHUP))) ok = read_client(client);
+    if (ok && (events & EPOLLOUT || client.eof)) ok = write_client(client);
+    // EPOLLHUP: both directions are shut, nobody is left to read the replies
+    if (!ok || (events & EPOLLHUP) || (client.eof && client.unanswered == 0 && client.out.empty()))
+        close_client(fd);
+}
+
+void InferenceService::send_replies() {
+    std::vector<std::pair<uint64_t, InferenceReply>> replies;
+    {
+        std::lock_guard<std::mutex> lock(reply_mutex_);
+        replies.swap(replies_);
+        reply_posted_ = false;
+    }
+
+    for (auto &entry : replies) {
+        for (auto &c : clients_) {
+            Client &client = *c.second;
+            if (client.connection != entry.first) continue;
+            const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&entry.second);
+            client.out.insert(client.out.end(), bytes, bytes + sizeof(InferenceReply));
+            client.unanswered--;
+            break;
+        }
+    }
+    std::vector<int> done;
+    for (auto &c : clients_) {
+        Client &client = *c.second;
+        if (client.out.size() > client.out_sent && !write_client(client))
+            done.push_back(c.first);
+        else if (client.eof && client.unanswered == 0 && client.out.empty())
+            done.push_back(c.first);
+    }
+    for (int fd : done) close_client(fd);
+}
+
+void InferenceService::accept_clients() {
+    while (true) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EINTR)
+                std::cerr << "Inference service: accept failed: " << strerror(errno) << "\n";
+            return;
+        }
+        auto client = std::make_unique<Client>();
+        client->fd = fd;
+        client->connection = next_connection_++;
+        clients_[fd] = std::move(client);
+        reactor_->add(fd, EPOLLIN, [this, fd](uint32_t events) { on_client(fd, events); });
+    }
+}
+
+bool InferenceService::read_client(Client &client) {
+    while (!client.eof) {
+        size_t used = client.in.size();
+        client.in.resize(used + INFERENCE_READ_CHUNK);
+        ssize_t got = recv(client.fd, client.in.data() + used, INFERENCE_READ_CHUNK, MSG_DONTWAIT);
+        client.in.resize(used + std::max<ssize_t>(got, 0));
+        if (got < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            return false;
+        }
+        // a client may send its requests and shut down its side straight away:
+        // what arrived before the EOF is still answered
+        if (got == 0) client.eof = true;
+        if (!parse_requests(client)) return false;
+    }
+    return true;
+}
+
+bool InferenceService::parse_requests(Client &client) {
+    size_t consumed = 0;
+    while (client.in.size() - consumed >= sizeof(InferenceRequestHeader)) {
+        InferenceRequestHeader header;
+        std::memcpy(&header, client.in.data() + consumed, sizeof(header));
+        if (header.magic != INFERENCE_REQUEST_MAGIC || header.payload_len > INFERENCE_MAX_PAYLOAD) {
+            std::cerr << "Inference service: bad request header, closing connection\n";
+            return false;
+        }
+        size_t total = sizeof(header) + header.payload_len;
+        if (client.in.size() - consumed < total) break;
+
+        auto job = std::make_shared<Job>();
+        job->connection = client.connection;
+        job->id = header.id;
+        job->input = header.input;
+        job->width = header.width;
+        job->height = header.height;
+        job->received = Clock::now();
+        job->telemetry.stamp_ns[STAMP_START] = telemetry_now_ns();
+        job->telemetry.wall_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        job->deadline = Deadline::after_ms(header.deadline_ms ? header.deadline_ms : INFERENCE_DEFAULT_DEADLINE_MS);
+        const uint8_t *payload = client.in.data() + consumed + sizeof(header);
+        job->payload.assign(payload, payload + header.payload_len);
+        consumed += total;
+        client.unanswered++;
+
+        bool valid = false;
+        switch (header.input) {
+        case INPUT_RAW:
+            valid = header.width > 0 && header.height > 0 &&
+                    header.width <= INFERENCE_MAX_DIMENSION && header.height <= INFERENCE_MAX_DIMENSION &&
+                    (uint64_t)header.width * header.height == header.payload_len;
+            break;
+        case INPUT_ENCODED:
+            valid = header.payload_len > 0;
+            break;
+        case INPUT_PIXELS:
+            valid = header.payload_len == INFERENCE_PIXELS;
+            break;
+        }
+        if (valid) {
+            admit(std::move(job));
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex_);
+            stats_.requests++;
+        }
+        complete(job, INFER_BAD_REQUEST);
+    }
+    client.in.erase(client.in.begin(), client.in.begin() + consumed);
+    return true;
+}
+
+bool InferenceService::write_client(Client &client) {
+    while (client.out_sent < client.out.size()) {
+        ssize_t sent = send(client.fd, client.out.data() + client.out_sent, client.out.size() - client.out_sent,
+                            MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        client.out_sent += sent;
+    }
+    if (client.out_sent == client.out.size()) {
+        client.out.clear();
+        client.out_sent = 0;
+    }
+
+    // after EOF the socket stays readable; only the replies are left to wait for
+    uint32_t events = (client.eof ? 0 : EPOLLIN) | (client.out.empty() ? 0 : EPOLLOUT);
+    if (events != client.events) {
+        reactor_->modify(client.fd, events);
+        client.events = events;
+    }
+    return true;
+}
+
+void InferenceService::close_client(int fd) {
+    auto it = clients_.find(fd);
+    if (it == clients_.end()) return;
+    reactor_->remove(fd);
+    close(fd);
+    clients_.erase(it);
+}
@@ -21,14 +21,27 @@ ws2811_t ledstring = {
 };
 
 // Setup signal handlers
-void setup_ws2811(void) {
+bool setup_ws2811(void) {
     
     ws2811_return_t ret;
     
     if ((ret = ws2811_init(&ledstring)) != WS2811_SUCCESS) {
         std::cerr << "ws2811_init failed: " << ws2811_get_return_t_str(ret) << std::endl;
+        return false;
     }
-    
+    return true;
+}
+
+bool Ws2811Renderer::render(const uint32_t *leds, int count) {
+    for (int i = 0; i < count && i < LED_COUNT; i++) {
+        ledstring.channel[0].leds[i] = leds[i];
+    }
+    ws2811_return_t ret = ws2811_render(&ledstring);
+    if (ret != WS2811_SUCCESS) {
+        std::cerr << "ws2811_render failed: " << ws2811_get_return_t_str(ret) << std::endl;
+        return false;
+    }
+    return true;
 }
 
 // Animation functions
@@ -117,17 +130,3 @@ void pulse(uint32_t color, int cycles, int wait_ms) {
     // Reset brightness to the original value
     ledstring.channel[0].brightness = original_brightness;
 }
-
-// Helper function to create rainbow effect
-uint32_t wheel(uint8_t pos) {
-    pos = 255 - pos;
-    if (pos < 85) {
-        return ((uint32_t)(255 - pos * 3) << 16) | ((uint32_t)(0) << 8) | (pos * 3);
-    } else if (pos < 170) {
-        pos -= 85;
-        return ((uint32_t)(0) << 16) | ((uint32_t)(pos * 3) << 8) | (255 - pos * 3);
-    } else {
-        pos -= 170;
-        return ((uint32_t)(pos * 3) << 16) | ((uint32_t)(255 - pos * 3) << 8) | (0);
-    }
-}
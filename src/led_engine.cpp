@@ -0,0 +1,266 @@
+#include "led_engine.h"
+#include "telemetry.h"
+
+#include <iostream>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+using Clock = std::chrono::steady_clock;
+
+// Blend two 0x00RRGGBB colors channel by channel, f = 0 gives a
+static uint32_t mix(uint32_t a, uint32_t b, double f) {
+    uint32_t out = 0;
+    for (int shift = 0; shift <= 16; shift += 8) {
+        double ca = (a >> shift) & 0xFF;
+        double cb = (b >> shift) & 0xFF;
+        out |= static_cast<uint32_t>(std::lround(ca + (cb - ca) * f)) << shift;
+    }
+    return out;
+}
+
+// The base state is what set(), blend() and wipes leave behind
+static bool is_base(LedEffectType type) {
+    return type == LED_SOLID || type == LED_BLEND || type == LED_WIPE;
+}
+
+LedEngine::LedEngine(int count) : count_(count) {
+    frame_.assign(count_, COLOR_BLACK);
+}
+
+LedEngine::~LedEngine() {
+    stop();
+}
+
+bool LedEngine::start(LedRenderer &renderer, int fps) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_)
+        return true;
+    if (fps < 1) {
+        std::cerr << "LED engine: bad frame rate " << fps << "\n";
+        return false;
+    }
+    renderer_ = &renderer;
+    frame_ns_ = 1000000000ull / fps;
+    running_ = true;
+    thread_ = std::thread(&LedEngine::run, this);
+    return true;
+}
+
+void LedEngine::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!running_)
+            return;
+        running_ = false;
+    }
+    cv_.notify_one();
+    rendered_cv_.notify_all();
+    thread_.join();
+}
+
+void LedEngine::set(uint32_t color) {
+    LedEffect effect;
+    effect.type = LED_SOLID;
+    effect.color = color;
+    play(effect);
+}
+
+void LedEngine::blend(uint32_t color, int ms) {
+    LedEffect effect;
+    effect.type = LED_BLEND;
+    effect.color = color;
+    effect.period_ms = ms;
+    play(effect);
+}
+
+void LedEngine::pulse(uint32_t color, int period_ms, int cycles) {
+    LedEffect effect;
+    effect.type = LED_PULSE;
+    effect.color = color;
+    effect.period_ms = period_ms;
+    effect.cycles = cycles;
+    play(effect);
+}
+
+void LedEngine::play(const LedEffect &effect) {
+    post({ Command::EFFECT, effect });
+}
+
+void LedEngine::cancel() {
+    post({ Command::CANCEL, LedEffect() });
+}
+
+void LedEngine::post(const Command &command) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        commands_.push_back(command);
+        posted_++;
+    }
+    cv_.notify_one();
+}
+
+bool LedEngine::wait_rendered(int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    uint64_t target = posted_;
+    return rendered_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                                 [&] { return rendered_ >= target || !running_; }) && rendered_ >= target;
+}
+
+void LedEngine::begin(Running &r, const LedEffect &effect, uint64_t now) {
+    r.effect = effect;
+    r.start_ns = now;
+    r.from = frame_;
+    r.active = true;
+}
+
+bool LedEngine::draw(Running &r, uint64_t now) {
+    const LedEffect &e = r.effect;
+    double t_ms = (now - r.start_ns) / 1e6;
+    int period = std::max(1, e.period_ms);
+    uint64_t step = static_cast<uint64_t>(t_ms / period);
+
+    switch (e.type) {
+    case LED_SOLID:
+        std::fill(frame_.begin(), frame_.end(), e.color);
+        return false;
+
+    case LED_BLEND: {
+        double f = e.period_ms > 0 ? std::min(1.0, t_ms / e.period_ms) : 1.0;
+        for (int i = 0; i < count_; i++)
+            frame_[i] = mix(r.from[i], e.color, f);
+        return f < 1.0;
+    }
+
+    case LED_WIPE:
+        for (int i = 0; i < count_; i++)
+            frame_[i] = (uint64_t)i <= step ? e.color : r.from[i];
+        return step + 1 < (uint64_t)count_;
+
+    case LED_PULSE: {
+        if (e.cycles > 0 && step >= (uint64_t)e.cycles)
+            return false;
+        double phase = std::fmod(t_ms, period) / period;
+        double level = 1.0 - std::fabs(2.0 * phase - 1.0);
+        std::fill(frame_.begin(), frame_.end(), mix(COLOR_BLACK, e.color, level));
+        return true;
+    }
+
+    case LED_CHASE:
+        if (e.cycles > 0 && step >= 3ull * e.cycles)
+            return false;
+        for (int i = 0; i < count_; i++)
+            frame_[i] = (uint64_t)(i % 3) == step % 3 ? e.color : COLOR_BLACK;
+        return true;
+
+    case LED_RAINBOW:
+    case LED_RAINBOW_CYCLE:
+        if (e.cycles > 0 && step >= 256ull * e.cycles)
+            return false;
+        for (int i = 0; i < count_; i++) {
+            uint64_t offset = e.type == LED_RAINBOW_CYCLE ? i * 256 / count_ : i;
+            frame_[i] = wheel((offset + step) & 255);
+        }
+        return true;
+    }
+    return false;
+}
+
+void LedEngine::run() {
+    pthread_setname_np(pthread_self(), "ann-leds");
+    if (setpriority(PRIO_PROCESS, syscall(SYS_gettid), LED_ENGINE_NICE) != 0)
+        std::cerr << "LED engine: could not lower the render thread's priority\n";
+
+    Running base;
+    Running effect;
+    begin(base, LedEffect(), telemetry_now_ns());
+    Clock::time_point next = Clock::now();
+    bool dirty = true;
+    bool was_moving = false;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (running_) {
+        uint64_t taken = posted_;
+        while (!commands_.empty()) {
+            Command command = commands_.front();
+            commands_.pop_front();
+            dirty = true;
+            if (command.kind == Command::CANCEL)
+                effect.active = false;
+            else if (is_base(command.effect.type))
+                begin(base, command.effect, telemetry_now_ns());
+            else
+                begin(effect, command.effect, telemetry_now_ns());
+        }
+        lock.unlock();
+
+        // the effect covers the base while it runs; the base keeps its own clock
+        uint64_t now = telemetry_now_ns();
+        bool moving = draw(base, now);
+        if (effect.active) {
+            effect.active = draw(effect, now);
+            if (!effect.active) dirty = true;   // back to the base
+            moving = moving || effect.active;
+        }
+
+        // one more frame after an animation ends shows where it ended
+        if (moving || was_moving || dirty) {
+            renderer_->render(frame_.data(), count_);
+            frames_.fetch_add(1, std::memory_order_relaxed);
+            dirty = false;
+        }
+        was_moving = moving;
+
+        lock.lock();
+        if (rendered_ != taken) {
+            rendered_ = taken;
+            rendered_cv_.notify_all();
+        }
+        auto has_work = [this] { return !commands_.empty() || !running_; };
+        if (moving) {
+            // frame times are absolute; a late frame is skipped, not made up
+            next += std::chrono::nanoseconds(frame_ns_);
+            Clock::time_point now_tp = Clock::now();
+            if (next < now_tp) next = now_tp;
+            cv_.wait_until(lock, next, has_work);
+        } else {
+            cv_.wait(lock, has_work);
+            next = Clock::now();
+        }
+    }
+}
+
+bool MockLedRenderer::render(const uint32_t *leds, int count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    last_.assign(leds, leds + count);
+    frames_++;
+    return true;
+}
+
+uint64_t MockLedRenderer::frames() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return frames_;
+}
+
+std::vector<uint32_t> MockLedRenderer::last() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return last_;
+}
+
+// Helper function to create rainbow effect
+uint32_t wheel(uint8_t pos) {
+    pos = 255 - pos;
+    if (pos < 85) {
+        return ((uint32_t)(255 - pos * 3) << 16) | ((uint32_t)(0) << 8) | (pos * 3);
+    } else if (pos < 170) {
+        pos -= 85;
+        return ((uint32_t)(0) << 16) | ((uint32_t)(pos * 3) << 8) | (255 - pos * 3);
+    } else {
+        pos -= 170;
+        return ((uint32_t)(pos * 3) << 16) | ((uint32_t)(255 - pos * 3) << 8) | (0);
+    }
+}
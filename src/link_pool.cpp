@@ -0,0 +1,307 @@
+#include "link_pool.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <thread>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+using Clock = std::chrono::steady_clock;
+
+LinkPool::LinkPool(int max_in_flight_per_board) : max_in_flight_(max_in_flight_per_board) {
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+LinkPool::~LinkPool() {
+    for (auto &b : boards_) {
+        if (b->reconnect.joinable()) b->reconnect.join();
+    }
+    if (wake_fd_ >= 0) close(wake_fd_);
+}
+
+void LinkPool::interrupt() {
+    uint64_t one = 1;
+    if (write(wake_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        std::cerr << "Link pool: failed to interrupt poll\n";
+}
+
+int LinkPool::add_board(std::unique_ptr<UartTransport> uart) {
+    auto board = std::make_unique<Board>();
+    board->link = std::make_unique<StmLink>(*uart, max_in_flight_);
+    board->uart = std::move(uart);
+    boards_.push_back(std::move(board));
+    return boards_.size() - 1;
+}
+
+bool LinkPool::connect(int index, int timeout_ms, int attempts) {
+    Board &b = *boards_[index];
+    // one byte lost at boot should not cost the packed protocol for the whole run
+    int backoff_ms = LINK_POOL_HELLO_BACKOFF_MS;
+    for (int attempt = 0; attempt < attempts; attempt++) {
+        if (attempt > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(backoff_ms));
+            backoff_ms *= 2;
+            b.uart->flush_input();
+        }
+        if (!b.link->negotiate(timeout_ms))
+            continue;
+        b.link->negotiate_baud(baud_candidates_, timeout_ms);
+        b.rate = b.uart->baud();
+        std::cerr << "Board " << index << " (" << b.uart->name() << "): protocol v" << b.link->peer_version()
+                  << ", " << b.uart->baud() << " baud\n";
+        return true;
+    }
+    return false;
+}
+
+int LinkPool::start(const std::vector<int> &baud_candidates, int timeout_ms) {
+    baud_candidates_ = baud_candidates;
+    for (size_t i = 0; i < boards_.size(); i++) {
+        Board &b = *boards_[i];
+        b.stats.healthy = connect(i, timeout_ms, LINK_POOL_HELLO_ATTEMPTS);
+        if (!b.stats.healthy) {
+            std::cerr << "Board " << i << " (" << b.uart->name() << ") did not answer\n";
+            b.next_probe = Clock::now() + std::chrono::milliseconds(LINK_POOL_PROBE_INTERVAL_MS);
+        }
+    }
+    return healthy();
+}
+
+int LinkPool::reprobe(int timeout_ms) {
+    for (size_t i = 0; i < boards_.size(); i++) {
+        Board &b = *boards_[i];
+        if (b.stats.healthy || !b.pending.empty())
+            continue;
+        b.uart->flush_input();
+        if (connect(i, timeout_ms, 1)) {
+            b.stats.healthy = true;
+            b.stats.consecutive_failures = 0;
+        }
+    }
+    return healthy();
+}
+
+int LinkPool::healthy() const {
+    int n = 0;
+    for (const auto &b : boards_)
+        n += b->stats.healthy;
+    return n;
+}
+
+int LinkPool::in_flight() const {
+    int n = 0;
+    for (const auto &b : boards_)
+        n += b->pending.size();
+    return n;
+}
+
+bool LinkPool::has_capacity() const {
+    for (const auto &b : boards_) {
+        if (b->stats.healthy && !b->link->window_full())
+            return true;
+    }
+    return false;
+}
+
+int LinkPool::submit(uint64_t tag, const std::vector<double> &coefficients, int timeout_ms, int exclude_board) {
+    // least outstanding requests; ties go to the board that has been faster
+    int best = -1;
+    for (size_t i = 0; i < boards_.size(); i++) {
+        const Board &b = *boards_[i];
+        if (!b.stats.healthy || b.link->window_full() || (int)i == exclude_board)
+            continue;
+        if (best < 0) {
+            best = i;
+            continue;
+        }
+        const Board &cur = *boards_[best];
+        if (b.pending.size() < cur.pending.size() ||
+            (b.pending.size() == cur.pending.size() && b.stats.latency_ewma_us < cur.stats.latency_ewma_us))
+            best = i;
+    }
+    if (best < 0)
+        return -1;
+
+    Board &b = *boards_[best];
+    int seq = b.link->send_coefficients(coefficients, timeout_ms);
+    if (seq < 0) {
+        record_failure(best);
+        return -1;
+    }
+
+    b.pending[seq] = { tag, Clock::now() };
+    b.stats.in_flight = b.pending.size();
+    return best;
+}
+
+void LinkPool::cancel(uint64_t tag) {
+    for (auto &b : boards_) {
+        for (auto it = b->pending.begin(); it != b->pending.end(); ++it) {
+            if (it->second.tag == tag) {
+                b->link->cancel(it->first);
+                b->pending.erase(it);
+                b->stats.in_flight = b->pending.size();
+                return;
+            }
+        }
+    }
+}
+
+void LinkPool::record_failure(int index) {
+    Board &b = *boards_[index];
+    b.stats.failures++;
+    if (++b.stats.consecutive_failures >= LINK_POOL_MAX_FAILURES && b.stats.healthy) {
+        std::cerr << "Board " << index << " (" << b.uart->name() << ") taken out of rotation\n";
+        b.stats.healthy = false;
+        b.next_probe = Clock::now() + std::chrono::milliseconds(LINK_POOL_PROBE_INTERVAL_MS);
+    }
+}
+
+void LinkPool::start_reconnect(int index) {
+    // the echo tests and commit windows take seconds; the dispatcher cannot wait them out
+    Board *b = boards_[index].get();
+    b->reconnecting = true;
+    b->reconnect = std::thread([this, b, index] {
+        b->reconnected = connect(index, reply_timeout_ms_, 1);
+        b->reconnecting = false;
+        interrupt();
+    });
+}
+
+void LinkPool::finish_reconnect(int index) {
+    Board &b = *boards_[index];
+    b.reconnect.join();
+    if (b.reconnected) {
+        std::cerr << "Board " << index << " (" << b.uart->name() << ") back in rotation\n";
+        b.stats.healthy = true;
+        b.stats.consecutive_failures = 0;
+        b.probes = 0;
+    } else {
+        b.next_probe = Clock::now() + std::chrono::milliseconds(LINK_POOL_PROBE_INTERVAL_MS);
+    }
+}
+
+void LinkPool::drain(int index, std::vector<InferenceResult> &out) {
+    Board &b = *boards_[index];
+    StmFrame frame;
+    Clock::time_point now = Clock::now();
+
+    while (b.link->take_any(frame)) {
+        if (frame.sequence == b.probe_sequence) {
+            b.probe_sequence = -1;
+            // the STM may have been reset: encoding and rate are negotiated from scratch
+            if (frame.type == STM_MSG_HELLO_ACK || frame.type == STM_MSG_ERROR) {
+                start_reconnect(index);
+                break;
+            }
+            continue;
+        }
+
+        auto it = b.pending.find(frame.sequence);
+        if (it == b.pending.end())
+            continue;
+
+        InferenceResult r;
+        r.tag = it->second.tag;
+        r.board = index;
+        r.latency_us = std::chrono::duration<double, std::micro>(now - it->second.sent_at).count();
+        r.ok = StmLink::decode_softmax(frame, r.softmax);
+        r.crc_errors = b.link->parser().crc_errors();
+        b.pending.erase(it);
+
+        if (r.ok) {
+            b.stats.completed++;
+            b.stats.consecutive_failures = 0;
+            b.stats.latency_ewma_us = b.stats.latency_ewma_us == 0.0
+                ? r.latency_us : 0.9 * b.stats.latency_ewma_us + 0.1 * r.latency_us;
+        } else {
+            record_failure(index);
+        }
+        out.push_back(std::move(r));
+    }
+    b.stats.in_flight = b.pending.size();
+}
+
+int LinkPool::poll(std::vector<InferenceResult> &out, int timeout_ms) {
+    size_t before = out.size();
+
+    for (size_t i = 0; i < boards_.size(); i++) {
+        if (boards_[i]->reconnect.joinable() && !boards_[i]->reconnecting)
+            finish_reconnect(i);
+    }
+
+    // wait on every board that has a descriptor; register backends are polled without waiting
+    std::vector<struct pollfd> pfds;
+    std::vector<int> index;
+    bool busy_poll = false;
+    for (size_t i = 0; i < boards_.size(); i++) {
+        if (boards_[i]->reconnect.joinable())
+            continue;
+        int fd = boards_[i]->uart->fd();
+        if (fd >= 0) {
+            pfds.push_back({ fd, POLLIN, 0 });
+            index.push_back(i);
+        } else {
+            busy_poll = true;
+        }
+    }
+    if (busy_poll)
+        timeout_ms = std::min(timeout_ms < 0 ? 1 : timeout_ms, 1);
+
+    // interrupt() ends the wait early, e.g. when new work is ready to submit
+    pfds.push_back({ wake_fd_, POLLIN, 0 });
+    ::poll(pfds.data(), pfds.size(), timeout_ms);
+    if (pfds.back().revents & POLLIN) {
+        uint64_t count;
+        if (read(wake_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN)
+            std::cerr << "Link pool: failed to read wake count\n";
+    }
+
+    for (size_t i = 0; i < boards_.size(); i++) {
+        Board &b = *boards_[i];
+        if (b.reconnect.joinable())
+            continue;
+        auto it = std::find(index.begin(), index.end(), (int)i);
+        bool readable = it == index.end() || pfds[it - index.begin()].revents;
+        if (readable)
+            b.link->poll(0);
+        drain(i, out);
+    }
+
+    // expire overdue requests and re-probe boards that were taken out of rotation
+    Clock::time_point now = Clock::now();
+    for (size_t i = 0; i < boards_.size(); i++) {
+        Board &b = *boards_[i];
+        if (b.reconnect.joinable())
+            continue;
+        for (auto it = b.pending.begin(); it != b.pending.end();) {
+            if (now - it->second.sent_at < std::chrono::milliseconds(reply_timeout_ms_)) {
+                ++it;
+                continue;
+            }
+            InferenceResult r;
+            r.tag = it->second.tag;
+            r.board = i;
+            r.latency_us = std::chrono::duration<double, std::micro>(now - it->second.sent_at).count();
+            out.push_back(std::move(r));
+            b.link->cancel(it->first);
+            it = b.pending.erase(it);
+            record_failure(i);
+        }
+        b.stats.in_flight = b.pending.size();
+
+        if (!b.stats.healthy && b.pending.empty() && now >= b.next_probe) {
+            // the last rate, then the default a power-cycled STM comes back at
+            int rate = b.probes++ % 2 ? b.rate : UART_DEFAULT_BAUD;
+            if (b.uart->baud() != rate)
+                b.uart->set_baud(rate);
+            b.link->reset();
+            b.probe_sequence = b.link->send_hello(0);
+            b.next_probe = now + std::chrono::milliseconds(LINK_POOL_PROBE_INTERVAL_MS);
+        }
+    }
+
+    return out.size() - before;
+}
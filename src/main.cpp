@@ -1,119 +1,764 @@
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <pthread.h>
 #include <iostream>
 #include <vector>
 #include <sstream>
+#include <iomanip>
 #include <fstream>
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/epoll.h>
 #include <sys/types.h>
-#include <fcntl.h> // Added for FIFO write
 
 #include "audio_processing_pipeline.h"
 #include "image_process_pipeline.h"
 #include "utilities.h"
 #include "gpio.h"
 #include "uart.h"
+#include "uart_transport.h"
+#include "stm_link.h"
+#include "link_pool.h"
+#include "digital_inference.h"
+#ifndef ANN_NO_HARDWARE
 #include "led.h"
 #include "camera.h"
+#endif
+#include "led_engine.h"
+#include "camera_source.h"
+#include "sim_boards.h"
+#include "capture_recorder.h"
+#include "deadline.h"
+#include "result_ring.h"
+#include "dashboard_server.h"
+#include "debug_encoder.h"
+#include "inference_service.h"
+#include "telemetry.h"
+#include "frame_pipeline.h"
+#include "button.h"
+#include "reactor.h"
+#include "realtime.h"
+#include "startup.h"
+#include "thermal_monitor.h"
+#include "preprocess_graph.h"
+#include "stage_taps.h"
 #include "stb/stb_image.h"
 #include "stb/stb_image_write.h"
 
-int main() {
-    // Initialize hardware and image processing pipeline
-    gpio_init();
-    uart_init();
-    image_processing_init();
-    audio_processing_init();
-
-    gpio_func_select(OUTPUT, 16);
-    gpio_func_select(INPUT, 27);
-    gpio_func_select(ALT4, 4);
-    gpio_func_select(ALT4, 5);
-    
-    gpio_pull_resistor(PULL_UP, 27);
-    gpio_set(21);
-    setup_ws2811();
-    solidColor(COLOR_WHITE);
-    
-    CameraContext ctx;
-    if (!init_camera(ctx, 1440, 1440, 14)){
-        std::cerr << "Camera init failed!!" << std::endl;
+#define CAMERA_PROFILE_NAME "led_ring"
+#define UART_REPLY_TIMEOUT_MS 500
+// Boards that fell back to the legacy exchange are asked for HELLO again this
+// often, doubling up to the maximum while they stay silent
+#define LEGACY_PROBE_TIMEOUT_MS 50
+#define LEGACY_PROBE_MAX_MS 60000
+// Budget from button press to published result
+#define REQUEST_DEADLINE_MS 2000
+// Pipeline stage timings are printed this often with --continuous
+#define PIPELINE_REPORT_S 10
+// Completed and per-stage timeout counts are printed this often when they changed
+#define COUNTERS_REPORT_S 60
+// Status animations on the LED ring
+#define LED_STARTUP_PULSE_MS 1000
+#define LED_FAULT_PULSE_MS 400
+#define LED_SETTLE_TIMEOUT_MS 200
+// --sim: recorded frames in place of the camera, presses from a FIFO
+#define SIM_CAMERA_PATH "./data/720p_test_8.jpg"
+#define SIM_CAPTURE_US 30000
+#define SIM_BUTTON_PIPE "/tmp/ann-button"
+// Work shed when the Pi runs hot: the dashboard capture is cut to this size
+// when warm; when hot, --continuous captures are spaced this far apart
+#define THERMAL_WARM_RAW_SIZE 240
+#define THERMAL_HOT_CAPTURE_MS 500
+
+int main(int argc, char **argv) {
+    bool recalibrate = false;
+    bool uart_registers = false;
+    bool legacy_link = false;
+    int max_baud = STM_BAUD_CANDIDATES[0];
+    bool digital_only = false;
+    std::string weights_path = DIGITAL_WEIGHTS_PATH;
+    AnalogModel analog_model;
+    std::vector<std::string> uart_devices;
+    int deadline_ms = REQUEST_DEADLINE_MS;
+    bool dashboard_enabled = true;
+    DashboardConfig dashboard_config;
+    DebugStageSettings raw_jpeg = { DEBUG_RAW_SIZE, DEBUG_RAW_QUALITY };
+    std::string service_socket = INFERENCE_SOCKET_PATH;
+    bool telemetry_enabled = true;
+    bool continuous = false;
+    std::string button_chip = BUTTON_GPIO_CHIP;
+    int button_debounce_us = BUTTON_DEBOUNCE_US;
+    bool button_registers = false;
+    bool realtime_enabled = true;
+    std::string realtime_path = REALTIME_CONFIG_PATH;
+    std::string preprocess_path = PREPROCESS_CONFIG_PATH;
+    std::string tap_socket = TAP_SOCKET_PATH;
+    std::string tap_dir = TAP_DIR;
+    int jitter_s = 0;
+    // Builds without the Pi libraries (make HARDWARE=0) only run simulated
+#ifdef ANN_NO_HARDWARE
+    bool sim = true;
+#else
+    bool sim = false;
+#endif
+    int sim_boards_count = SIM_BOARDS;
+    FakeStmConfig sim_board;
+    sim_board.infer_delay_us = SIM_INFER_US;
+    std::string sim_camera = SIM_CAMERA_PATH;
+    int sim_capture_us = SIM_CAPTURE_US;
+    std::string button_pipe;
+    std::string ready_file;
+    bool thermal_enabled = true;
+    ThermalConfig thermal_config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--calibrate") recalibrate = true;
+        else if (arg == "--uart-registers") uart_registers = true;
+        else if (arg == "--legacy-link") legacy_link = true;
+        else if (arg == "--max-baud" && i + 1 < argc) max_baud = atoi(argv[++i]);
+        else if (arg == "--uart" && i + 1 < argc) uart_devices.push_back(argv[++i]);
+        else if (arg == "--digital") digital_only = true;
+        else if (arg == "--weights" && i + 1 < argc) weights_path = argv[++i];
+        else if (arg == "--deadline-ms" && i + 1 < argc) deadline_ms = atoi(argv[++i]);
+        else if (arg == "--no-dashboard") dashboard_enabled = false;
+        else if (arg == "--dashboard-bind" && i + 1 < argc) dashboard_config.bind_address = argv[++i];
+        else if (arg == "--dashboard-port" && i + 1 < argc) dashboard_config.port = atoi(argv[++i]);
+        else if (arg == "--socket" && i + 1 < argc) service_socket = argv[++i];
+        else if (arg == "--no-socket") service_socket.clear();
+        else if (arg == "--no-telemetry") telemetry_enabled = false;
+        else if (arg == "--continuous") continuous = true;
+        else if (arg == "--button-chip" && i + 1 < argc) button_chip = argv[++i];
+        else if (arg == "--button-debounce-us" && i + 1 < argc) button_debounce_us = atoi(argv[++i]);
+        else if (arg == "--button-registers") button_registers = true;
+        else if (arg == "--no-realtime") realtime_enabled = false;
+        else if (arg == "--realtime-config" && i + 1 < argc) realtime_path = argv[++i];
+        else if (arg == "--preprocess" && i + 1 < argc) preprocess_path = argv[++i];
+        else if (arg == "--tap-socket" && i + 1 < argc) tap_socket = argv[++i];
+        else if (arg == "--no-taps") tap_socket.clear();
+        else if (arg == "--tap-dir" && i + 1 < argc) tap_dir = argv[++i];
+        else if (arg == "--jitter" && i + 1 < argc) jitter_s = atoi(argv[++i]);
+        else if (arg == "--button-pipe" && i + 1 < argc) button_pipe = argv[++i];
+        else if (arg == "--ready-file" && i + 1 < argc) ready_file = argv[++i];
+        else if (arg == "--no-thermal") thermal_enabled = false;
+        else if (arg == "--sysfs-root" && i + 1 < argc) thermal_config.root = argv[++i];
+        else if (arg == "--thermal-warm" && i + 1 < argc) thermal_config.warm_c = atof(argv[++i]);
+        else if (arg == "--thermal-hot" && i + 1 < argc) thermal_config.hot_c = atof(argv[++i]);
+        else if (arg == "--sim") sim = true;
+        else if (arg == "--sim-boards" && i + 1 < argc) sim_boards_count = atoi(argv[++i]);
+        else if (arg == "--sim-infer-us" && i + 1 < argc) sim_board.infer_delay_us = atoi(argv[++i]);
+        else if (arg == "--sim-camera" && i + 1 < argc) sim_camera = argv[++i];
+        else if (arg == "--sim-capture-us" && i + 1 < argc) sim_capture_us = atoi(argv[++i]);
+        else if (arg == "--raw-jpeg" && i + 2 < argc) {
+            // size (0 = full resolution) and quality of the dashboard capture image
+            raw_jpeg.size = atoi(argv[++i]);
+            raw_jpeg.quality = atoi(argv[++i]);
+        }
+        else if (arg == "--analog-noise" && i + 1 < argc) {
+            // model the board's DAC, noise and wire quantization on the host
+            analog_model.input_bits = 12;
+            analog_model.output_bits = 16;
+            analog_model.activation_noise = atof(argv[++i]);
+        }
     }
-    
-    int flag_buf = 1;
-    
-    std::vector<uint8_t> image_data;
-    std::vector<double> pca_coefficients;
-    while(true) {
-        int flag = gpio_read(27); // Check the push button
-        if(!flag && flag_buf) {
-
-            //std::cerr << "Image capture started\n";
-            capture_grayscale_image(ctx, image_data);
-            //std::cerr << "Image capture complete\n";
-            
-            //stbi_write_jpg("data/image.jpg", 1440, 1440, 1, image_data.data(), 100);
-            
-            process_image(image_data, 1440, 1440, pca_coefficients);
-            
-            std::vector<int32_t> pca_coefficients_send;
-            pca_coefficients_send.assign(pca_coefficients.size(), 0);
-            
-            for (int n = 0; n < pca_coefficients.size(); n++){
-                pca_coefficients_send[n] = (pca_coefficients[n] * 10000);
+    if (sim && button_pipe.empty()) button_pipe = SIM_BUTTON_PIPE;
+    if (uart_registers && !uart_devices.empty()) {
+        // the register backend only maps UART3
+        std::cerr << "--uart-registers drives UART3 only and cannot be combined with --uart" << std::endl;
+        return 1;
+    }
+
+    // Thread priorities and CPUs come from the config; memory is locked before
+    // anything is allocated so no buffer or stack faults on the button path
+    RealtimeConfig realtime;
+    realtime_default_config(realtime);
+    if (!load_realtime_config(realtime_path, realtime)) {
+        std::cerr << "Real-time: using the default thread layout" << std::endl;
+    }
+    if (realtime_enabled) realtime_lock_memory();
+    if (jitter_s > 0) {
+        // --jitter only measures scheduling latency with that layout (compare with --no-realtime)
+        realtime_measure_jitter(realtime, jitter_s, std::cout);
+        return 0;
+    }
+
+    // Startup runs as a graph: the board handshakes, the model files, the
+    // camera and the LED driver come up at the same time, and each step only
+    // waits for what it uses. --sim runs the same daemon on any Linux host:
+    // GPIO registers in memory, boards played over ptys, a ring nobody sees and
+    // recorded camera frames.
+    StartupGraph startup;
+
+    startup.add("gpio", {}, [&] {
+        if (sim) gpio_init_sim();
+        else if (!gpio_init()) return false;
+        gpio_func_select(OUTPUT, 16);
+        gpio_func_select(INPUT, BUTTON_GPIO);
+        gpio_func_select(ALT4, 4);
+        gpio_func_select(ALT4, 5);
+        gpio_pull_resistor(PULL_UP, BUTTON_GPIO);
+        return true;
+    });
+
+    // The ring is animated from its own thread; pulse blue while the boards start
+    std::unique_ptr<LedRenderer> led_renderer;
+    LedEngine leds;
+    // ws2811_init selects GPIO 18's function in the same GPFSEL register the gpio step writes
+    startup.add("leds", {"gpio"}, [&] {
+#ifndef ANN_NO_HARDWARE
+        if (!sim) {
+            // without the driver the ring stays dark instead of failing every frame
+            if (setup_ws2811()) led_renderer = std::make_unique<Ws2811Renderer>();
+            else std::cerr << "LED ring disabled" << std::endl;
+        }
+#endif
+        if (!led_renderer) led_renderer = std::make_unique<MockLedRenderer>();
+        leds.start(*led_renderer);
+        leds.pulse(COLOR_BLUE, LED_STARTUP_PULSE_MS);
+        return true;
+    });
+
+    // One analog board per UART (--uart may be repeated). Kernel tty driver by
+    // default, PL011 registers if asked for or if the tty is missing.
+    SimBoards sim_boards;
+    LinkPool pool;
+    int answered_hello = 0;
+    startup.add("boards", {"gpio"}, [&] {
+        if (digital_only) return true;
+        if (sim && uart_devices.empty()) {
+            if (!sim_boards.start(sim_boards_count, sim_board)) return false;
+            uart_devices = sim_boards.devices();
+        }
+        if (uart_devices.empty()) uart_devices.push_back(UART_DEFAULT_DEVICE);
+        for (const std::string &device : uart_devices) {
+            auto tty = std::make_unique<TtyUartTransport>();
+            if (!uart_registers && tty->open(device)) pool.add_board(std::move(tty));
+        }
+        if (pool.size() == 0) {
+            if (sim) return false;
+            auto regs = std::make_unique<RegisterUartTransport>();
+            if (!regs->open(UART3_OFFSET)) return false;
+            pool.add_board(std::move(regs));
+        }
+        if (legacy_link) return true;
+
+        std::vector<int> rates;
+        for (int rate : STM_BAUD_CANDIDATES) {
+            if (rate <= max_baud) rates.push_back(rate);
+        }
+        // v2 firmware gets the packed encoding, firmware that ignores HELLO the raw exchange
+        // (unless the host model can take over, which the service step decides)
+        answered_hello = pool.start(rates, UART_REPLY_TIMEOUT_MS);
+        return true;
+    });
+
+    // The host model serves overflow traffic, or everything with --digital
+    DigitalInference digital;
+    startup.add("host_model", {}, [&] {
+        if (access(weights_path.c_str(), R_OK) == 0) {
+            digital.load(weights_path, analog_model);
+        }
+        return digital.loaded() || !digital_only;
+    });
+
+    startup.add("pca_models", {}, [&] {
+        image_processing_init(preprocess_path);
+        audio_processing_init();
+        // New PCA files or stage lists dropped into data/ are picked up without a restart
+        model_registry().watch();
+        return true;
+    });
+
+    // One record per button press and per socket request
+    TelemetryLog telemetry_log;
+    startup.add("telemetry", {}, [&] {
+        if (telemetry_enabled && !telemetry_log.start()) {
+            std::cerr << "Telemetry log disabled" << std::endl;
+        }
+        return true;
+    });
+
+    // Socket clients, the dashboard, the button and the timers all share one
+    // epoll thread; the work itself happens on the threads their handlers feed
+    Reactor reactor;
+    startup.add("reactor", {}, [&] { return reactor.start(); });
+
+    // The backend belongs to the service from here on; the button path and
+    // local clients on the socket share it
+    StageCounters counters;
+    OverflowBackend overflow(pool, digital);
+    InferenceBackend *backend = &pool;
+    UartTransport *uart = nullptr;
+    std::unique_ptr<InferenceService> service;
+    bool legacy_fallback = false;
+    startup.add("service", {"boards", "host_model", "pca_models", "telemetry", "reactor"}, [&] {
+        // boards on old firmware still get the button path, even with the host model loaded
+        if (digital_only) {
+            backend = &digital;
+        } else if (!legacy_link && answered_hello == 0 && pool.size()) {
+            std::cerr << "No STM answered HELLO, using legacy exchange on " << pool.transport(0).name() << std::endl;
+            legacy_link = true;
+            legacy_fallback = true;
+        }
+        if (!digital_only && digital.loaded()) backend = &overflow;
+        uart = pool.size() ? &pool.transport(0) : nullptr;
+        if (!uart) legacy_link = false;
+
+        service = std::make_unique<InferenceService>(*backend, counters);
+        if (telemetry_log.running()) service->set_telemetry(&telemetry_log);
+        if (!legacy_link && !service->start(service_socket, INFERENCE_WORKERS, &reactor)) {
+            // without the socket the button path still goes through the service
+            service->start("", INFERENCE_WORKERS, &reactor);
+        }
+        return true;
+    });
+
+    // Debounced, kernel-timestamped edges from the GPIO character device;
+    // polling the level register is the fallback. The reactor hands presses
+    // to the capture thread.
+    std::unique_ptr<ButtonSource> button;
+    SpscRing<ButtonPress> presses(BUTTON_EVENT_BUFFER);
+    auto collect_presses = [&] {
+        ButtonPress press;
+        while (button->read_press(press)) {
+            if (!presses.push(press)) std::cerr << "Dropped button press " << press.seqno << std::endl;
+        }
+    };
+    startup.add("button", {"gpio", "reactor"}, [&] {
+        if (!button_pipe.empty()) {
+            // --button-pipe (and --sim): presses written by tools/load_gen or a script
+            auto pipe = std::make_unique<PipeButton>();
+            if (!pipe->open(button_pipe)) return false;
+            button = std::move(pipe);
+        } else if (!button_registers) {
+            auto chardev = std::make_unique<ChardevButton>();
+            if (chardev->open(button_chip, BUTTON_GPIO, button_debounce_us)) button = std::move(chardev);
+        }
+        if (!button) {
+            std::cerr << "Polling the button through the GPIO registers" << std::endl;
+            button = std::make_unique<RegisterButton>(gpio_read, BUTTON_GPIO);
+        }
+        if (button->fd() >= 0) reactor.add(button->fd(), EPOLLIN, [&](uint32_t) { collect_presses(); });
+        else reactor.add_timer(BUTTON_POLL_INTERVAL_MS, collect_presses);
+        gpio_set(21);
+        return true;
+    });
+
+    // Enumeration, configuration and buffers do not need the light...
+    std::unique_ptr<CameraSource> camera;
+    bool camera_ok = true;
+    startup.add("camera", {}, [&] {
+#ifndef ANN_NO_HARDWARE
+        if (!sim) {
+            auto pi_camera = std::make_unique<LibcameraSource>();
+            if (!init_camera(pi_camera->context(), 1440, 1440, 14)){
+                std::cerr << "Camera init failed!!" << std::endl;
+                camera_ok = false;
             }
-            
-            uart_send_pca_data(pca_coefficients_send);
-            
-            //std::cerr << "Data sent to STM!\n";
-            
+            camera = std::move(pi_camera);
+            return true;
+        }
+#endif
+        auto replay = std::make_unique<ReplayCamera>();
+        if (!replay->open(sim_camera, 1440, 1440, sim_capture_us)) return false;
+        camera = std::move(replay);
+        return true;
+    });
 
-            uint8_t bytes[4];
-            int32_t softmax_result[10];
-            
-            /*
-            for (int i = 0; i < 12; i++){
-                std::cerr << pca_coefficients_send[i]/10000.0 << std::endl;
+    // ...metering does: the ring lights the captures, steady white first
+    startup.add("camera_profile", {"camera", "leds"}, [&] {
+        leds.cancel();
+        if (!camera_ok) {
+            leds.pulse(COLOR_RED, LED_FAULT_PULSE_MS);
+            return true;
+        }
+        leds.set(COLOR_WHITE);
+        leds.wait_rendered(LED_SETTLE_TIMEOUT_MS);
+#ifndef ANN_NO_HARDWARE
+        if (!sim) {
+            // Lock exposure, white balance and focus so no capture waits on convergence
+            CameraContext &ctx = static_cast<LibcameraSource &>(*camera).context();
+            CameraProfile profile;
+            if (recalibrate || !load_camera_profile(CAMERA_PROFILE_PATH, CAMERA_PROFILE_NAME, profile)) {
+                if (calibrate_camera_profile(ctx, CAMERA_PROFILE_NAME, profile)) {
+                    save_camera_profile(CAMERA_PROFILE_PATH, profile);
+                } else if (recalibrate && load_camera_profile(CAMERA_PROFILE_PATH, CAMERA_PROFILE_NAME, profile)) {
+                    std::cerr << "Keeping the stored camera profile" << std::endl;
+                }
             }
-            */
-            
-            //std::cerr << "=======================================\n";
-            int i = 0; 
-            while(i < 10){
-                for (int j = 0; j < 4; j++){
-                    bytes[j] =  uart_receive_char();
+            use_camera_profile(ctx, profile);
+        }
+#else
+        (void)recalibrate;      // nothing to calibrate without the camera
+#endif
+        return true;
+    });
+
+    // One capture through preprocessing before the daemon reports ready, so
+    // the first press does not pay for the camera's first request or for
+    // loading the code and model pages (the preprocessing thread's own
+    // buffers are still sized by the first press)
+    startup.add("warm_up", {"camera_profile", "pca_models"}, [&] {
+        if (!camera_ok) return true;
+        std::vector<uint8_t> image(1440 * 1440);
+        std::vector<double> coefficients;
+        Deadline deadline = Deadline::after_ms(deadline_ms);
+        if (!camera->capture(image, deadline) ||
+            !process_image(image, 1440, 1440, coefficients, nullptr, deadline)) {
+            std::cerr << "Warm-up capture failed" << std::endl;
+        }
+        return true;
+    });
+
+    CaptureRecorder recorder;
+    startup.add("recorder", {}, [&] {
+        if (!recorder.start(RECORDER_DIR, realtime_enabled ? RECORDER_LOCKED_SEGMENT_SIZE : RECORDER_SEGMENT_SIZE)) {
+            std::cerr << "Capture recorder disabled" << std::endl;
+        }
+        return true;
+    });
+
+    // Results and debug images for the dashboard process
+    ResultRing results_ring;
+    startup.add("results_ring", {}, [&] {
+        if (!results_ring.create()) {
+            std::cerr << "Dashboard results disabled" << std::endl;
+        }
+        return true;
+    });
+    // Temperature, clock and throttling are sampled into the telemetry log;
+    // the pipeline sheds optional work by the level
+    ThermalMonitor thermal;
+    startup.add("thermal", {"reactor", "telemetry"}, [&] {
+        if (!thermal_enabled) return true;
+        thermal.start(thermal_config, reactor, [&](const ThermalSample &sample) {
+            telemetry_log.set_thermal_level(sample.level);
+            if (!telemetry_log.running()) return;
+            ThermalRecord record = {};
+            record.stamp_ns = sample.stamp_ns;
+            record.temp_mc = sample.temp_mc;
+            record.freq_khz = sample.freq_khz;
+            record.max_freq_khz = sample.max_freq_khz;
+            record.throttled = sample.throttled;
+            record.level = sample.level;
+            telemetry_log.append(record);
+        });
+        return true;
+    });
+
+    // Operator screens connect here directly (--no-dashboard leaves the port to transmitter.py)
+    DashboardServer dashboard;
+    startup.add("dashboard", {"reactor"}, [&] {
+        if (dashboard_enabled && !dashboard.start(dashboard_config, &reactor)) {
+            std::cerr << "Dashboard server disabled" << std::endl;
+        }
+        return true;
+    });
+
+    // Preprocessing stage outputs of live frames on request (see stage_taps.h)
+    StageTaps taps;
+    bool taps_serving = false;
+    startup.add("taps", {"reactor"}, [&] {
+        if (!tap_socket.empty() && !(taps_serving = taps.serve(tap_socket, reactor))) {
+            std::cerr << "Stage taps disabled" << std::endl;
+        }
+        return true;
+    });
+
+    bool started = startup.run();
+    if (!started) {
+        startup.report(std::cerr);
+        exit(1);
+    }
+
+    // Boards that missed HELLO at boot keep being asked in the background; the
+    // first answer moves the button path onto the framed protocol and opens
+    // the socket. The button path holds the UART while it uses the raw exchange.
+    std::mutex legacy_uart_mutex;
+    std::atomic<bool> link_upgraded{false};
+    if (legacy_fallback && uart) {
+        std::thread([&] {
+            pthread_setname_np(pthread_self(), "ann-probe");
+            int interval_ms = LINK_POOL_PROBE_INTERVAL_MS;
+            while (true) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
+                std::lock_guard<std::mutex> lock(legacy_uart_mutex);
+                if (pool.reprobe(LEGACY_PROBE_TIMEOUT_MS) == 0) {
+                    interval_ms = std::min(interval_ms * 2, LEGACY_PROBE_MAX_MS);
+                    continue;
                 }
-                softmax_result[i] = 0;
-                softmax_result[i] |= (bytes[0]);
-                softmax_result[i] |= (bytes[1] << 8);
-                softmax_result[i] |= (bytes[2] << 16);
-                softmax_result[i] |= (bytes[3] << 24);
-                
-                i++;
+                std::cerr << "STM answered HELLO, leaving the legacy exchange" << std::endl;
+                if (!service->start(service_socket, INFERENCE_WORKERS, &reactor))
+                    service->start("", INFERENCE_WORKERS, &reactor);
+                link_upgraded.store(true);
+                // the dispatcher and workers only exist from now on
+                if (realtime_enabled) realtime_apply_threads(realtime);
+                return;
+            }
+        }).detach();
+    }
+
+    // JPEG encoding happens off the inference path; the encoder thread is the
+    // only writer to the ring and the dashboard. Every pipeline slot may hold a
+    // snapshot.
+    DebugImageEncoder encoder;
+    encoder.set_stage(DEBUG_STAGE_RAW, raw_jpeg);
+    if (results_ring.is_open() || dashboard.running() || taps_serving) {
+        encoder.start([&](DebugSnapshot &s) {
+            results_ring.publish(s.result, s.jpeg[DEBUG_STAGE_RAW].data(), s.jpeg[DEBUG_STAGE_RAW].size(),
+                                 s.jpeg[DEBUG_STAGE_PROCESSED].data(), s.jpeg[DEBUG_STAGE_PROCESSED].size());
+            if (!s.images.taps.empty()) taps.write(tap_dir, s.result.capture_ns, s.images.taps);
+            if (!s.has_images || !dashboard.running()) return;
+
+            auto frame = std::make_shared<DashboardFrame>();
+            frame->raw_jpg.swap(s.jpeg[DEBUG_STAGE_RAW]);
+            frame->processed_jpg.swap(s.jpeg[DEBUG_STAGE_PROCESSED]);
+            for (int n = 0; n < DASHBOARD_SOFTMAX_SIZE; n++) frame->softmax[n] = s.result.softmax[n];
+            frame->finish();
+            dashboard.broadcast(std::move(frame));
+        }, DEBUG_ENCODER_QUEUE_DEPTH, PIPELINE_SLOTS);
+    }
+
+    // Capture, preprocessing, the board exchange and publishing each run on
+    // their own thread, so consecutive presses overlap (--continuous captures
+    // back to back instead of waiting for the button)
+    FramePipeline pipeline;
+    uint64_t next_continuous_ns = 0;
+    pipeline.set_trigger([&](int timeout_ms, uint64_t &trigger_ns) {
+        trigger_ns = 0;
+        if (continuous) {
+            // hot: fewer captures rather than every capture slower
+            if (thermal.level() < THERMAL_HOT) return true;
+            uint64_t now_ns = telemetry_now_ns();
+            if (now_ns < next_continuous_ns) {
+                int wait_ms = (next_continuous_ns - now_ns) / 1000000 + 1;
+                if (timeout_ms >= 0) wait_ms = std::min(wait_ms, timeout_ms);
+                // sleeps on the press queue so stopping the pipeline still wakes it
+                ButtonPress ignored;
+                presses.pop_wait(ignored, wait_ms);
+                return false;
+            }
+            next_continuous_ns = now_ns + THERMAL_HOT_CAPTURE_MS * 1000000ull;
+            return true;
+        }
+        ButtonPress press;
+        if (!presses.pop_wait(press, timeout_ms)) return false;
+        trigger_ns = press.timestamp_ns;
+        return true;
+    }, [&] { presses.close(); });
+
+    pipeline.set_stage(STAGE_CAPTURE, [&](FrameSlot &slot) {
+        // Every blocking wait below is bounded by what is left of this, counted from the press
+        uint64_t now_ns = telemetry_now_ns();
+        slot.deadline = Deadline::after_ms(deadline_ms);
+        if (slot.trigger_ns && slot.trigger_ns < now_ns)
+            slot.deadline.at -= std::chrono::nanoseconds(now_ns - slot.trigger_ns);
+        if (!slot.snapshot) slot.snapshot = encoder.acquire();
+
+        //std::cerr << "Image capture started\n";
+        CaptureRecord &record = slot.record;
+        record = CaptureRecord();
+        record.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        TelemetryRecord &telemetry = slot.telemetry;
+        telemetry = TelemetryRecord();
+        telemetry.source = TELEMETRY_BUTTON;
+        telemetry.wall_ns = record.timestamp_ns;
+        telemetry.stamp_ns[STAMP_START] = slot.trigger_ns ? slot.trigger_ns : now_ns;
+        telemetry.board = -1;
+        telemetry.digit = -1;
+        telemetry.timeout_stage = -1;
+        if (!camera->capture(slot.image, slot.deadline)) {
+            bool expired = slot.deadline.expired();
+            if (expired) counters.timeout(STAGE_CAPTURE);
+            telemetry.status = expired ? INFER_TIMEOUT : INFER_FAILED;
+            telemetry.timeout_stage = expired ? STAGE_CAPTURE : -1;
+            return false;
+        }
+        telemetry.stamp_ns[STAMP_CAPTURED] = telemetry_now_ns();
+        //std::cerr << "Image capture complete\n";
+        return true;
+    });
+
+    int shed_level = THERMAL_NORMAL;
+    pipeline.set_stage(STAGE_PREPROCESS, [&](FrameSlot &slot) {
+        CaptureRecord &record = slot.record;
+        TelemetryRecord &telemetry = slot.telemetry;
+
+        // Warm: a small dashboard capture. Hot: no debug images or taps at
+        // all, the result is still published.
+        int level = thermal.level();
+        if (level != shed_level) {
+            DebugStageSettings raw = raw_jpeg;
+            if (level >= THERMAL_WARM && (raw.size == 0 || raw.size > THERMAL_WARM_RAW_SIZE))
+                raw.size = THERMAL_WARM_RAW_SIZE;
+            encoder.set_stage(DEBUG_STAGE_RAW, raw);
+            shed_level = level;
+        }
+        PipelineImages *images = nullptr;
+        if (slot.snapshot && level < THERMAL_HOT) {
+            images = &slot.snapshot->images;
+            images->tap_mask = taps.frame_mask(images->tap_plan);
+        } else if (slot.snapshot) {
+            slot.snapshot->images.rotated.clear();
+            slot.snapshot->images.processed.clear();
+            slot.snapshot->images.taps.clear();
+        }
+
+        if (!process_image(slot.image, 1440, 1440, slot.coefficients, &record.bbox, slot.deadline, images)) {
+            bool expired = slot.deadline.expired();
+            if (expired) counters.timeout(STAGE_PREPROCESS);
+            telemetry.status = expired ? INFER_TIMEOUT : INFER_FAILED;
+            telemetry.timeout_stage = expired ? STAGE_PREPROCESS : -1;
+            return false;
+        }
+        telemetry.stamp_ns[STAMP_PREPROCESSED] = telemetry_now_ns();
+        telemetry.bbox[0] = record.bbox.min_x;
+        telemetry.bbox[1] = record.bbox.max_x;
+        telemetry.bbox[2] = record.bbox.min_y;
+        telemetry.bbox[3] = record.bbox.max_y;
+        return true;
+    });
+
+    pipeline.set_stage(STAGE_LINK, [&](FrameSlot &slot) {
+        const Deadline &deadline = slot.deadline;
+        TelemetryRecord &telemetry = slot.telemetry;
+        std::unique_lock<std::mutex> uart_lock(legacy_uart_mutex, std::defer_lock);
+        if (legacy_link) uart_lock.lock();
+        if (legacy_link && !link_upgraded.load()) {
+            std::vector<int32_t> pca_coefficients_send;
+            pca_coefficients_send.assign(slot.coefficients.size(), 0);
+
+            for (size_t n = 0; n < slot.coefficients.size(); n++){
+                pca_coefficients_send[n] = (slot.coefficients[n] * 10000);
+            }
+
+            uart->flush_input();
+            telemetry.attempts = 1;
+            telemetry.stamp_ns[STAMP_SUBMITTED] = telemetry_now_ns();
+            int32_t softmax_result[10];
+            if (!uart_send_pca_data(*uart, pca_coefficients_send, deadline.remaining_ms(UART_REPLY_TIMEOUT_MS)) ||
+                !uart_receive_int32s(*uart, softmax_result, 10, deadline.remaining_ms(UART_REPLY_TIMEOUT_MS))) {
+                bool expired = deadline.expired();
+                if (expired) counters.timeout(STAGE_LINK);
+                else std::cerr << "No softmax reply from STM\n";
+                telemetry.stamp_ns[STAMP_ANSWERED] = telemetry_now_ns();
+                telemetry.status = expired ? INFER_TIMEOUT : INFER_FAILED;
+                telemetry.timeout_stage = expired ? STAGE_LINK : -1;
+                return false;
             }
-            std::vector<double> softmax_doubles;
-            softmax_doubles.assign(10, 0);
+            slot.softmax.assign(10, 0);
             for (int x = 0; x < 10; x++){
-                std::cout << (float)softmax_result[x]/10000.0 << std::endl;
-                softmax_doubles[x] = softmax_result[x]/10000.0;
+                slot.softmax[x] = softmax_result[x]/10000.0;
+            }
+            telemetry.stamp_ns[STAMP_ANSWERED] = telemetry_now_ns();
+            telemetry.board = 0;
+        } else {
+            // the service retries once on another board and counts timeouts
+            InferenceResult result;
+            bool ok = service->infer(slot.coefficients, deadline, result, &telemetry);
+            slot.softmax = std::move(result.softmax);
+            if (!ok) {
+                if (!deadline.expired()) std::cerr << "No softmax reply from STM\n";
+                return false;
+            }
+        }
+        return true;
+    });
+
+    pipeline.set_stage(STAGE_PUBLISH, [&](FrameSlot &slot) {
+        TelemetryRecord &telemetry = slot.telemetry;
+        if (slot.failed) {
+            if (telemetry_log.running()) {
+                telemetry_set_result(telemetry, slot.coefficients, slot.softmax);
+                telemetry_log.append(telemetry);
             }
-            
-            
-            writeVectorToCSV("./data/softmax_results.csv", softmax_doubles);
-            
-            // Write "1" to the FIFO instead of stdout
-            int fd = open("/tmp/cpp_to_py_fifo", O_WRONLY | O_NONBLOCK);
-            
-            if (fd == -1) {
-                std::cerr << "failed to open FIFO\n";
-            } else {
-                //std::cerr << "❌ Failed to open FIFO for writing\n";
-                write(fd, "1\n", 2);
-                close(fd);
+            return true;
+        }
+        if (slot.softmax.size() != SOFTMAX_SIZE) {
+            std::cerr << "Softmax has " << slot.softmax.size() << " classes, not " << SOFTMAX_SIZE << std::endl;
+            if (telemetry_log.running()) {
+                telemetry.status = INFER_FAILED;
+                telemetry_set_result(telemetry, slot.coefficients, slot.softmax);
+                telemetry_log.append(telemetry);
             }
+            return true;
         }
-        flag_buf = flag;
-        usleep(10000); // 10ms
+
+        for (int x = 0; x < 10; x++){
+            std::cout << (float)slot.softmax[x] << std::endl;
+        }
+
+        CaptureRecord &record = slot.record;
+        record.width = 1440;
+        record.height = 1440;
+        for (int n = 0; n < COMPONENTS && n < (int)slot.coefficients.size(); n++) {
+            record.coefficients[n] = slot.coefficients[n];
+        }
+        for (int n = 0; n < RECORDER_SOFTMAX_SIZE; n++) {
+            record.softmax[n] = slot.softmax[n];
+        }
+        recorder.submit(record, slot.image.data(), slot.image.size());
+
+        if (slot.snapshot) {
+            ResultRecord &result = slot.snapshot->result;
+            result = ResultRecord();
+            result.capture_ns = record.timestamp_ns;
+            result.width = record.width;
+            result.height = record.height;
+            result.bbox[0] = record.bbox.min_x;
+            result.bbox[1] = record.bbox.max_x;
+            result.bbox[2] = record.bbox.min_y;
+            result.bbox[3] = record.bbox.max_y;
+            for (int n = 0; n < RESULT_RING_COEFFICIENTS; n++) result.coefficients[n] = record.coefficients[n];
+            for (int n = 0; n < RESULT_RING_SOFTMAX; n++) result.softmax[n] = record.softmax[n];
+            encoder.submit(slot.snapshot);
+            slot.snapshot = nullptr;
+        }
+
+        bool expired = slot.deadline.expired();
+        if (expired) counters.timeout(STAGE_PUBLISH);
+        else counters.completed.fetch_add(1, std::memory_order_relaxed);
+
+        if (telemetry_log.running()) {
+            telemetry.stamp_ns[STAMP_PUBLISHED] = telemetry_now_ns();
+            telemetry.status = expired ? INFER_TIMEOUT : INFER_OK;
+            telemetry.timeout_stage = expired ? STAGE_PUBLISH : -1;
+            telemetry_set_result(telemetry, slot.coefficients, slot.softmax);
+            telemetry_log.append(telemetry);
+        }
+        return true;
+    });
+
+    if (!pipeline.start()) exit(1);
+    if (realtime_enabled) realtime_apply_threads(realtime);
+
+    // Ready only now that a press goes straight through a warm capture path:
+    // systemd (Type=notify) and --ready-file get the startup breakdown
+    std::ostringstream breakdown;
+    startup.report(breakdown);
+    breakdown << "ready " << std::fixed << std::setprecision(2) << startup_uptime_s() << " s after boot\n";
+    std::cerr << breakdown.str();
+    startup_notify("READY=1\nSTATUS=ready in " + std::to_string((int)startup.total_ms()) + " ms");
+    if (!ready_file.empty()) startup_write_ready_file(ready_file, breakdown.str());
+
+    uint64_t reported = 0;
+    reactor.add_timer(COUNTERS_REPORT_S * 1000, [&] {
+        if (counters.total() == reported) return;
+        reported = counters.total();
+        counters.report(std::cerr);
+    });
+    if (continuous) {
+        reactor.add_timer(PIPELINE_REPORT_S * 1000, [&] {
+            pipeline.report(std::cerr);
+            counters.report(std::cerr);
+            ThermalSample t = thermal.last();
+            std::cerr << "thermal " << thermal_level_name(t.level) << ": " << t.temp_mc / 1000.0 << " C, "
+                      << t.freq_khz / 1000 << " MHz, flags 0x" << std::hex << t.throttled << std::dec << std::endl;
+        });
+    }
+    while (true) {
+        pause();
     }
 
     return 0;
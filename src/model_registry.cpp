@@ -0,0 +1,218 @@
+#include "model_registry.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <set>
+#include <cstdlib>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+using Clock = std::chrono::steady_clock;
+
+// Parse exactly count comma-separated numbers from line
+static bool parse_row(const std::string &line, int count, double *out) {
+    std::stringstream lineStream(line);
+    std::string cell;
+    for (int j = 0; j < count; j++) {
+        if (!getline(lineStream, cell, ','))
+            return false;
+        // plain numbers only: no nan or inf (which -ffast-math could not check for afterwards)
+        if (cell.find_first_not_of("0123456789+-.eE \r") != std::string::npos)
+            return false;
+        char *end;
+        out[j] = strtod(cell.c_str(), &end);
+        if (end == cell.c_str())
+            return false;
+    }
+    return !getline(lineStream, cell, ',') || cell.find_first_not_of(" \r") == std::string::npos;
+}
+
+std::shared_ptr<Model> load_pca_model(const std::string &components_path, const std::string &mean_path,
+                                      int components, int features) {
+    auto model = std::make_shared<PcaModel>();
+    model->components = components;
+    model->features = features;
+    model->basis.resize((size_t)components * features);
+    model->mean.resize(features);
+
+    std::ifstream basis(components_path);
+    if (!basis.is_open()) {
+        std::cerr << "Error: Unable to open file " << components_path << std::endl;
+        return nullptr;
+    }
+    std::string line;
+    for (int i = 0; i < components; i++) {
+        if (!getline(basis, line) || !parse_row(line, features, &model->basis[(size_t)i * features])) {
+            std::cerr << "Error: " << components_path << " row " << i + 1 << " is not " << features << " numbers\n";
+            return nullptr;
+        }
+    }
+    while (getline(basis, line)) {
+        if (line.find_first_not_of(" \r") != std::string::npos) {
+            std::cerr << "Error: " << components_path << " has more than " << components << " rows\n";
+            return nullptr;
+        }
+    }
+
+    std::ifstream mean(mean_path);
+    if (!mean.is_open()) {
+        std::cerr << "Error: Unable to open file " << mean_path << std::endl;
+        return nullptr;
+    }
+    for (int j = 0; j < features; j++) {
+        if (!getline(mean, line) || !parse_row(line, 1, &model->mean[j])) {
+            std::cerr << "Error: " << mean_path << " line " << j + 1 << " is not a number\n";
+            return nullptr;
+        }
+    }
+    return model;
+}
+
+ModelRegistry::~ModelRegistry() {
+    unwatch();
+}
+
+void ModelRegistry::add(const std::string &name, const std::vector<std::string> &files, ModelLoader loader) {
+    auto entry = std::make_unique<Entry>();
+    entry->name = name;
+    entry->loader = std::move(loader);
+    for (const std::string &path : files) {
+        size_t slash = path.rfind('/');
+        if (slash == std::string::npos)
+            entry->files.emplace_back(".", path);
+        else
+            entry->files.emplace_back(path.substr(0, slash), path.substr(slash + 1));
+    }
+    entries_[name] = std::move(entry);
+}
+
+bool ModelRegistry::load(const std::string &name) {
+    auto it = entries_.find(name);
+    if (it == entries_.end()) {
+        std::cerr << "No model named " << name << "\n";
+        return false;
+    }
+    Entry &entry = *it->second;
+
+    std::lock_guard<std::mutex> lock(load_mutex_);
+    std::shared_ptr<Model> model = entry.loader();
+    if (!model) {
+        if (entry.version)
+            std::cerr << "Model " << name << ": new version failed to load, keeping v" << entry.version << "\n";
+        return false;
+    }
+    model->name = name;
+    model->version = ++entry.version;
+    // readers holding the previous version finish with it; it goes with the last of them
+    std::atomic_store(&entry.current, std::shared_ptr<const Model>(std::move(model)));
+    if (entry.version > 1)
+        std::cerr << "Model " << name << ": v" << entry.version << " loaded\n";
+    return true;
+}
+
+std::shared_ptr<const Model> ModelRegistry::get(const std::string &name) const {
+    auto it = entries_.find(name);
+    if (it == entries_.end())
+        return nullptr;
+    return std::atomic_load(&it->second->current);
+}
+
+bool ModelRegistry::watch() {
+    if (thread_.joinable())
+        return true;
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stop_fd_ = eventfd(0, EFD_CLOEXEC);
+    if (inotify_fd_ < 0 || stop_fd_ < 0) {
+        std::cerr << "Model registry: cannot watch for updates\n";
+        unwatch();
+        return false;
+    }
+
+    // a directory watch also sees files replaced by rename, which a file watch would lose
+    std::set<std::string> dirs;
+    for (auto &it : entries_) {
+        for (auto &file : it.second->files)
+            dirs.insert(file.first);
+    }
+    for (const std::string &dir : dirs) {
+        int wd = inotify_add_watch(inotify_fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+        if (wd < 0) {
+            std::cerr << "Model registry: cannot watch " << dir << "\n";
+            continue;
+        }
+        watched_[wd] = dir;
+    }
+    thread_ = std::thread(&ModelRegistry::run, this);
+    return true;
+}
+
+void ModelRegistry::unwatch() {
+    if (thread_.joinable()) {
+        uint64_t one = 1;
+        if (write(stop_fd_, &one, sizeof(one)) < 0)
+            std::cerr << "Model registry: failed to signal stop\n";
+        thread_.join();
+    }
+    if (inotify_fd_ >= 0) close(inotify_fd_);
+    if (stop_fd_ >= 0) close(stop_fd_);
+    inotify_fd_ = -1;
+    stop_fd_ = -1;
+    watched_.clear();
+}
+
+void ModelRegistry::run() {
+    pthread_setname_np(pthread_self(), "ann-models");
+
+    std::set<std::string> pending;
+    Clock::time_point due;
+    alignas(struct inotify_event) char buffer[4096];
+    while (true) {
+        int timeout = -1;
+        if (!pending.empty()) {
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(due - Clock::now()).count();
+            timeout = left > 0 ? (int)left : 0;
+        }
+        struct pollfd fds[2] = { { stop_fd_, POLLIN, 0 }, { inotify_fd_, POLLIN, 0 } };
+        if (poll(fds, 2, timeout) < 0)
+            continue;
+        if (fds[0].revents)
+            break;
+
+        if (fds[1].revents & POLLIN) {
+            ssize_t n;
+            while ((n = read(inotify_fd_, buffer, sizeof(buffer))) > 0) {
+                for (char *p = buffer; p < buffer + n;) {
+                    const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(p);
+                    p += sizeof(struct inotify_event) + event->len;
+                    auto dir = watched_.find(event->wd);
+                    if (!event->len || dir == watched_.end())
+                        continue;
+                    for (auto &it : entries_) {
+                        for (auto &file : it.second->files) {
+                            if (file.first != dir->second || file.second != event->name)
+                                continue;
+                            pending.insert(it.first);
+                            due = Clock::now() + std::chrono::milliseconds(MODEL_RELOAD_SETTLE_MS);
+                        }
+                    }
+                }
+            }
+        }
+
+        if (!pending.empty() && Clock::now() >= due) {
+            for (const std::string &name : pending)
+                load(name);
+            pending.clear();
+        }
+    }
+}
+
+ModelRegistry &model_registry() {
+    static ModelRegistry registry;
+    return registry;
+}
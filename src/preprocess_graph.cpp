@@ -0,0 +1,518 @@
+#include "preprocess_graph.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+
+// What the daemon ran before the stages came from a file
+static const char *PREPROCESS_DEFAULT =
+    "rotate\n"
+    "vignette,gain=2.5,gamma=3.5\n"
+    "threshold,level=130\n"
+    "digit_crop,level=130\n"
+    "downsample,size=24\n"
+    "invert\n"
+    "pad,border=2\n"
+    "blur\n"
+    "lighten,above=2,factor=3.5\n"
+    "fit,size=24\n";
+
+static uint8_t threshold_point(uint8_t v, const double *p) {
+    return v < p[0] ? 0 : 255;
+}
+
+static uint8_t invert_point(uint8_t v, const double *) {
+    return 255 - v;
+}
+
+static uint8_t darken_point(uint8_t v, const double *p) {
+    return v < p[0] ? static_cast<uint8_t>(v * (float)p[1]) : v;
+}
+
+static uint8_t lighten_point(uint8_t v, const double *p) {
+    return v > p[0] ? static_cast<uint8_t>(std::min(255.0f, v * (float)p[1])) : v;
+}
+
+// Brighter towards the corners, to even out the ring light
+static float vignette_gain(int x, int y, int width, int height, const double *p) {
+    int cx = width / 2;
+    int cy = height / 2;
+    float max_dist_sq = static_cast<float>(cx * cx + cy * cy);
+    if (max_dist_sq == 0) return 1.0f;
+    int dx = x - cx;
+    int dy = y - cy;
+    float normalized = static_cast<float>(dx * dx + dy * dy) / max_dist_sq;
+    float edge_boost = std::pow(normalized, p[1]);
+    return 1.0f + static_cast<float>(p[0]) * edge_boost;
+}
+
+static void same_shape(int width, int height, const double *, int &out_width, int &out_height) {
+    out_width = width;
+    out_height = height;
+}
+
+static void crop_shape(int width, int height, const double *p, int &out_width, int &out_height) {
+    out_width = std::min(width, (int)p[0]);
+    out_height = std::min(height, (int)p[1]);
+}
+
+static void crop_run(const std::vector<uint8_t> &in, int width, int height, const double *p,
+                     std::vector<uint8_t> &out, int &out_width, int &out_height, BoundingBox *) {
+    crop_shape(width, height, p, out_width, out_height);
+    crop(in, width, height, out_width, out_height, out);
+}
+
+static void digit_crop_shape(int width, int height, const double *, int &out_width, int &out_height) {
+    out_width = out_height = std::max(width, height);
+}
+
+static void digit_crop_run(const std::vector<uint8_t> &in, int width, int height, const double *p,
+                           std::vector<uint8_t> &out, int &out_width, int &out_height, BoundingBox *bbox) {
+    int size;
+    crop_to_square(in, width, height, out, size, (uint8_t)p[0], bbox);
+    if (size < 1) {
+        // nothing dark enough: a blank page
+        size = 1;
+        out.assign(1, 255);
+    }
+    out_width = out_height = size;
+}
+
+static void square_shape(int, int, const double *p, int &out_width, int &out_height) {
+    out_width = out_height = (int)p[0];
+}
+
+static void downsample_run(const std::vector<uint8_t> &in, int width, int height, const double *p,
+                           std::vector<uint8_t> &out, int &out_width, int &out_height, BoundingBox *) {
+    out_width = out_height = (int)p[0];
+    downsampleInterArea(in, width, height, out_width, out_height, out);
+}
+
+static void pad_shape(int width, int height, const double *p, int &out_width, int &out_height) {
+    out_width = width + 2 * (int)p[0];
+    out_height = height + 2 * (int)p[0];
+}
+
+static void pad_run(const std::vector<uint8_t> &in, int width, int height, const double *p,
+                    std::vector<uint8_t> &out, int &out_width, int &out_height, BoundingBox *) {
+    int border = (int)p[0];
+    pad_shape(width, height, p, out_width, out_height);
+    out.assign((size_t)out_width * out_height, (uint8_t)p[1]);
+    for (int y = 0; y < height; y++)
+        memcpy(&out[(size_t)(y + border) * out_width + border], &in[(size_t)y * width], width);
+}
+
+static void blur_run(const std::vector<uint8_t> &in, int width, int height, const double *,
+                     std::vector<uint8_t> &out, int &out_width, int &out_height, BoundingBox *) {
+    out_width = width;
+    out_height = height;
+    gaussian_blur(in, width, height, out);
+}
+
+static void fit_run(const std::vector<uint8_t> &in, int width, int height, const double *p,
+                    std::vector<uint8_t> &out, int &out_width, int &out_height, BoundingBox *) {
+    out_width = out_height = (int)p[0];
+    find_digit_cubic(in, width, height, out, out_width, out_height);
+}
+
+static const StageDef STAGES[] = {
+    { "rotate", STAGE_REVERSE, { { nullptr, 0, 0, 0 } }, nullptr, nullptr, nullptr, nullptr },
+    { "threshold", STAGE_POINT, { { "level", BLACK_THRESHOLD, 0, 256 }, { nullptr, 0, 0, 0 } },
+      threshold_point, nullptr, nullptr, nullptr },
+    { "invert", STAGE_POINT, { { nullptr, 0, 0, 0 } }, invert_point, nullptr, nullptr, nullptr },
+    { "darken", STAGE_POINT, { { "below", WHITE_THRESHOLD, 0, 256 }, { "factor", 0.8, 0, 1 }, { nullptr, 0, 0, 0 } },
+      darken_point, nullptr, nullptr, nullptr },
+    { "lighten", STAGE_POINT, { { "above", WHITE_THRESHOLD, 0, 255 }, { "factor", 1.2, 1, 255 }, { nullptr, 0, 0, 0 } },
+      lighten_point, nullptr, nullptr, nullptr },
+    { "vignette", STAGE_GAIN, { { "gain", 1.2, 0, 255 }, { "gamma", 8.0, 0, 100 }, { nullptr, 0, 0, 0 } },
+      nullptr, vignette_gain, nullptr, nullptr },
+    { "crop", STAGE_IMAGE, { { "width", 1000, 1, 65535 }, { "height", 1000, 1, 65535 }, { nullptr, 0, 0, 0 } },
+      nullptr, nullptr, crop_shape, crop_run },
+    { "digit_crop", STAGE_IMAGE, { { "level", BLACK_THRESHOLD, 0, 255 }, { nullptr, 0, 0, 0 } },
+      nullptr, nullptr, digit_crop_shape, digit_crop_run },
+    { "downsample", STAGE_IMAGE, { { "size", DOWNSAMPLE_SIZE, 1, 4096 }, { nullptr, 0, 0, 0 } },
+      nullptr, nullptr, square_shape, downsample_run },
+    { "pad", STAGE_IMAGE, { { "border", 2, 0, 1024 }, { "value", 0, 0, 255 }, { nullptr, 0, 0, 0 } },
+      nullptr, nullptr, pad_shape, pad_run },
+    { "blur", STAGE_IMAGE, { { nullptr, 0, 0, 0 } }, nullptr, nullptr, same_shape, blur_run },
+    { "fit", STAGE_IMAGE, { { "size", DOWNSAMPLE_SIZE, 1, 4096 }, { nullptr, 0, 0, 0 } },
+      nullptr, nullptr, square_shape, fit_run },
+};
+
+const StageDef *find_stage(const std::string &name) {
+    for (const StageDef &def : STAGES) {
+        if (name == def.name) return &def;
+    }
+    return nullptr;
+}
+
+static std::string trim(const std::string &s) {
+    size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) return "";
+    return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+}
+
+// "name=value" against the stage's parameter list
+static bool parse_param(const std::string &cell, PlannedStage &stage, std::string &error) {
+    size_t eq = cell.find('=');
+    std::string name = trim(cell.substr(0, eq));
+    std::string value = eq == std::string::npos ? "" : trim(cell.substr(eq + 1));
+    int index = -1;
+    for (int i = 0; stage.def->params[i].name; i++) {
+        if (name == stage.def->params[i].name) index = i;
+    }
+    if (index < 0) {
+        error = std::string(stage.def->name) + " has no parameter " + name;
+        return false;
+    }
+    const StageParam &param = stage.def->params[index];
+    char *end;
+    double v = strtod(value.c_str(), &end);
+    // plain numbers only (-ffast-math could not catch a nan afterwards)
+    if (value.empty() || value.find_first_not_of("0123456789+-.eE") != std::string::npos || *end) {
+        error = name + " is not a number";
+        return false;
+    }
+    if (v < param.min || v > param.max) {
+        std::ostringstream range;
+        range << name << " must be " << param.min << " to " << param.max;
+        error = range.str();
+        return false;
+    }
+    stage.params[index] = v;
+    return true;
+}
+
+bool plan_preprocess(const std::string &text, const std::string &source, bool fuse, PreprocessPlan &plan) {
+    plan.stages.clear();
+    plan.passes.clear();
+    plan.raw_stage = -1;
+    plan.taps.clear();
+
+    std::istringstream lines(text);
+    std::string line;
+    int number = 0;
+    while (getline(lines, line)) {
+        number++;
+        line = trim(line);
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::stringstream lineStream(line);
+        std::string cell;
+        getline(lineStream, cell, ',');
+        PlannedStage stage;
+        stage.def = find_stage(trim(cell));
+        if (!stage.def) {
+            std::cerr << "Preprocess: " << source << " line " << number << ": no stage " << trim(cell) << "\n";
+            return false;
+        }
+        for (int i = 0; i < PREPROCESS_MAX_PARAMS; i++)
+            stage.params[i] = stage.def->params[i].name ? stage.def->params[i].value : 0;
+        std::string error;
+        while (getline(lineStream, cell, ',')) {
+            if (!parse_param(cell, stage, error)) {
+                std::cerr << "Preprocess: " << source << " line " << number << ": " << error << "\n";
+                return false;
+            }
+        }
+        plan.stages.push_back(stage);
+    }
+    if (plan.stages.empty()) {
+        std::cerr << "Preprocess: " << source << " has no stages\n";
+        return false;
+    }
+    if (plan.stages.size() > PREPROCESS_MAX_STAGES) {
+        std::cerr << "Preprocess: " << source << " has more than " << PREPROCESS_MAX_STAGES << " stages\n";
+        return false;
+    }
+    for (const PlannedStage &stage : plan.stages) {
+        int seen = 0;
+        for (const PlannedStage &before : plan.stages) {
+            if (&before == &stage) break;
+            seen += before.def == stage.def;
+        }
+        plan.taps.push_back(seen ? std::string(stage.def->name) + "." + std::to_string(seen + 1) : stage.def->name);
+    }
+
+    // the stages must end at the PCA input for a full-size capture
+    int width = PREPROCESS_CHECK_SIZE, height = PREPROCESS_CHECK_SIZE;
+    for (const PlannedStage &stage : plan.stages) {
+        if (stage.def->kind == STAGE_IMAGE)
+            stage.def->shape(width, height, stage.params, width, height);
+    }
+    if (width * height != FEATURES) {
+        std::cerr << "Preprocess: " << source << " ends at " << width << "x" << height
+                  << ", not the " << FEATURES << " pixels the PCA takes\n";
+        return false;
+    }
+
+    int run = -1;   // the fused pass still open, if any
+    width = height = PREPROCESS_CHECK_SIZE;
+    for (int i = 0; i < (int)plan.stages.size(); i++) {
+        const PlannedStage &stage = plan.stages[i];
+        const StageDef *def = stage.def;
+        if (def->kind == STAGE_REVERSE && plan.raw_stage < 0)
+            plan.raw_stage = i;
+
+        if (def->kind == STAGE_IMAGE) {
+            def->shape(width, height, stage.params, width, height);
+            PreprocessPass pass;
+            pass.first = pass.last = i;
+            pass.image = def;
+            plan.passes.push_back(pass);
+            run = -1;
+            continue;
+        }
+        // rotate can only start a run: the stages before it read in the other order
+        if (run < 0 || !fuse || def->kind == STAGE_REVERSE) {
+            plan.passes.emplace_back();
+            plan.passes.back().first = i;
+            run = plan.passes.size() - 1;
+        }
+        PreprocessPass &pass = plan.passes[run];
+        pass.last = i;
+
+        if (def->kind == STAGE_REVERSE) {
+            pass.reverse = true;
+        } else if (def->kind == STAGE_POINT && !pass.ops.empty() && !pass.ops.back().gain) {
+            // compose with the table before
+            FusedOp &op = pass.ops.back();
+            op.prefix.insert(op.prefix.end(), op.table, op.table + 256);
+            for (int v = 0; v < 256; v++)
+                op.table[v] = def->point(op.table[v], stage.params);
+            op.stage = i;
+        } else {
+            FusedOp op;
+            op.first = op.stage = i;
+            op.gain = def->kind == STAGE_GAIN ? def : nullptr;
+            for (int v = 0; v < 256; v++)
+                op.table[v] = op.gain ? v : def->point(v, stage.params);
+            if (op.gain) {
+                op.width = width;
+                op.height = height;
+                op.factors.resize((size_t)width * height);
+                for (int y = 0; y < height; y++) {
+                    for (int x = 0; x < width; x++)
+                        op.factors[(size_t)y * width + x] = def->gain(x, y, width, height, stage.params);
+                }
+            }
+            pass.ops.push_back(std::move(op));
+        }
+    }
+    return true;
+}
+
+int PreprocessPlan::find_tap(const std::string &name) const {
+    for (size_t i = 0; i < taps.size(); i++) {
+        if (taps[i] == name) return i;
+    }
+    return -1;
+}
+
+std::string PreprocessPlan::describe() const {
+    std::string text;
+    for (const PreprocessPass &pass : passes) {
+        if (!text.empty()) text += " > ";
+        for (int i = pass.first; i <= pass.last; i++) {
+            if (i > pass.first) text += "+";
+            text += stages[i].def->name;
+        }
+    }
+    return text;
+}
+
+std::shared_ptr<Model> load_preprocess_plan(const std::string &path, bool fuse) {
+    std::string text = PREPROCESS_DEFAULT;
+    std::string source = "the default stages";
+    std::ifstream file(path);
+    if (file.is_open()) {
+        std::stringstream contents;
+        contents << file.rdbuf();
+        text = contents.str();
+        source = path;
+    }
+
+    auto plan = std::make_shared<PreprocessPlan>();
+    if (!plan_preprocess(text, source, fuse, *plan))
+        return nullptr;
+    std::cerr << "Preprocess: " << plan->stages.size() << " stages in " << plan->passes.size()
+              << " passes from " << source << ": " << plan->describe() << "\n";
+    return plan;
+}
+
+void PreprocessWorkspace::size_for(const std::shared_ptr<const PreprocessPlan> &plan, int width, int height) {
+    if (plan == plan_ && width == width_ && height == height_)
+        return;
+    plan_ = plan;
+    width_ = width;
+    height_ = height;
+
+    // the largest output of any pass, and every gain map the sizes are known for
+    size_t largest = 0;
+    size_t gain_slot = 0;
+    for (const PreprocessPass &pass : plan->passes) {
+        const double *params = plan->stages[pass.first].params;
+        if (pass.image) {
+            pass.image->shape(width, height, params, width, height);
+        } else {
+            for (const FusedOp &op : pass.ops) {
+                if (!op.gain) continue;
+                if (gains_.size() <= gain_slot) gains_.emplace_back();
+                gain_map(gain_slot++, op, plan->stages[op.stage].params, width, height);
+            }
+        }
+        largest = std::max(largest, (size_t)width * height);
+    }
+    gains_.resize(gain_slot);
+    for (std::vector<uint8_t> &buffer : buffers_)
+        buffer.reserve(largest);
+}
+
+const float *PreprocessWorkspace::gain_map(size_t slot, const FusedOp &op, const double *params,
+                                           int width, int height) {
+    if (op.width == width && op.height == height)
+        return op.factors.data();
+    Gain &g = gains_[slot];
+    if (g.width != width || g.height != height) {
+        g.width = width;
+        g.height = height;
+        g.factors.resize((size_t)width * height);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++)
+                g.factors[(size_t)y * width + x] = op.gain->gain(x, y, width, height, params);
+        }
+    }
+    return g.factors.data();
+}
+
+void PreprocessWorkspace::run_fused(const PreprocessPlan &plan, const PreprocessPass &pass, size_t &gain_slot,
+                                    const uint8_t *in, int width, int height, uint8_t *out, uint64_t copy) {
+    size_t n = (size_t)width * height;
+    factors_.resize(pass.ops.size());
+    for (size_t k = 0; k < pass.ops.size(); k++) {
+        const FusedOp &op = pass.ops[k];
+        factors_[k] = op.gain ? gain_map(gain_slot++, op, plan.stages[op.stage].params, width, height) : nullptr;
+    }
+    for (int s = pass.first; copy && s <= pass.last; s++) {
+        if (copy & (1ull << s)) copies_[s]->resize(n);
+    }
+
+    // every stage of the run over one tile while it is in cache, then the next tile
+    for (size_t base = 0; base < n; base += PREPROCESS_TILE) {
+        size_t len = std::min<size_t>(PREPROCESS_TILE, n - base);
+        uint8_t *tile = out + base;
+        const uint8_t *src = in + base;
+        if (pass.reverse) {
+            const uint8_t *from = in + (n - 1 - base);
+            for (size_t i = 0; i < len; i++)
+                tile[i] = *(from - i);
+            src = tile;
+            if (copy & (1ull << pass.first))
+                memcpy(copies_[pass.first]->data() + base, tile, len);
+        }
+        for (size_t k = 0; k < pass.ops.size(); k++) {
+            const FusedOp &op = pass.ops[k];
+            // stages folded into the table before its last one
+            for (int s = op.first; copy && s < op.stage; s++) {
+                if (!(copy & (1ull << s))) continue;
+                const uint8_t *table = &op.prefix[(size_t)(s - op.first) * 256];
+                uint8_t *to = copies_[s]->data() + base;
+                for (size_t i = 0; i < len; i++)
+                    to[i] = table[src[i]];
+            }
+            if (op.gain) {
+                const float *g = factors_[k] + base;
+                for (size_t i = 0; i < len; i++)
+                    tile[i] = static_cast<uint8_t>(std::min(255.0f, src[i] * g[i]));
+            } else {
+                const uint8_t *table = op.table;
+                for (size_t i = 0; i < len; i++)
+                    tile[i] = table[src[i]];
+            }
+            src = tile;
+            if (copy & (1ull << op.stage))
+                memcpy(copies_[op.stage]->data() + base, tile, len);
+        }
+        if (src != tile)
+            memcpy(tile, src, len);
+    }
+}
+
+bool PreprocessWorkspace::run(const std::shared_ptr<const PreprocessPlan> &plan, const std::vector<uint8_t> &image,
+                              int width, int height, std::vector<uint8_t> &out, BoundingBox *bbox,
+                              const Deadline &deadline, PipelineImages *images) {
+    size_for(plan, width, height);
+
+    // stage outputs to copy this frame: none unless asked for, so the passes
+    // below test a zero mask
+    uint64_t copy = 0;
+    uint64_t taps = 0;
+    if (images) {
+        if (plan->raw_stage < 0)
+            images->rotated = image;
+        else {
+            copy |= 1ull << plan->raw_stage;
+            copies_[plan->raw_stage] = &images->rotated;
+        }
+        // a mask chosen for another version of the plan names other stages
+        if (images->tap_plan == plan->version)
+            taps = images->tap_mask & (plan->stages.size() < 64 ? (1ull << plan->stages.size()) - 1 : ~0ull);
+        images->taps.resize(__builtin_popcountll(taps));
+        size_t k = 0;
+        for (int s = 0; taps >> s; s++) {
+            if (!(taps & (1ull << s))) continue;
+            TapImage &tap = images->taps[k++];
+            tap.stage = s;
+            tap.name = plan->taps[s];
+            if (!(copy & (1ull << s))) copies_[s] = &tap.pixels;
+            copy |= 1ull << s;
+        }
+    }
+
+    const std::vector<uint8_t> *in = &image;
+    size_t gain_slot = 0;
+    int next = 0;
+    for (const PreprocessPass &pass : plan->passes) {
+        std::vector<uint8_t> &dst = buffers_[next];
+        int out_width = width, out_height = height;
+        if (pass.image) {
+            pass.image->run(*in, width, height, plan->stages[pass.first].params, dst, out_width, out_height, bbox);
+            if (copy & (1ull << pass.first))
+                *copies_[pass.first] = dst;
+        } else {
+            dst.resize((size_t)width * height);
+            run_fused(*plan, pass, gain_slot, in->data(), width, height, dst.data(), copy);
+        }
+        for (size_t k = 0; taps && k < images->taps.size(); k++) {
+            TapImage &tap = images->taps[k];
+            if (tap.stage < pass.first || tap.stage > pass.last) continue;
+            tap.width = out_width;
+            tap.height = out_height;
+        }
+        in = &dst;
+        width = out_width;
+        height = out_height;
+        next ^= 1;
+        if (deadline.expired()) return false;
+    }
+
+    if ((size_t)width * height != FEATURES) {
+        std::cerr << "Preprocess: output is " << width << "x" << height << ", not " << FEATURES << " pixels\n";
+        return false;
+    }
+    out.assign(in->begin(), in->end());
+    if (images) {
+        images->processed = out;
+        // the raw stage went to images->rotated only
+        for (TapImage &tap : images->taps) {
+            if (tap.stage == plan->raw_stage) tap.pixels = images->rotated;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,213 @@
+#include "reactor.h"
+
+#include <iostream>
+#include <cerrno>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <condition_variable>
+
+#define REACTOR_MAX_EVENTS 64
+
+Reactor::~Reactor() {
+    stop();
+}
+
+bool Reactor::start(const char *thread_name) {
+    if (running_)
+        return true;
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    post_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || post_fd_ < 0) {
+        std::cerr << "Reactor: failed to create epoll/eventfd\n";
+        stop();
+        return false;
+    }
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, post_fd_, &ev);
+
+    running_ = true;
+    thread_ = std::thread([this, thread_name] {
+        pthread_setname_np(pthread_self(), thread_name);
+        run();
+    });
+    return true;
+}
+
+void Reactor::stop() {
+    if (thread_.joinable()) {
+        running_ = false;
+        post([] {});
+        thread_.join();
+    }
+    running_ = false;
+    // whatever was posted after the loop ended still runs, so nobody waits forever in call()
+    run_posted();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    by_fd_.clear();
+    by_id_.clear();
+    if (epoll_fd_ >= 0) close(epoll_fd_);
+    if (post_fd_ >= 0) close(post_fd_);
+    epoll_fd_ = post_fd_ = -1;
+}
+
+bool Reactor::add(int fd, uint32_t events, ReactorHandler handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto watch = std::make_shared<Watch>();
+    watch->fd = fd;
+    watch->id = next_id_++;
+    watch->handler = std::move(handler);
+
+    struct epoll_event ev = {};
+    ev.events = events;
+    ev.data.u64 = watch->id;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        std::cerr << "Reactor: cannot watch fd " << fd << "\n";
+        return false;
+    }
+    by_fd_[fd] = watch;
+    by_id_[watch->id] = watch;
+    return true;
+}
+
+bool Reactor::modify(int fd, uint32_t events) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = by_fd_.find(fd);
+    if (it == by_fd_.end())
+        return false;
+    struct epoll_event ev = {};
+    ev.events = events;
+    ev.data.u64 = it->second->id;
+    return epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void Reactor::remove(int fd) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = by_fd_.find(fd);
+    if (it == by_fd_.end())
+        return;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    // events already returned for it are dropped because the id is gone
+    by_id_.erase(it->second->id);
+    by_fd_.erase(it);
+}
+
+void Reactor::post(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        posted_.push_back(std::move(fn));
+    }
+    uint64_t one = 1;
+    if (post_fd_ >= 0 && write(post_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        std::cerr << "Reactor: failed to wake loop\n";
+}
+
+void Reactor::call(std::function<void()> fn) {
+    if (!running_ || in_loop()) {
+        fn();
+        return;
+    }
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    bool done = false;
+    post([&] {
+        fn();
+        std::lock_guard<std::mutex> lock(done_mutex);
+        done = true;
+        done_cv.notify_one();
+    });
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done_cv.wait(lock, [&] { return done; });
+}
+
+int Reactor::add_timer(int interval_ms, std::function<void()> fn, bool repeat) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Reactor: failed to create timer\n";
+        return -1;
+    }
+    struct itimerspec spec = {};
+    spec.it_value.tv_sec = interval_ms / 1000;
+    spec.it_value.tv_nsec = (interval_ms % 1000) * 1000000L;
+    if (repeat) spec.it_interval = spec.it_value;
+    timerfd_settime(fd, 0, &spec, nullptr);
+
+    bool added = add(fd, EPOLLIN, [fd, fn](uint32_t) {
+        uint64_t expirations;
+        if (read(fd, &expirations, sizeof(expirations)) > 0)
+            fn();
+    });
+    if (!added) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void Reactor::cancel_timer(int id) {
+    if (id < 0)
+        return;
+    remove(id);
+    close(id);
+}
+
+void Reactor::run_posted() {
+    std::vector<std::function<void()>> posted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        posted.swap(posted_);
+    }
+    for (auto &fn : posted)
+        fn();
+}
+
+void Reactor::run() {
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    std::vector<std::pair<std::shared_ptr<Watch>, uint32_t>> ready;
+
+    while (running_) {
+        int n = epoll_wait(epoll_fd_, events, REACTOR_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Reactor: epoll_wait failed\n";
+            break;
+        }
+
+        // look the handlers up first so one that removes another is safe
+        bool posted = false;
+        ready.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int i = 0; i < n; i++) {
+                if (events[i].data.u64 == 0) {
+                    posted = true;
+                    continue;
+                }
+                auto it = by_id_.find(events[i].data.u64);
+                if (it != by_id_.end())
+                    ready.emplace_back(it->second, (uint32_t)events[i].events);
+            }
+        }
+
+        for (auto &entry : ready) {
+            // skip handlers removed by an earlier one in this batch
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!by_id_.count(entry.first->id)) continue;
+            }
+            entry.first->handler(entry.second);
+        }
+
+        if (posted) {
+            uint64_t count;
+            if (read(post_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN)
+                std::cerr << "Reactor: failed to read wake count\n";
+            run_posted();
+        }
+    }
+}
@@ -0,0 +1,286 @@
+#include "realtime.h"
+#include "telemetry.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <thread>
+#include <algorithm>
+#include <malloc.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+void realtime_default_config(RealtimeConfig &config) {
+    config.threads = {
+        { "ann-dispatch", 90, 3, true },
+        { "ann-capture", 80, 0, false },
+        { "ann-link", 75, 2, false },
+        { "ann-preprocess", 70, 1, false },
+        { "ann-reactor", 65, -1, false },
+        { "ann-publish", 60, 2, false },
+    };
+}
+
+bool load_realtime_config(const std::string &filename, RealtimeConfig &config) {
+    std::ifstream file(filename);
+    if (!file.is_open())
+        return false;
+
+    RealtimeConfig loaded;
+    std::string line;
+    int number = 0;
+    while (getline(file, line)) {
+        number++;
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::stringstream lineStream(line);
+        RealtimeThread t;
+        std::string cell;
+        getline(lineStream, t.name, ',');
+        char comma;
+        lineStream >> t.priority >> comma >> t.cpu;
+        if (lineStream.fail() || t.name.empty() || t.priority < 0 || t.priority > 99) {
+            std::cerr << "Malformed real-time entry on line " << number << " of " << filename << "\n";
+            return false;
+        }
+        if (getline(lineStream, cell, ',') && getline(lineStream, cell))
+            t.exclusive = cell == "exclusive";
+        loaded.threads.push_back(t);
+    }
+    config = loaded;
+    return true;
+}
+
+bool realtime_lock_memory() {
+    // freed heap memory stays mapped (and locked), so reusing it never faults
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, REALTIME_STACK_SIZE);
+    if (pthread_setattr_default_np(&attr) != 0)
+        std::cerr << "Real-time: could not set the default thread stack size\n";
+    pthread_attr_destroy(&attr);
+
+    // MCL_FUTURE also populates every later mapping (thread stacks, buffers) as it is made
+    bool locked = mlockall(MCL_CURRENT | MCL_FUTURE) == 0;
+    if (!locked)
+        std::cerr << "Real-time: mlockall failed (" << strerror(errno) << "), memory is not locked\n";
+    realtime_prefault_stack();
+    return locked;
+}
+
+void realtime_prefault_stack() {
+    volatile unsigned char stack[REALTIME_STACK_PREFAULT];
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < sizeof(stack); i += page)
+        stack[i] = 0;
+}
+
+void realtime_prefault(void *data, size_t bytes) {
+    volatile unsigned char *p = static_cast<volatile unsigned char *>(data);
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < bytes; i += page)
+        p[i] = p[i];
+}
+
+static bool set_policy(pid_t tid, int priority) {
+    struct sched_param param = {};
+    param.sched_priority = priority;
+    return sched_setscheduler(tid, priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param) == 0;
+}
+
+bool realtime_setup_thread(int priority, int cpu) {
+    bool ok = set_policy(0, priority);
+    if (!ok)
+        std::cerr << "Real-time: could not set priority " << priority << " (" << strerror(errno) << ")\n";
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            std::cerr << "Real-time: could not pin to CPU " << cpu << "\n";
+            ok = false;
+        }
+    }
+    realtime_prefault_stack();
+    return ok;
+}
+
+int realtime_apply_threads(const RealtimeConfig &config) {
+    int cpus = std::thread::hardware_concurrency();
+
+    DIR *dir = opendir("/proc/self/task");
+    if (!dir) {
+        std::cerr << "Real-time: cannot list threads\n";
+        return 0;
+    }
+    std::vector<std::pair<pid_t, std::string>> tasks;
+    while (struct dirent *entry = readdir(dir)) {
+        if (entry->d_name[0] == '.')
+            continue;
+        std::ifstream comm(std::string("/proc/self/task/") + entry->d_name + "/comm");
+        std::string name;
+        getline(comm, name);
+        tasks.emplace_back(atoi(entry->d_name), name);
+    }
+    closedir(dir);
+
+    // the config entry of each thread
+    std::vector<const RealtimeThread *> entry_of(tasks.size(), nullptr);
+    std::vector<int> matched(config.threads.size(), 0);
+    for (size_t k = 0; k < tasks.size(); k++) {
+        for (size_t i = 0; i < config.threads.size(); i++) {
+            if (config.threads[i].name == tasks[k].second) {
+                entry_of[k] = &config.threads[i];
+                matched[i]++;
+                break;
+            }
+        }
+    }
+
+    // everything not pinned runs anywhere but on the exclusive CPUs whose
+    // thread exists (no dispatcher with the legacy link, no CPU set aside)
+    cpu_set_t shared;
+    sched_getaffinity(0, sizeof(shared), &shared);
+    for (size_t i = 0; i < config.threads.size(); i++) {
+        const RealtimeThread &t = config.threads[i];
+        if (t.exclusive && matched[i] && t.cpu >= 0 && t.cpu < cpus)
+            CPU_CLR(t.cpu, &shared);
+    }
+
+    int configured = 0;
+    for (size_t k = 0; k < tasks.size(); k++) {
+        pid_t tid = tasks[k].first;
+        const std::string &name = tasks[k].second;
+        const RealtimeThread *t = entry_of[k];
+
+        cpu_set_t set = shared;
+        if (t && t->cpu >= 0 && t->cpu < cpus) {
+            CPU_ZERO(&set);
+            CPU_SET(t->cpu, &set);
+        } else if (t && t->cpu >= cpus) {
+            std::cerr << "Real-time: " << name << " wants CPU " << t->cpu << ", there are " << cpus << "\n";
+        }
+        if (sched_setaffinity(tid, sizeof(set), &set) != 0)
+            std::cerr << "Real-time: could not set the CPUs of " << name << "\n";
+        if (!t)
+            continue;
+
+        if (!set_policy(tid, t->priority)) {
+            std::cerr << "Real-time: could not give " << name << " priority " << t->priority
+                      << " (" << strerror(errno) << ")\n";
+            continue;
+        }
+        configured++;
+    }
+
+    for (size_t i = 0; i < config.threads.size(); i++) {
+        const RealtimeThread &t = config.threads[i];
+        if (!matched[i])
+            std::cerr << "Real-time: no thread named " << t.name << "\n";
+        else if (t.exclusive)
+            std::cerr << "Real-time: CPU " << t.cpu << " reserved for " << t.name << "\n";
+    }
+    return configured;
+}
+
+// ------------------------------------------------------------------ jitter
+
+struct JitterRun {
+    const RealtimeThread *thread;
+    std::vector<uint32_t> histogram;    // 1 us buckets, the last one counts everything later
+    uint64_t samples = 0;
+    uint64_t min_ns = UINT64_MAX;
+    uint64_t max_ns = 0;
+    int migrations = 0;
+    long faults = 0;
+};
+
+static void measure(JitterRun &run, uint64_t end_ns) {
+    realtime_setup_thread(run.thread->priority, run.thread->cpu);
+
+    struct rusage before, after;
+    getrusage(RUSAGE_THREAD, &before);
+    int last_cpu = sched_getcpu();
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (true) {
+        next.tv_nsec += REALTIME_JITTER_INTERVAL_US * 1000L;
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, nullptr);
+
+        uint64_t due = static_cast<uint64_t>(next.tv_sec) * 1000000000ull + next.tv_nsec;
+        uint64_t late = telemetry_now_ns() - due;
+        run.min_ns = std::min(run.min_ns, late);
+        run.max_ns = std::max(run.max_ns, late);
+        run.histogram[std::min<uint64_t>(late / 1000, run.histogram.size() - 1)]++;
+        run.samples++;
+
+        int cpu = sched_getcpu();
+        if (cpu != last_cpu) run.migrations++;
+        last_cpu = cpu;
+        if (due >= end_ns) break;
+    }
+
+    getrusage(RUSAGE_THREAD, &after);
+    run.faults = (after.ru_minflt - before.ru_minflt) + (after.ru_majflt - before.ru_majflt);
+}
+
+static uint64_t percentile_us(const JitterRun &run, double q) {
+    if (!run.samples)
+        return 0;
+    uint64_t wanted = static_cast<uint64_t>(q * run.samples);
+    uint64_t seen = 0;
+    for (size_t us = 0; us < run.histogram.size(); us++) {
+        seen += run.histogram[us];
+        if (seen > wanted) return us;
+    }
+    return run.histogram.size() - 1;
+}
+
+void realtime_measure_jitter(const RealtimeConfig &config, int seconds, std::ostream &os) {
+    std::vector<JitterRun> runs(config.threads.size());
+    for (size_t i = 0; i < runs.size(); i++) {
+        runs[i].thread = &config.threads[i];
+        runs[i].histogram.assign(REALTIME_JITTER_MAX_US + 1, 0);
+    }
+
+    struct rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    uint64_t end_ns = telemetry_now_ns() + seconds * 1000000000ull;
+    std::vector<std::thread> threads;
+    for (JitterRun &run : runs)
+        threads.emplace_back(measure, std::ref(run), end_ns);
+    for (std::thread &t : threads)
+        t.join();
+    getrusage(RUSAGE_SELF, &after);
+
+    os << "wake-up latency every " << REALTIME_JITTER_INTERVAL_US << " us for " << seconds << " s (us)\n";
+    os << std::left << std::setw(16) << "thread" << std::right << std::setw(5) << "prio" << std::setw(5) << "cpu"
+       << std::setw(9) << "samples" << std::setw(7) << "min" << std::setw(7) << "p50" << std::setw(7) << "p99"
+       << std::setw(7) << "p99.9" << std::setw(7) << "max" << std::setw(6) << "migr" << std::setw(8) << "faults\n";
+    for (const JitterRun &run : runs) {
+        os << std::left << std::setw(16) << run.thread->name << std::right << std::setw(5) << run.thread->priority
+           << std::setw(5) << run.thread->cpu << std::setw(9) << run.samples
+           << std::setw(7) << (run.samples ? run.min_ns / 1000 : 0) << std::setw(7) << percentile_us(run, 0.5)
+           << std::setw(7) << percentile_us(run, 0.99) << std::setw(7) << percentile_us(run, 0.999)
+           << std::setw(7) << run.max_ns / 1000 << std::setw(6) << run.migrations << std::setw(7) << run.faults << "\n";
+    }
+    os << "page faults in the process during the run: " << (after.ru_minflt - before.ru_minflt) << " minor, "
+       << (after.ru_majflt - before.ru_majflt) << " major\n";
+}
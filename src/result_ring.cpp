@@ -0,0 +1,137 @@
+#include "result_ring.h"
+
+#include <iostream>
+#include <cstring>
+#include <climits>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+static uint64_t realtime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+static size_t align64(size_t n) {
+    return (n + 63) & ~static_cast<size_t>(63);
+}
+
+ResultRing::~ResultRing() {
+    close();
+}
+
+bool ResultRing::create(const std::string &name, uint32_t record_count, uint64_t slab_size) {
+    close();
+
+    uint64_t slab_offset = align64(sizeof(ResultRingHeader) + record_count * sizeof(ResultRecord));
+    size_t size = slab_offset + slab_size;
+
+    fd_ = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        std::cerr << "Failed to open shared memory " << name << "\n";
+        return false;
+    }
+
+    struct stat st;
+    bool existing = fstat(fd_, &st) == 0 && static_cast<size_t>(st.st_size) == size;
+    if (!existing && ftruncate(fd_, size) < 0) {
+        std::cerr << "Failed to size shared memory " << name << "\n";
+        close();
+        return false;
+    }
+
+    void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mem == MAP_FAILED) {
+        std::cerr << "Failed to map shared memory " << name << "\n";
+        close();
+        return false;
+    }
+    size_ = size;
+
+    uint8_t *base = static_cast<uint8_t *>(mem);
+    header_ = reinterpret_cast<ResultRingHeader *>(base);
+    records_ = reinterpret_cast<ResultRecord *>(base + sizeof(ResultRingHeader));
+    slab_ = base + slab_offset;
+
+    bool compatible = existing &&
+                      std::memcmp(header_->magic, RESULT_RING_MAGIC, sizeof(header_->magic)) == 0 &&
+                      header_->version == RESULT_RING_VERSION &&
+                      header_->record_size == sizeof(ResultRecord) &&
+                      header_->record_count == record_count &&
+                      header_->slab_offset == slab_offset &&
+                      header_->slab_size == slab_size;
+    if (!compatible) {
+        std::memset(base, 0, slab_offset);
+        header_->version = RESULT_RING_VERSION;
+        header_->record_size = sizeof(ResultRecord);
+        header_->record_count = record_count;
+        header_->slab_offset = slab_offset;
+        header_->slab_size = slab_size;
+        // magic last, so a reader never sees a valid magic with stale geometry
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        std::memcpy(header_->magic, RESULT_RING_MAGIC, sizeof(header_->magic));
+    }
+    return true;
+}
+
+void ResultRing::close() {
+    if (header_) munmap(header_, size_);
+    if (fd_ >= 0) ::close(fd_);
+    header_ = nullptr;
+    records_ = nullptr;
+    slab_ = nullptr;
+    fd_ = -1;
+    size_ = 0;
+}
+
+uint64_t ResultRing::head() const {
+    return header_ ? __atomic_load_n(&header_->head, __ATOMIC_ACQUIRE) : 0;
+}
+
+uint64_t ResultRing::write_image(const uint8_t *data, size_t len) {
+    uint64_t slab_size = header_->slab_size;
+    uint64_t offset = header_->slab_head;
+    if (len == 0 || len > slab_size) return offset;
+
+    // an image never wraps; skip to the start of the slab instead
+    uint64_t pos = offset % slab_size;
+    if (pos + len > slab_size) offset += slab_size - pos;
+
+    // claim the space before overwriting so readers can tell what they lost
+    __atomic_store_n(&header_->slab_head, offset + len, __ATOMIC_RELEASE);
+    std::memcpy(slab_ + offset % slab_size, data, len);
+    return offset;
+}
+
+uint64_t ResultRing::publish(ResultRecord &record,
+                             const uint8_t *raw, size_t raw_len,
+                             const uint8_t *processed, size_t processed_len) {
+    if (!header_) return 0;
+
+    uint64_t seq = header_->head + 1;
+    ResultRecord *slot = &records_[seq % header_->record_count];
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELEASE);
+
+    if (raw_len > header_->slab_size) raw_len = 0;
+    if (processed_len > header_->slab_size) processed_len = 0;
+    record.raw_offset = write_image(raw, raw_len);
+    record.raw_len = raw_len;
+    record.processed_offset = write_image(processed, processed_len);
+    record.processed_len = processed_len;
+    record.publish_ns = realtime_ns();
+    record.seq = 0;
+
+    std::memcpy(slot, &record, sizeof(record));
+    __atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+    __atomic_store_n(&header_->head, seq, __ATOMIC_RELEASE);
+    record.seq = seq;
+
+    __atomic_fetch_add(&header_->notify, 1, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &header_->notify, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+    return seq;
+}
@@ -0,0 +1,255 @@
+#include "segment_log.h"
+
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+static std::string segment_name(const std::string &dir, const std::string &prefix, uint64_t index) {
+    char name[32];
+    snprintf(name, sizeof(name), "_%06llu.bin", static_cast<unsigned long long>(index));
+    return dir + "/" + prefix + name;
+}
+
+SegmentLog::~SegmentLog() {
+    close();
+}
+
+bool SegmentLog::open(const std::string &dir, const std::string &prefix, size_t segment_size) {
+    close();
+    dir_ = dir;
+    prefix_ = prefix;
+    segment_size_ = segment_size;
+    records_ = 0;
+
+    mkdir(dir.c_str(), 0755);
+
+    // continue after the highest existing segment so earlier archives are never overwritten
+    uint64_t next = 0;
+    DIR *d = opendir(dir.c_str());
+    if (d) {
+        struct dirent *e;
+        std::string pattern = prefix + "_%llu.bin";
+        while ((e = readdir(d)) != nullptr) {
+            unsigned long long idx;
+            if (sscanf(e->d_name, pattern.c_str(), &idx) == 1 && idx + 1 > next)
+                next = idx + 1;
+        }
+        closedir(d);
+    }
+
+    return open_segment(next);
+}
+
+bool SegmentLog::map_segment(uint64_t index, SegmentMapping &out) const {
+    std::string filename = segment_name(dir_, prefix_, index);
+    int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cerr << "Failed to create segment " << filename << "\n";
+        return false;
+    }
+
+    if (ftruncate(fd, segment_size_) < 0) {
+        std::cerr << "Failed to size segment " << filename << "\n";
+        ::close(fd);
+        return false;
+    }
+
+    // populate up front so appends do not take page faults either
+    void *mem = mmap(nullptr, segment_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    if (mem == MAP_FAILED) {
+        std::cerr << "Failed to map segment " << filename << "\n";
+        ::close(fd);
+        return false;
+    }
+
+    SegmentHeader header = {};
+    std::memcpy(header.magic, SEGMENT_MAGIC, sizeof(header.magic));
+    header.version = SEGMENT_VERSION;
+    header.header_size = sizeof(SegmentHeader);
+    header.segment_index = index;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    header.created_ns = static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+    std::memcpy(mem, &header, sizeof(header));
+
+    out.fd = fd;
+    out.base = static_cast<uint8_t *>(mem);
+    out.index = index;
+    out.used = align8(sizeof(header));
+    return true;
+}
+
+void SegmentLog::release_segment(SegmentMapping &mapping) const {
+    if (!mapping.base)
+        return;
+    munmap(mapping.base, segment_size_);
+    if (mapping.used <= align8(sizeof(SegmentHeader))) {
+        // never written to: a spare that was not needed
+        unlink(segment_name(dir_, prefix_, mapping.index).c_str());
+    } else if (ftruncate(mapping.fd, mapping.used) < 0) {
+        // trim the unused tail so finished segments only take the space they need
+        std::cerr << "Failed to trim segment " << mapping.index << "\n";
+    }
+    ::close(mapping.fd);
+    mapping = SegmentMapping();
+}
+
+void SegmentLog::install_spare(SegmentMapping &spare) {
+    if (spare_.base || spare.index != index_ + 1) {
+        // appends moved on while it was being mapped
+        release_segment(spare);
+        return;
+    }
+    spare_ = spare;
+    spare = SegmentMapping();
+}
+
+bool SegmentLog::take_retired(SegmentMapping &out) {
+    if (!retired_.base)
+        return false;
+    out = retired_;
+    retired_ = SegmentMapping();
+    return true;
+}
+
+bool SegmentLog::open_segment(uint64_t index) {
+    SegmentMapping mapping;
+    if (!map_segment(index, mapping))
+        return false;
+    fd_ = mapping.fd;
+    base_ = mapping.base;
+    index_ = mapping.index;
+    used_ = mapping.used;
+    return true;
+}
+
+void SegmentLog::close_segment() {
+    if (!base_)
+        return;
+    SegmentMapping current;
+    current.fd = fd_;
+    current.base = base_;
+    current.index = index_;
+    current.used = used_;
+    release_segment(current);
+    base_ = nullptr;
+    fd_ = -1;
+    used_ = 0;
+}
+
+void SegmentLog::close() {
+    close_segment();
+    release_segment(retired_);
+    release_segment(spare_);
+}
+
+bool SegmentLog::append(uint32_t type, const void *a, size_t a_len, const void *b, size_t b_len) {
+    if (!base_)
+        return false;
+
+    size_t size = sizeof(SegmentRecordHeader) + align8(a_len + b_len);
+    if (size + align8(sizeof(SegmentHeader)) > segment_size_) {
+        std::cerr << "Record of " << size << " bytes does not fit in a segment\n";
+        return false;
+    }
+
+    if (used_ + size > segment_size_) {
+        uint64_t next = index_ + 1;
+        if (spare_.base && spare_.index == next && !retired_.base) {
+            retired_.fd = fd_;
+            retired_.base = base_;
+            retired_.index = index_;
+            retired_.used = used_;
+            fd_ = spare_.fd;
+            base_ = spare_.base;
+            index_ = spare_.index;
+            used_ = spare_.used;
+            spare_ = SegmentMapping();
+        } else {
+            close_segment();
+            if (!open_segment(next))
+                return false;
+        }
+    }
+
+    uint8_t *dst = base_ + used_;
+    SegmentRecordHeader header = { static_cast<uint32_t>(size), type };
+    std::memcpy(dst + sizeof(header), a, a_len);
+    if (b_len)
+        std::memcpy(dst + sizeof(header) + a_len, b, b_len);
+    // publish the size last so a reader never sees a partially written record
+    __atomic_store(reinterpret_cast<SegmentRecordHeader *>(dst), &header, __ATOMIC_RELEASE);
+
+    used_ += size;
+    records_++;
+    return true;
+}
+
+bool segment_for_each(const std::string &filename,
+                      void (*fn)(uint32_t type, const uint8_t *payload, size_t len, void *user),
+                      void *user) {
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(SegmentHeader)) {
+        ::close(fd);
+        return false;
+    }
+
+    size_t length = st.st_size;
+    void *mem = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mem == MAP_FAILED)
+        return false;
+
+    const uint8_t *base = static_cast<const uint8_t *>(mem);
+    const SegmentHeader *header = reinterpret_cast<const SegmentHeader *>(base);
+    if (std::memcmp(header->magic, SEGMENT_MAGIC, sizeof(header->magic)) != 0) {
+        munmap(mem, length);
+        return false;
+    }
+
+    size_t offset = align8(header->header_size);
+    while (offset + sizeof(SegmentRecordHeader) <= length) {
+        SegmentRecordHeader rec;
+        __atomic_load(reinterpret_cast<const SegmentRecordHeader *>(base + offset), &rec, __ATOMIC_ACQUIRE);
+        if (rec.size < sizeof(rec) || offset + rec.size > length)
+            break;
+        fn(rec.type, base + offset + sizeof(rec), rec.size - sizeof(rec), user);
+        offset += rec.size;
+    }
+
+    munmap(mem, length);
+    return true;
+}
+
+std::vector<std::string> segment_files(const std::string &dir, const std::string &prefix) {
+    std::vector<std::string> files;
+    DIR *d = opendir(dir.c_str());
+    if (!d)
+        return files;
+    struct dirent *e;
+    std::string pattern = prefix + "_%llu.bin";
+    while ((e = readdir(d)) != nullptr) {
+        unsigned long long idx;
+        if (sscanf(e->d_name, pattern.c_str(), &idx) == 1)
+            files.push_back(dir + "/" + e->d_name);
+    }
+    closedir(d);
+    // the index is zero-padded, so name order is segment order
+    std::sort(files.begin(), files.end());
+    return files;
+}
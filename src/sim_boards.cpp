@@ -0,0 +1,52 @@
+#include "sim_boards.h"
+
+#include <iostream>
+
+SimBoards::~SimBoards() {
+    stop();
+}
+
+bool SimBoards::start(int count, const FakeStmConfig &config) {
+    for (int i = 0; i < count; i++) {
+        PtyPair pty;
+        if (!open_pty_pair(pty)) {
+            std::cerr << "Simulated boards: cannot open a pty\n";
+            stop();
+            return false;
+        }
+        auto board = std::make_unique<FakeStm>();
+        if (!board->start(pty.master_fd, config)) {
+            std::cerr << "Simulated boards: cannot start board " << i << "\n";
+            close_pty_pair(pty);
+            stop();
+            return false;
+        }
+        ptys_.push_back(pty);
+        boards_.push_back(std::move(board));
+    }
+    return true;
+}
+
+void SimBoards::stop() {
+    // the boards read the masters, so they go first
+    for (auto &board : boards_)
+        board->stop();
+    boards_.clear();
+    for (PtyPair &pty : ptys_)
+        close_pty_pair(pty);
+    ptys_.clear();
+}
+
+std::vector<std::string> SimBoards::devices() const {
+    std::vector<std::string> paths;
+    for (const PtyPair &pty : ptys_)
+        paths.push_back(pty.slave_path);
+    return paths;
+}
+
+uint64_t SimBoards::requests() const {
+    uint64_t total = 0;
+    for (const auto &board : boards_)
+        total += board->requests();
+    return total;
+}
@@ -0,0 +1,262 @@
+#include "stage_taps.h"
+#include "preprocess_graph.h"
+#include "reactor.h"
+
+#include <iostream>
+#include <sstream>
+#include <fstream>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+static std::shared_ptr<const PreprocessPlan> running_plan() {
+    return model_registry().get_as<PreprocessPlan>(PREPROCESS_MODEL);
+}
+
+StageTaps::~StageTaps() {
+    stop();
+}
+
+bool StageTaps::arm(const std::vector<std::string> &names, int every, std::string &error) {
+    std::shared_ptr<const PreprocessPlan> plan = running_plan();
+    if (!plan) {
+        error = "no preprocessing plan loaded";
+        return false;
+    }
+    std::vector<std::string> taps;
+    for (const std::string &name : names) {
+        if (name == "all") {
+            taps.insert(taps.end(), plan->taps.begin(), plan->taps.end());
+        } else if (plan->find_tap(name) < 0) {
+            error = "no tap " + name;
+            return false;
+        } else {
+            taps.push_back(name);
+        }
+    }
+    if (taps.empty() || every < 0) {
+        error = "nothing to tap";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    names_ = taps;
+    every_ = every;
+    counter_ = 0;
+    armed_.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void StageTaps::disarm() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    armed_.store(false, std::memory_order_relaxed);
+    names_.clear();
+}
+
+uint64_t StageTaps::select(uint64_t &plan_version) {
+    std::vector<std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!armed_.load(std::memory_order_relaxed))
+            return 0;
+        if (every_ > 1 && counter_++ % every_ != 0)
+            return 0;
+        names = names_;
+        if (every_ == 0) {
+            armed_.store(false, std::memory_order_relaxed);
+            names_.clear();
+        }
+    }
+
+    // names, not indices, are armed: a replanned list keeps the taps it still has
+    std::shared_ptr<const PreprocessPlan> plan = running_plan();
+    if (!plan)
+        return 0;
+    uint64_t mask = 0;
+    for (const std::string &name : names) {
+        int stage = plan->find_tap(name);
+        if (stage >= 0) mask |= 1ull << stage;
+    }
+    plan_version = plan->version;
+    if (mask) frames_.fetch_add(1, std::memory_order_relaxed);
+    return mask;
+}
+
+void StageTaps::write(const std::string &dir, uint64_t capture_ns, const std::vector<TapImage> &taps) {
+    mkdir(dir.c_str(), 0755);
+    for (const TapImage &tap : taps) {
+        if (tap.pixels.size() != (size_t)tap.width * tap.height || tap.pixels.empty()) {
+            failed_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        char stage[8];
+        snprintf(stage, sizeof(stage), "%02d", tap.stage);
+        std::string path = dir + "/" + std::to_string(capture_ns) + "_" + stage + "_" + tap.name + ".pgm";
+        std::ofstream file(path, std::ios::binary);
+        file << "P5\n" << tap.width << " " << tap.height << "\n255\n";
+        file.write(reinterpret_cast<const char *>(tap.pixels.data()), tap.pixels.size());
+        if (!file.good()) {
+            std::cerr << "Taps: cannot write " << path << "\n";
+            failed_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        files_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+std::string StageTaps::status() const {
+    std::ostringstream out;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (armed_.load(std::memory_order_relaxed)) {
+            out << "armed ";
+            for (size_t i = 0; i < names_.size(); i++)
+                out << (i ? "," : "") << names_[i];
+            if (every_ > 1) out << " every " << every_ << " frames";
+            else if (every_ == 1) out << " every frame";
+            else out << " next frame";
+        } else {
+            out << "off";
+        }
+    }
+    out << ", " << frames_.load() << " frames tapped, " << files_.load() << " images written";
+    if (failed_.load()) out << ", " << failed_.load() << " failed";
+    return out.str();
+}
+
+std::string StageTaps::command(const std::string &line) {
+    std::istringstream words(line);
+    std::string verb;
+    words >> verb;
+
+    if (verb == "list") {
+        std::shared_ptr<const PreprocessPlan> plan = running_plan();
+        if (!plan) return "error no preprocessing plan loaded";
+        std::string reply = "ok";
+        for (const std::string &tap : plan->taps)
+            reply += " " + tap;
+        return reply;
+    }
+    if (verb == "tap") {
+        std::string list;
+        int every = 0;
+        words >> list;
+        if (!(words >> every)) every = 0;
+        std::vector<std::string> names;
+        std::stringstream listStream(list);
+        std::string name;
+        while (getline(listStream, name, ','))
+            if (!name.empty()) names.push_back(name);
+        std::string error;
+        if (!arm(names, every, error)) return "error " + error;
+        return "ok " + status();
+    }
+    if (verb == "off") {
+        disarm();
+        return "ok " + status();
+    }
+    if (verb == "status")
+        return "ok " + status();
+    return "error commands are list, tap NAME[,NAME...] [N], off and status";
+}
+
+bool StageTaps::serve(const std::string &path, Reactor &reactor) {
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Taps: socket path too long\n";
+        return false;
+    }
+    std::strcpy(addr.sun_path, path.c_str());
+
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path.c_str());
+    if (listen_fd_ < 0 ||
+        bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd_, 4) < 0) {
+        std::cerr << "Taps: cannot listen on " << path << ": " << strerror(errno) << "\n";
+        if (listen_fd_ >= 0) close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+    path_ = path;
+    reactor_ = &reactor;
+    reactor.add(listen_fd_, EPOLLIN, [this](uint32_t) { accept_clients(); });
+    return true;
+}
+
+void StageTaps::stop() {
+    if (!reactor_)
+        return;
+    reactor_->call([this] {
+        reactor_->remove(listen_fd_);
+        while (!clients_.empty())
+            close_client(clients_.begin()->first);
+    });
+    reactor_ = nullptr;
+    close(listen_fd_);
+    unlink(path_.c_str());
+    listen_fd_ = -1;
+}
+
+void StageTaps::accept_clients() {
+    while (true) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EINTR)
+                std::cerr << "Taps: accept failed: " << strerror(errno) << "\n";
+            return;
+        }
+        clients_[fd].clear();
+        reactor_->add(fd, EPOLLIN, [this, fd](uint32_t) { on_client(fd); });
+    }
+}
+
+void StageTaps::on_client(int fd) {
+    auto it = clients_.find(fd);
+    if (it == clients_.end()) return;
+    std::string &in = it->second;
+
+    // the command and the EOF often arrive together (echo ... | socat): run
+    // every command received before closing
+    char buffer[TAP_MAX_LINE];
+    bool eof = false;
+    while (true) {
+        ssize_t got = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (got == 0) {
+            eof = true;
+            if (!in.empty() && in.back() != '\n') in += '\n';
+            break;
+        }
+        if (got < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            if (errno == EINTR) continue;
+            close_client(fd);
+            return;
+        }
+        in.append(buffer, got);
+    }
+
+    // replies are one short line each; a client that does not read them is dropped
+    size_t newline;
+    while ((newline = in.find('\n')) != std::string::npos) {
+        std::string reply = command(in.substr(0, newline)) + "\n";
+        in.erase(0, newline + 1);
+        if (send(fd, reply.data(), reply.size(), MSG_DONTWAIT | MSG_NOSIGNAL) != (ssize_t)reply.size()) {
+            close_client(fd);
+            return;
+        }
+    }
+    if (eof || in.size() > TAP_MAX_LINE)
+        close_client(fd);
+}
+
+void StageTaps::close_client(int fd) {
+    reactor_->remove(fd);
+    close(fd);
+    clients_.erase(fd);
+}
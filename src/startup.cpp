@@ -0,0 +1,190 @@
+#include "startup.h"
+#include "telemetry.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <algorithm>
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+void StartupGraph::add(const std::string &name, const std::vector<std::string> &after, StartupFn fn) {
+    Step step;
+    step.name = name;
+    step.fn = std::move(fn);
+    for (const std::string &dep : after) {
+        auto it = std::find_if(steps_.begin(), steps_.end(), [&](const Step &s) { return s.name == dep; });
+        if (it == steps_.end()) {
+            std::cerr << "Startup: " << name << " comes after unknown step " << dep << "\n";
+            unknown_dep_ = true;
+            continue;
+        }
+        step.after.push_back(it - steps_.begin());
+    }
+    steps_.push_back(std::move(step));
+}
+
+bool StartupGraph::run() {
+    // steps only name earlier steps, so the graph cannot have cycles
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    std::vector<bool> done(steps_.size(), false);
+
+    begin_ns_ = telemetry_now_ns();
+    if (unknown_dep_) {
+        for (Step &step : steps_) {
+            step.start_ns = step.end_ns = begin_ns_;
+            step.skipped = true;
+        }
+        end_ns_ = begin_ns_;
+        return false;
+    }
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < steps_.size(); i++) {
+        threads.emplace_back([&, i] {
+            pthread_setname_np(pthread_self(), "ann-startup");
+            Step &step = steps_[i];
+            bool deps_ok = true;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                done_cv.wait(lock, [&] {
+                    return std::all_of(step.after.begin(), step.after.end(), [&](int d) { return done[d]; });
+                });
+                for (int d : step.after)
+                    deps_ok = deps_ok && steps_[d].ok;
+            }
+
+            step.start_ns = telemetry_now_ns();
+            if (deps_ok)
+                step.ok = step.fn();
+            else
+                step.skipped = true;
+            step.end_ns = telemetry_now_ns();
+            if (!step.ok && !step.skipped)
+                std::cerr << "Startup: " << step.name << " failed\n";
+
+            std::lock_guard<std::mutex> lock(mutex);
+            done[i] = true;
+            done_cv.notify_all();
+        });
+    }
+    for (std::thread &t : threads)
+        t.join();
+    end_ns_ = telemetry_now_ns();
+
+    return std::all_of(steps_.begin(), steps_.end(), [](const Step &s) { return s.ok; });
+}
+
+double StartupGraph::total_ms() const {
+    return (end_ns_ - begin_ns_) / 1e6;
+}
+
+double StartupGraph::serial_ms() const {
+    double sum = 0;
+    for (const Step &s : steps_)
+        sum += (s.end_ns - s.start_ns) / 1e6;
+    return sum;
+}
+
+void StartupGraph::report(std::ostream &os) const {
+    std::vector<const Step *> order;
+    for (const Step &s : steps_)
+        order.push_back(&s);
+    std::sort(order.begin(), order.end(), [](const Step *a, const Step *b) { return a->start_ns < b->start_ns; });
+
+    os << "startup (ms from start)\n";
+    os << std::left << std::setw(18) << "step" << std::right << std::setw(9) << "start"
+       << std::setw(9) << "took" << std::setw(9) << "end" << "\n";
+    os << std::fixed << std::setprecision(1);
+    for (const Step *s : order) {
+        os << std::left << std::setw(18) << s->name << std::right
+           << std::setw(9) << (s->start_ns - begin_ns_) / 1e6
+           << std::setw(9) << (s->end_ns - s->start_ns) / 1e6
+           << std::setw(9) << (s->end_ns - begin_ns_) / 1e6;
+        if (s->skipped) os << "  skipped";
+        else if (!s->ok) os << "  FAILED";
+        os << "\n";
+    }
+
+    // walk back from the step that finished last through the dependency that finished last
+    const Step *s = nullptr;
+    for (const Step &step : steps_) {
+        if (!s || step.end_ns > s->end_ns) s = &step;
+    }
+    std::vector<std::string> path;
+    while (s) {
+        path.push_back(s->name);
+        const Step *latest = nullptr;
+        for (int d : s->after) {
+            if (!latest || steps_[d].end_ns > latest->end_ns) latest = &steps_[d];
+        }
+        s = latest;
+    }
+    os << "critical path:";
+    for (auto it = path.rbegin(); it != path.rend(); ++it)
+        os << (it == path.rbegin() ? " " : " > ") << *it;
+    os << "\ntotal " << total_ms() << " ms, " << serial_ms() << " ms of steps\n";
+}
+
+double startup_uptime_s() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+bool startup_notify(const std::string &state) {
+    const char *path = getenv("NOTIFY_SOCKET");
+    if (!path || !path[0])
+        return false;
+
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    size_t len = strlen(path);
+    if (len >= sizeof(addr.sun_path))
+        return false;
+    memcpy(addr.sun_path, path, len);
+    // '@' is systemd's spelling of the abstract namespace
+    if (addr.sun_path[0] == '@')
+        addr.sun_path[0] = '\0';
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return false;
+    socklen_t addr_len = offsetof(struct sockaddr_un, sun_path) + len;
+    bool sent = sendto(fd, state.data(), state.size(), MSG_NOSIGNAL,
+                       reinterpret_cast<struct sockaddr *>(&addr), addr_len) == (ssize_t)state.size();
+    close(fd);
+    if (!sent)
+        std::cerr << "Startup: could not notify " << path << "\n";
+    return sent;
+}
+
+bool startup_write_ready_file(const std::string &path, const std::string &text) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream file(tmp);
+        if (!file.is_open()) {
+            std::cerr << "Startup: cannot write " << tmp << "\n";
+            return false;
+        }
+        file << text;
+        if (!file.good())
+            return false;
+    }
+    if (rename(tmp.c_str(), path.c_str()) != 0) {
+        std::cerr << "Startup: cannot write " << path << "\n";
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,419 @@
+#include "stm_link.h"
+#include "image_process_pipeline.h"
+
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+
+using Clock = std::chrono::steady_clock;
+
+struct CrcTable {
+    uint16_t entries[256];
+
+    CrcTable() {
+        for (int i = 0; i < 256; i++) {
+            uint16_t crc = i << 8;
+            for (int b = 0; b < 8; b++)
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
+            entries[i] = crc;
+        }
+    }
+};
+
+uint16_t crc16_ccitt(const uint8_t *data, size_t len, uint16_t crc) {
+    static const CrcTable table;
+    for (size_t i = 0; i < len; i++)
+        crc = (crc << 8) ^ table.entries[((crc >> 8) ^ data[i]) & 0xFF];
+    return crc;
+}
+
+void stm_encode_frame(uint16_t sequence, uint8_t type, const uint8_t *payload, size_t len,
+                      std::vector<uint8_t> &out) {
+    size_t start = out.size();
+    out.push_back(STM_SYNC0);
+    out.push_back(STM_SYNC1);
+    out.push_back(len & 0xFF);
+    out.push_back((len >> 8) & 0xFF);
+    out.push_back(sequence & 0xFF);
+    out.push_back((sequence >> 8) & 0xFF);
+    out.push_back(type);
+    out.insert(out.end(), payload, payload + len);
+
+    uint16_t crc = crc16_ccitt(out.data() + start + 2, STM_FRAME_HEADER - 2 + len);
+    out.push_back(crc & 0xFF);
+    out.push_back((crc >> 8) & 0xFF);
+}
+
+void stm_pack_codes(const uint16_t *codes, int count, uint8_t *out) {
+    for (int i = 0; i < count; i += 2) {
+        uint16_t a = codes[i] & 0xFFF;
+        uint16_t b = (i + 1 < count) ? codes[i + 1] & 0xFFF : 0;
+        *out++ = a & 0xFF;
+        *out++ = (a >> 8) | ((b & 0xF) << 4);
+        if (i + 1 < count)
+            *out++ = b >> 4;
+    }
+}
+
+void stm_unpack_codes(const uint8_t *in, int count, uint16_t *codes) {
+    for (int i = 0; i < count; i += 2) {
+        codes[i] = in[0] | ((in[1] & 0xF) << 8);
+        if (i + 1 < count)
+            codes[i + 1] = (in[1] >> 4) | (in[2] << 4);
+        in += 3;
+    }
+}
+
+uint16_t coefficient_to_dac_code(double coefficient) {
+    double scale = (2.0 * DAC_FULL_SCALE) / DAC_LEVELS;
+    long code = lround(coefficient / scale) + DAC_LEVELS / 2;
+    return static_cast<uint16_t>(std::max(0L, std::min(code, static_cast<long>(DAC_LEVELS - 1))));
+}
+
+double dac_code_to_coefficient(uint16_t code) {
+    double scale = (2.0 * DAC_FULL_SCALE) / DAC_LEVELS;
+    return (static_cast<int>(code) - DAC_LEVELS / 2) * scale;
+}
+
+void StmFrameParser::feed(const uint8_t *data, size_t len, std::vector<StmFrame> &frames) {
+    buf_.insert(buf_.end(), data, data + len);
+
+    size_t pos = 0;
+    while (true) {
+        // hunt for the sync word
+        while (pos + 1 < buf_.size() && !(buf_[pos] == STM_SYNC0 && buf_[pos + 1] == STM_SYNC1)) {
+            pos++;
+            dropped_bytes_++;
+        }
+        if (pos + STM_FRAME_HEADER > buf_.size())
+            break;
+
+        size_t length = buf_[pos + 2] | (buf_[pos + 3] << 8);
+        if (length > STM_MAX_PAYLOAD) {
+            pos++;
+            dropped_bytes_++;
+            continue;
+        }
+        if (pos + STM_FRAME_OVERHEAD + length > buf_.size())
+            break;
+
+        const uint8_t *frame = buf_.data() + pos;
+        uint16_t crc = crc16_ccitt(frame + 2, STM_FRAME_HEADER - 2 + length);
+        uint16_t got = frame[STM_FRAME_HEADER + length] | (frame[STM_FRAME_HEADER + length + 1] << 8);
+        if (crc != got) {
+            crc_errors_++;
+            pos++;
+            dropped_bytes_++;
+            continue;
+        }
+
+        StmFrame f;
+        f.sequence = frame[4] | (frame[5] << 8);
+        f.type = frame[6];
+        f.payload.assign(frame + STM_FRAME_HEADER, frame + STM_FRAME_HEADER + length);
+        frames.push_back(std::move(f));
+        pos += STM_FRAME_OVERHEAD + length;
+    }
+
+    buf_.erase(buf_.begin(), buf_.begin() + pos);
+}
+
+StmLink::StmLink(UartTransport &uart, int max_in_flight)
+    : uart_(uart), max_in_flight_(max_in_flight) {
+}
+
+int StmLink::send(uint8_t type, const uint8_t *payload, size_t len, int timeout_ms) {
+    if (window_full() || len > STM_MAX_PAYLOAD)
+        return -1;
+
+    uint16_t sequence = next_sequence_++;
+    tx_.clear();
+    stm_encode_frame(sequence, type, payload, len, tx_);
+
+    if (uart_.write(tx_.data(), tx_.size(), timeout_ms) != static_cast<ssize_t>(tx_.size())) {
+        std::cerr << "STM link: write of frame " << sequence << " timed out\n";
+        return -1;
+    }
+
+    pending_[sequence] = Clock::now();
+    stats_.requests++;
+    return sequence;
+}
+
+int StmLink::poll(int timeout_ms) {
+    uint8_t buf[256];
+    int matched = 0;
+
+    ssize_t n = uart_.read_some(buf, sizeof(buf), timeout_ms);
+    while (n > 0) {
+        rx_frames_.clear();
+        parser_.feed(buf, n, rx_frames_);
+
+        for (StmFrame &f : rx_frames_) {
+            auto it = pending_.find(f.sequence);
+            if (it == pending_.end()) {
+                stats_.unmatched++;
+                continue;
+            }
+            pending_.erase(it);
+            if (f.type == STM_MSG_ERROR)
+                stats_.errors++;
+            stats_.responses++;
+            completed_[f.sequence] = std::move(f);
+            matched++;
+        }
+
+        // drain whatever else is already buffered without waiting
+        n = uart_.read_some(buf, sizeof(buf), 0);
+    }
+    return matched;
+}
+
+bool StmLink::take(uint16_t sequence, StmFrame &out) {
+    auto it = completed_.find(sequence);
+    if (it == completed_.end())
+        return false;
+    out = std::move(it->second);
+    completed_.erase(it);
+    return true;
+}
+
+bool StmLink::take_any(StmFrame &out) {
+    if (completed_.empty())
+        return false;
+    auto it = completed_.begin();
+    out = std::move(it->second);
+    completed_.erase(it);
+    return true;
+}
+
+bool StmLink::wait(uint16_t sequence, StmFrame &out, int timeout_ms) {
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (!take(sequence, out)) {
+        if (pending_.find(sequence) == pending_.end())
+            return false;
+
+        int left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (timeout_ms >= 0 && left <= 0)
+            return false;
+        poll(timeout_ms < 0 ? -1 : left);
+    }
+    return true;
+}
+
+void StmLink::cancel(uint16_t sequence) {
+    if (pending_.erase(sequence))
+        stats_.cancelled++;
+    completed_.erase(sequence);
+}
+
+void StmLink::reset() {
+    uart_.flush_input();
+    parser_.reset();
+    pending_.clear();
+    completed_.clear();
+}
+
+int StmLink::send_hello(int timeout_ms) {
+    // everything this host speaks; the reply says what the STM does
+    uint8_t hello[2] = { STM_PROTOCOL_VERSION, STM_CAP_PACKED | STM_CAP_BAUD };
+    return send(STM_MSG_HELLO, hello, sizeof(hello), timeout_ms);
+}
+
+bool StmLink::negotiate(int timeout_ms) {
+    int seq = send_hello(timeout_ms);
+    if (seq < 0)
+        return false;
+
+    StmFrame reply;
+    if (!wait(seq, reply, timeout_ms)) {
+        cancel(seq);
+        return false;
+    }
+
+    if (reply.type == STM_MSG_HELLO_ACK && reply.payload.size() >= 2) {
+        peer_version_ = reply.payload[0];
+        packed_ = peer_version_ >= 2 && (reply.payload[1] & STM_CAP_PACKED);
+        baud_capable_ = peer_version_ >= 2 && (reply.payload[1] & STM_CAP_BAUD);
+    } else {
+        // framed firmware that predates HELLO rejects it
+        peer_version_ = 1;
+        packed_ = false;
+        baud_capable_ = false;
+    }
+    return true;
+}
+
+bool StmLink::echo_test(int frames, size_t len, int timeout_ms) {
+    std::vector<uint8_t> pattern(std::min<size_t>(len, STM_MAX_PAYLOAD));
+    uint32_t lfsr = 0xACE1u;
+
+    for (int f = 0; f < frames; f++) {
+        // mix of pseudo-random bytes plus sync bytes to exercise resynchronisation
+        for (size_t i = 0; i < pattern.size(); i++) {
+            lfsr = (lfsr >> 1) ^ (-(lfsr & 1u) & 0xB400u);
+            pattern[i] = (i % 17 == 0) ? STM_SYNC0 : static_cast<uint8_t>(lfsr);
+        }
+
+        int seq = send(STM_MSG_ECHO, pattern.data(), pattern.size(), timeout_ms);
+        StmFrame reply;
+        if (seq < 0)
+            return false;
+        if (!wait(seq, reply, timeout_ms)) {
+            cancel(seq);
+            return false;
+        }
+        if (reply.type != STM_MSG_ECHO_REPLY || reply.payload != pattern)
+            return false;
+    }
+    return true;
+}
+
+int StmLink::negotiate_baud(const std::vector<int> &candidates, int timeout_ms) {
+    int current = uart_.baud();
+    if (!baud_capable_)
+        return current;
+
+    for (int baud : candidates) {
+        if (baud <= current)
+            continue;
+
+        uint8_t req[4] = { static_cast<uint8_t>(baud), static_cast<uint8_t>(baud >> 8),
+                           static_cast<uint8_t>(baud >> 16), static_cast<uint8_t>(baud >> 24) };
+        int seq = send(STM_MSG_SET_BAUD, req, sizeof(req), timeout_ms);
+        StmFrame reply;
+        if (seq < 0)
+            break;
+        if (!wait(seq, reply, timeout_ms)) {
+            cancel(seq);
+            break;
+        }
+        if (reply.type != STM_MSG_SET_BAUD_ACK)
+            continue;  // the STM cannot do this rate, try the next one
+
+        if (!uart_.set_baud(baud)) {
+            // we cannot follow; let the STM's commit window expire so it reverts
+            std::this_thread::sleep_for(std::chrono::milliseconds(STM_BAUD_COMMIT_WINDOW_MS * 2));
+            uart_.flush_input();
+            parser_.reset();
+            continue;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        uart_.flush_input();
+        parser_.reset();
+
+        bool ok = echo_test(8, STM_MAX_PAYLOAD, timeout_ms);
+        bool committed = false;
+        if (ok) {
+            seq = send(STM_MSG_BAUD_COMMIT, req, sizeof(req), timeout_ms);
+            committed = seq >= 0;
+            ok = committed && wait(seq, reply, timeout_ms) && reply.type == STM_MSG_BAUD_COMMIT_ACK;
+            if (!ok && seq >= 0)
+                cancel(seq);
+        }
+
+        // A lost COMMIT_ACK leaves the STM at the new rate, but so does a lost
+        // COMMIT until its window runs out: only an answer after the window
+        // shows which one it was
+        bool window_passed = false;
+        if (!ok && committed) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(STM_BAUD_COMMIT_WINDOW_MS * 2));
+            window_passed = true;
+            uart_.flush_input();
+            parser_.reset();
+            ok = hello_answered(timeout_ms);
+        }
+
+        if (ok) {
+            std::cerr << "STM link running at " << baud << " baud\n";
+            return baud;
+        }
+
+        // the STM drops back on its own once the commit window passes
+        std::cerr << "STM link failed at " << baud << " baud, falling back to " << current << "\n";
+        if (!window_passed)
+            std::this_thread::sleep_for(std::chrono::milliseconds(STM_BAUD_COMMIT_WINDOW_MS * 2));
+        uart_.set_baud(current);
+        uart_.flush_input();
+        parser_.reset();
+        pending_.clear();
+        completed_.clear();
+        if (!committed || hello_answered(timeout_ms))
+            continue;
+
+        // silent at the old rate too: the commit may have landed after all
+        uart_.set_baud(baud);
+        uart_.flush_input();
+        parser_.reset();
+        if (hello_answered(timeout_ms)) {
+            std::cerr << "STM link running at " << baud << " baud (commit ack lost)\n";
+            return baud;
+        }
+        uart_.set_baud(current);
+        uart_.flush_input();
+        parser_.reset();
+        std::cerr << "STM link lost during baud change\n";
+        break;
+    }
+    return uart_.baud();
+}
+
+bool StmLink::hello_answered(int timeout_ms) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int seq = send_hello(timeout_ms);
+        if (seq < 0)
+            return false;
+        StmFrame reply;
+        if (wait(seq, reply, timeout_ms))
+            return true;
+        cancel(seq);
+    }
+    return false;
+}
+
+int StmLink::send_coefficients(const std::vector<double> &coefficients, int timeout_ms) {
+    if (packed_) {
+        uint16_t codes[STM_MAX_PAYLOAD];
+        int count = std::min<int>(coefficients.size(), STM_MAX_PAYLOAD);
+        for (int i = 0; i < count; i++)
+            codes[i] = coefficient_to_dac_code(coefficients[i]);
+
+        uint8_t payload[STM_PACKED_COEFF_BYTES(STM_MAX_PAYLOAD)];
+        stm_pack_codes(codes, count, payload);
+        return send(STM_MSG_INFER_PACKED, payload, STM_PACKED_COEFF_BYTES(count), timeout_ms);
+    }
+
+    std::vector<uint8_t> payload;
+    for (double c : coefficients) {
+        int32_t v = static_cast<int32_t>(c * 10000);
+        payload.push_back((v >> 0) & 0xFF);
+        payload.push_back((v >> 8) & 0xFF);
+        payload.push_back((v >> 16) & 0xFF);
+        payload.push_back((v >> 24) & 0xFF);
+    }
+    return send(STM_MSG_INFER, payload.data(), payload.size(), timeout_ms);
+}
+
+bool StmLink::decode_softmax(const StmFrame &frame, std::vector<double> &softmax) {
+    if (frame.type == STM_MSG_SOFTMAX_PACKED && frame.payload.size() == STM_SOFTMAX_SIZE * 2) {
+        const uint8_t *p = frame.payload.data();
+        softmax.assign(STM_SOFTMAX_SIZE, 0.0);
+        for (int i = 0; i < STM_SOFTMAX_SIZE; i++)
+            softmax[i] = (p[i * 2] | (p[i * 2 + 1] << 8)) / 65535.0;
+        return true;
+    }
+
+    if (frame.type != STM_MSG_SOFTMAX || frame.payload.size() != STM_SOFTMAX_SIZE * 4)
+        return false;
+
+    const uint8_t *p = frame.payload.data();
+    softmax.assign(STM_SOFTMAX_SIZE, 0.0);
+    for (int i = 0; i < STM_SOFTMAX_SIZE; i++) {
+        int32_t v = p[i * 4] | (p[i * 4 + 1] << 8) | (p[i * 4 + 2] << 16) | (p[i * 4 + 3] << 24);
+        softmax[i] = v / 10000.0;
+    }
+    return true;
+}
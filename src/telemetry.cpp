@@ -0,0 +1,135 @@
+#include "telemetry.h"
+#include "stm_link.h"
+
+#include <iostream>
+#include <ctime>
+#include <cmath>
+#include <chrono>
+#include <pthread.h>
+
+uint64_t telemetry_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+uint16_t telemetry_quantize_probability(double p) {
+    if (!(p > 0.0)) return 0;
+    if (p >= 1.0) return 65535;
+    return static_cast<uint16_t>(std::lround(p * 65535.0));
+}
+
+double telemetry_probability(uint16_t q) {
+    return q / 65535.0;
+}
+
+void telemetry_set_result(TelemetryRecord &record, const std::vector<double> &coefficients,
+                          const std::vector<double> &softmax) {
+    for (int i = 0; i < TELEMETRY_COEFFICIENTS; i++)
+        record.coefficients[i] = i < (int)coefficients.size() ? coefficient_to_dac_code(coefficients[i]) : 0;
+
+    record.digit = -1;
+    double best = -1.0;
+    for (int i = 0; i < TELEMETRY_SOFTMAX; i++) {
+        double p = i < (int)softmax.size() ? softmax[i] : 0.0;
+        record.softmax[i] = telemetry_quantize_probability(p);
+        if (i < (int)softmax.size() && p > best) {
+            best = p;
+            record.digit = i;
+        }
+    }
+}
+
+TelemetryLog::~TelemetryLog() {
+    stop();
+}
+
+bool TelemetryLog::start(const std::string &dir, size_t segment_size) {
+    if (running_)
+        return true;
+    if (!log_.open(dir, TELEMETRY_PREFIX, segment_size))
+        return false;
+
+    running_ = true;
+    thread_ = std::thread(&TelemetryLog::housekeeping, this);
+    return true;
+}
+
+void TelemetryLog::stop() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        if (!running_)
+            return;
+        running_ = false;
+    }
+    wake_cv_.notify_one();
+    thread_.join();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    log_.close();
+}
+
+bool TelemetryLog::append(TelemetryRecord &record) {
+    record.thermal_level = thermal_level_.load(std::memory_order_relaxed);
+    return write(RECORD_TYPE_TELEMETRY, &record, sizeof(record), &record.seq);
+}
+
+bool TelemetryLog::append(const ThermalRecord &record) {
+    return write(RECORD_TYPE_THERMAL, &record, sizeof(record), nullptr);
+}
+
+bool TelemetryLog::write(uint32_t type, const void *data, size_t len, uint64_t *seq) {
+    if (!running_) {
+        failed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    bool ok;
+    bool wants_spare;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (seq) *seq = seq_++;
+        ok = log_.append(type, data, len);
+        wants_spare = log_.wants_spare();
+    }
+    (ok ? written_ : failed_).fetch_add(1, std::memory_order_relaxed);
+
+    // a rotation used up the spare; have the next one mapped before it is needed
+    if (wants_spare) {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            wake_requested_ = true;
+        }
+        wake_cv_.notify_one();
+    }
+    return ok;
+}
+
+// Maps the next segment ahead of time and trims full ones, so append() never
+// waits on the filesystem
+void TelemetryLog::housekeeping() {
+    pthread_setname_np(pthread_self(), "ann-telemetry");
+    while (running_) {
+        SegmentMapping retired;
+        bool wants_spare;
+        uint64_t next;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            log_.take_retired(retired);
+            wants_spare = log_.wants_spare();
+            next = log_.next_index();
+        }
+        log_.release_segment(retired);
+
+        SegmentMapping spare;
+        if (wants_spare && log_.map_segment(next, spare)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            log_.install_spare(spare);
+        }
+
+        // sleeps until the next rotation; a failed mapping is retried on the next append
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        wake_cv_.wait(lock, [this] { return !running_ || wake_requested_; });
+        wake_requested_ = false;
+    }
+}
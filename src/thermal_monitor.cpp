@@ -0,0 +1,124 @@
+#include "thermal_monitor.h"
+#include "telemetry.h"
+#include "reactor.h"
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstdlib>
+
+// First line of a sysfs attribute as a number; false if missing or not a number
+static bool read_number(const std::string &path, int base, long long &value) {
+    std::ifstream file(path);
+    std::string line;
+    if (!file.is_open() || !getline(file, line))
+        return false;
+    char *end;
+    value = strtoll(line.c_str(), &end, base);
+    return end != line.c_str();
+}
+
+const char *thermal_level_name(int level) {
+    switch (level) {
+    case THERMAL_NORMAL: return "normal";
+    case THERMAL_WARM: return "warm";
+    case THERMAL_HOT: return "hot";
+    default: return "unknown";
+    }
+}
+
+ThermalMonitor::~ThermalMonitor() {
+    stop();
+}
+
+bool ThermalMonitor::start(const ThermalConfig &config, Reactor &reactor, Listener listener) {
+    config_ = config;
+    listener_ = std::move(listener);
+
+    ThermalSample first;
+    if (!sample(first)) {
+        std::cerr << "Thermal monitor: nothing readable under " << config_.root << "\n";
+        return false;
+    }
+    if (!first.has_throttled)
+        std::cerr << "Thermal monitor: no firmware throttle flags, using temperature and clock only\n";
+
+    reactor_ = &reactor;
+    timer_ = reactor.add_timer(config_.interval_ms, [this] { tick(); });
+    if (timer_ < 0) {
+        reactor_ = nullptr;
+        return false;
+    }
+    reactor.post([this] { tick(); });
+    return true;
+}
+
+void ThermalMonitor::stop() {
+    if (!reactor_)
+        return;
+    // on the loop thread, so no tick is running once this returns
+    reactor_->call([this] { reactor_->cancel_timer(timer_); });
+    reactor_ = nullptr;
+    timer_ = -1;
+}
+
+bool ThermalMonitor::sample(ThermalSample &out) const {
+    out = ThermalSample();
+    out.stamp_ns = telemetry_now_ns();
+
+    const std::string root = config_.root + "/";
+    long long value;
+    if ((out.has_temp = read_number(root + THERMAL_TEMP_FILE, 10, value)))
+        out.temp_mc = (int32_t)value;
+    if ((out.has_freq = read_number(root + THERMAL_FREQ_FILE, 10, value)))
+        out.freq_khz = (uint32_t)value;
+    if (read_number(root + THERMAL_MAX_FREQ_FILE, 10, value))
+        out.max_freq_khz = (uint32_t)value;
+    if ((out.has_throttled = read_number(root + THERMAL_THROTTLED_FILE, 16, value)))
+        out.throttled = (uint32_t)value;
+
+    out.level = classify(out, level());
+    return out.has_temp || out.has_freq || out.has_throttled;
+}
+
+int ThermalMonitor::classify(const ThermalSample &s, int previous) const {
+    double temp_c = s.temp_mc / 1000.0;
+    // once hot (or warm), stay there until clearly cooler
+    double hot_c = previous >= THERMAL_HOT ? config_.hot_c - config_.hysteresis_c : config_.hot_c;
+    double warm_c = previous >= THERMAL_WARM ? config_.warm_c - config_.hysteresis_c : config_.warm_c;
+
+    if (s.throttled & (THROTTLE_THROTTLED | THROTTLE_SOFT_TEMP))
+        return THERMAL_HOT;
+    if (s.has_temp && temp_c >= hot_c)
+        return THERMAL_HOT;
+    if (s.throttled & (THROTTLE_FREQ_CAPPED | THROTTLE_UNDERVOLTAGE))
+        return THERMAL_WARM;
+    if (s.has_temp && temp_c >= warm_c)
+        return THERMAL_WARM;
+    // run.sh pins the performance governor, so a clock below the maximum means capping
+    if (!s.has_throttled && s.has_freq && s.max_freq_khz && s.freq_khz < s.max_freq_khz * 9 / 10)
+        return THERMAL_WARM;
+    return THERMAL_NORMAL;
+}
+
+ThermalSample ThermalMonitor::last() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return last_;
+}
+
+void ThermalMonitor::tick() {
+    ThermalSample s;
+    sample(s);
+    int previous = level_.exchange(s.level, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        last_ = s;
+    }
+    if (s.level != previous) {
+        std::cerr << "Thermal: " << thermal_level_name(previous) << " -> " << thermal_level_name(s.level)
+                  << " (" << std::fixed << std::setprecision(1) << s.temp_mc / 1000.0 << " C, "
+                  << s.freq_khz / 1000 << " MHz, flags 0x" << std::hex << s.throttled << std::dec << ")\n";
+    }
+    if (listener_)
+        listener_(s);
+}
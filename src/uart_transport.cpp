@@ -0,0 +1,302 @@
+#include "uart_transport.h"
+#include "uart.h"
+
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <termios.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using Clock = std::chrono::steady_clock;
+
+// rounded up, as Deadline::remaining_ms, so the last partial millisecond is waited out
+static int remaining_ms(Clock::time_point deadline, int timeout_ms) {
+    if (timeout_ms < 0)
+        return -1;
+    auto left = std::chrono::duration_cast<std::chrono::microseconds>(deadline - Clock::now()).count();
+    return left > 0 ? static_cast<int>((left + 999) / 1000) : 0;
+}
+
+ssize_t UartTransport::read(uint8_t *buf, size_t len, int timeout_ms) {
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = read_some(buf + done, len - done, remaining_ms(deadline, timeout_ms));
+        if (n < 0)
+            return -1;
+        if (n == 0 && remaining_ms(deadline, timeout_ms) == 0)
+            break;
+        done += n;
+    }
+    return done;
+}
+
+ssize_t UartTransport::write(const uint8_t *buf, size_t len, int timeout_ms) {
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    size_t done = 0;
+    while (done < len) {
+        ssize_t n = write_some(buf + done, len - done, remaining_ms(deadline, timeout_ms));
+        if (n < 0)
+            return -1;
+        if (n == 0 && remaining_ms(deadline, timeout_ms) == 0)
+            break;
+        done += n;
+    }
+    return done;
+}
+
+// ---------------------------------------------------------------- tty backend
+
+static speed_t baud_to_speed(int baud) {
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    case 230400: return B230400;
+    case 460800: return B460800;
+    case 500000: return B500000;
+    case 921600: return B921600;
+    case 1000000: return B1000000;
+    case 1500000: return B1500000;
+    case 2000000: return B2000000;
+    case 3000000: return B3000000;
+    case 4000000: return B4000000;
+    default: return B0;
+    }
+}
+
+TtyUartTransport::~TtyUartTransport() {
+    close();
+}
+
+bool TtyUartTransport::open(const std::string &path, int baud) {
+    close();
+
+    speed_t speed = baud_to_speed(baud);
+    if (speed == B0) {
+        std::cerr << "Unsupported baud rate " << baud << "\n";
+        return false;
+    }
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd_ < 0) {
+        std::cerr << "Failed to open " << path << ": " << strerror(errno) << "\n";
+        return false;
+    }
+
+    struct termios tio;
+    if (tcgetattr(fd_, &tio) < 0) {
+        std::cerr << path << " is not a tty: " << strerror(errno) << "\n";
+        close();
+        return false;
+    }
+
+    // 8N1, no flow control, no line discipline processing
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+
+    if (tcsetattr(fd_, TCSANOW, &tio) < 0) {
+        std::cerr << "Failed to configure " << path << ": " << strerror(errno) << "\n";
+        close();
+        return false;
+    }
+
+    tcflush(fd_, TCIOFLUSH);
+    path_ = path;
+    baud_ = baud;
+    return true;
+}
+
+bool TtyUartTransport::set_baud(int baud) {
+    speed_t speed = baud_to_speed(baud);
+    struct termios tio;
+    if (speed == B0 || tcgetattr(fd_, &tio) < 0)
+        return false;
+
+    tcdrain(fd_);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    if (tcsetattr(fd_, TCSANOW, &tio) < 0)
+        return false;
+    baud_ = baud;
+    return true;
+}
+
+void TtyUartTransport::close() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+ssize_t TtyUartTransport::read_some(uint8_t *buf, size_t len, int timeout_ms) {
+    while (true) {
+        ssize_t n = ::read(fd_, buf, len);
+        if (n > 0) {
+            rx_bytes_.fetch_add(n, std::memory_order_relaxed);
+            return n;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR)
+            return -1;
+
+        struct pollfd pfd = { fd_, POLLIN, 0 };
+        int r = poll(&pfd, 1, timeout_ms);
+        if (r == 0)
+            return 0;
+        if (r < 0 && errno != EINTR)
+            return -1;
+        if (pfd.revents & (POLLERR | POLLNVAL))
+            return -1;
+    }
+}
+
+ssize_t TtyUartTransport::write_some(const uint8_t *buf, size_t len, int timeout_ms) {
+    while (true) {
+        ssize_t n = ::write(fd_, buf, len);
+        if (n > 0) {
+            tx_bytes_.fetch_add(n, std::memory_order_relaxed);
+            return n;
+        }
+        if (n < 0 && errno != EAGAIN && errno != EINTR)
+            return -1;
+
+        struct pollfd pfd = { fd_, POLLOUT, 0 };
+        int r = poll(&pfd, 1, timeout_ms);
+        if (r == 0)
+            return 0;
+        if (r < 0 && errno != EINTR)
+            return -1;
+        if (pfd.revents & (POLLERR | POLLNVAL))
+            return -1;
+    }
+}
+
+void TtyUartTransport::flush_input() {
+    tcflush(fd_, TCIFLUSH);
+}
+
+// ----------------------------------------------------------- register backend
+
+bool RegisterUartTransport::open(uint32_t offset, int baud) {
+    base_ = uart_map(offset);
+    if (!base_)
+        return false;
+    uart_configure(base_, baud);
+    baud_ = baud;
+    return true;
+}
+
+bool RegisterUartTransport::set_baud(int baud) {
+    if (!uart_set_baud(base_, baud, Deadline::after_ms(UART_BUSY_TIMEOUT_MS)))
+        return false;
+    baud_ = baud;
+    return true;
+}
+
+ssize_t RegisterUartTransport::read_some(uint8_t *buf, size_t len, int timeout_ms) {
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+
+    // wait for RX FIFO not empty
+    while (base_[UART_FR / 4] & (1 << 4)) {
+        if (timeout_ms >= 0 && Clock::now() >= deadline)
+            return 0;
+    }
+
+    size_t n = 0;
+    while (n < len && !(base_[UART_FR / 4] & (1 << 4))) {
+        buf[n++] = base_[UART_DR / 4] & 0xFF;
+    }
+    rx_bytes_.fetch_add(n, std::memory_order_relaxed);
+    return n;
+}
+
+ssize_t RegisterUartTransport::write_some(const uint8_t *buf, size_t len, int timeout_ms) {
+    Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+
+    // wait for TX FIFO not full
+    while (base_[UART_FR / 4] & (1 << 5)) {
+        if (timeout_ms >= 0 && Clock::now() >= deadline)
+            return 0;
+    }
+
+    size_t n = 0;
+    while (n < len && !(base_[UART_FR / 4] & (1 << 5))) {
+        base_[UART_DR / 4] = buf[n++];
+    }
+    tx_bytes_.fetch_add(n, std::memory_order_relaxed);
+    return n;
+}
+
+void RegisterUartTransport::flush_input() {
+    while (!(base_[UART_FR / 4] & (1 << 4))) {
+        volatile uint32_t dummy = base_[UART_DR / 4];
+        (void)dummy;
+    }
+}
+
+// ------------------------------------------------------------------ pty pair
+
+bool open_pty_pair(PtyPair &pty) {
+    pty.master_fd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC);
+    if (pty.master_fd < 0)
+        return false;
+
+    if (grantpt(pty.master_fd) < 0 || unlockpt(pty.master_fd) < 0) {
+        close_pty_pair(pty);
+        return false;
+    }
+
+    char name[64];
+    if (ptsname_r(pty.master_fd, name, sizeof(name)) != 0) {
+        close_pty_pair(pty);
+        return false;
+    }
+    pty.slave_path = name;
+
+    // the STM side must see bytes unmodified too
+    struct termios tio;
+    tcgetattr(pty.master_fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(pty.master_fd, TCSANOW, &tio);
+    return true;
+}
+
+void close_pty_pair(PtyPair &pty) {
+    if (pty.master_fd >= 0) {
+        ::close(pty.master_fd);
+        pty.master_fd = -1;
+    }
+}
+
+// ----------------------------------------------------------- legacy exchange
+
+bool uart_send_pca_data(UartTransport &uart, const std::vector<int32_t> &pca_projection, int timeout_ms) {
+    std::vector<uint8_t> buf = { 'A', 'N', 'N', '-', 'E' };
+    for (int32_t v : pca_projection) {
+        buf.push_back((v >> 0) & 0xFF);
+        buf.push_back((v >> 8) & 0xFF);
+        buf.push_back((v >> 16) & 0xFF);
+        buf.push_back((v >> 24) & 0xFF);
+    }
+    return uart.write(buf.data(), buf.size(), timeout_ms) == static_cast<ssize_t>(buf.size());
+}
+
+bool uart_receive_int32s(UartTransport &uart, int32_t *out, int count, int timeout_ms) {
+    std::vector<uint8_t> bytes(count * 4);
+    if (uart.read(bytes.data(), bytes.size(), timeout_ms) != static_cast<ssize_t>(bytes.size()))
+        return false;
+
+    for (int i = 0; i < count; i++) {
+        out[i] = bytes[i * 4] | (bytes[i * 4 + 1] << 8) | (bytes[i * 4 + 2] << 16) | (bytes[i * 4 + 3] << 24);
+    }
+    return true;
+}
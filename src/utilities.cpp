@@ -1,4 +1,5 @@
 #include "utilities.h"
+#include "stb/stb_image_write.h"
 
 std::vector<std::vector<double>> loadMatrixCSV(const std::string& filename, int rows, int cols) {
     std::ifstream file(filename);
@@ -56,3 +57,18 @@ void writeVectorToCSV(const std::string& filename, const std::vector<double>& da
     file.close();
     std::cerr << "Vector written as column to " << filename << "\n";
 }
+
+static void append_bytes(void *context, void *data, int size) {
+    std::vector<uint8_t> *out = static_cast<std::vector<uint8_t> *>(context);
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    out->insert(out->end(), bytes, bytes + size);
+}
+
+bool encodeJPEG(const uint8_t *pixels, int width, int height, int quality, std::vector<uint8_t>& out) {
+    out.clear();
+    if (!stbi_write_jpg_to_func(append_bytes, &out, width, height, 1, pixels, quality)) {
+        std::cerr << "Failed to encode JPEG\n";
+        return false;
+    }
+    return true;
+}
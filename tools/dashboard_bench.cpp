@@ -0,0 +1,231 @@
+// Dashboard server check on localhost: starts a DashboardServer, connects
+// fast and slow clients that parse and validate every frame, and reports what
+// each received, the frames the drop policy discarded and how long
+// broadcast() held up the caller.
+//
+//   dashboard_bench.exe [--clients N] [--slow N] [--slow-delay-ms N]
+//                       [--frames N] [--rate HZ] [--raw-size BYTES]
+//                       [--policy oldest|newest|client] [--queue N]
+//   dashboard_bench.exe --connect HOST:PORT     (watch a running daemon)
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "dashboard_server.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct ClientResult {
+    uint64_t frames = 0;
+    uint64_t gaps = 0;          // frames skipped between two received ones
+    uint64_t errors = 0;        // malformed frames
+    bool disconnected = false;
+};
+
+static bool read_exact(int fd, uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = recv(fd, buf, len, 0);
+        if (n <= 0) return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+static uint64_t get_be64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; i++) v = (v << 8) | p[i];
+    return v;
+}
+
+// Split one frame body into its parts; false if the framing is inconsistent
+static bool parse_frame(const std::vector<uint8_t> &body, size_t &raw_len, size_t &processed_len,
+                        float softmax[DASHBOARD_SOFTMAX_SIZE]) {
+    if (body.size() < 8) return false;
+    raw_len = get_be64(body.data());
+    size_t pos = 8 + raw_len;
+    if (pos + 8 > body.size()) return false;
+    processed_len = get_be64(body.data() + pos);
+    pos += 8 + processed_len;
+    if (pos + 1 > body.size() || body[pos] != DASHBOARD_SOFTMAX_SIZE * sizeof(float)) return false;
+    pos++;
+    if (pos + DASHBOARD_SOFTMAX_SIZE * sizeof(float) + 1 != body.size() || body.back() != 0) return false;
+    std::memcpy(softmax, body.data() + pos, DASHBOARD_SOFTMAX_SIZE * sizeof(float));
+    return true;
+}
+
+static int connect_to(const std::string &host, int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+        std::cerr << "Failed to connect to " << host << ":" << port << "\n";
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// softmax[0] carries the frame number so gaps and reordering are visible
+static void run_client(int port, int delay_ms, std::atomic<bool> &done, ClientResult &result) {
+    int fd = connect_to("127.0.0.1", port);
+    if (fd < 0) {
+        result.disconnected = true;
+        return;
+    }
+    // keep the socket buffer small so a slow client backs up quickly
+    int rcvbuf = 64 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    int64_t last = -1;
+    std::vector<uint8_t> body;
+    while (!done) {
+        uint8_t size_buf[8];
+        if (!read_exact(fd, size_buf, 8)) {
+            result.disconnected = !done;
+            break;
+        }
+        body.resize(get_be64(size_buf));
+        if (!read_exact(fd, body.data(), body.size())) {
+            result.disconnected = !done;
+            break;
+        }
+        size_t raw_len, processed_len;
+        float softmax[DASHBOARD_SOFTMAX_SIZE];
+        if (!parse_frame(body, raw_len, processed_len, softmax)) {
+            result.errors++;
+            continue;
+        }
+        int64_t number = static_cast<int64_t>(softmax[0]);
+        if (body[8] != static_cast<uint8_t>(number) || number <= last) result.errors++;
+        if (last >= 0 && number > last + 1) result.gaps += number - last - 1;
+        last = number;
+        result.frames++;
+        if (delay_ms) std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    }
+    close(fd);
+}
+
+static int watch(const std::string &target) {
+    size_t colon = target.find(':');
+    std::string host = colon == std::string::npos ? target : target.substr(0, colon);
+    int port = colon == std::string::npos ? DASHBOARD_PORT : atoi(target.c_str() + colon + 1);
+    int fd = connect_to(host, port);
+    if (fd < 0) return 1;
+
+    std::vector<uint8_t> body;
+    while (true) {
+        uint8_t size_buf[8];
+        if (!read_exact(fd, size_buf, 8)) break;
+        body.resize(get_be64(size_buf));
+        if (!read_exact(fd, body.data(), body.size())) break;
+        size_t raw_len, processed_len;
+        float softmax[DASHBOARD_SOFTMAX_SIZE];
+        if (!parse_frame(body, raw_len, processed_len, softmax)) {
+            std::cerr << "Malformed frame of " << body.size() << " bytes\n";
+            continue;
+        }
+        int digit = std::max_element(softmax, softmax + DASHBOARD_SOFTMAX_SIZE) - softmax;
+        std::cout << "digit " << digit << " (" << softmax[digit] << "), raw " << raw_len
+                  << " B, processed " << processed_len << " B\n";
+    }
+    std::cerr << "Connection closed\n";
+    close(fd);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int clients = 4;
+    int slow = 1;
+    int slow_delay_ms = 200;
+    int frames = 200;
+    int rate = 50;
+    size_t raw_size = 300 * 1024;
+    DashboardConfig config;
+    config.bind_address = "127.0.0.1";
+    config.port = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--connect" && has_value) return watch(argv[++i]);
+        else if (arg == "--clients" && has_value) clients = atoi(argv[++i]);
+        else if (arg == "--slow" && has_value) slow = atoi(argv[++i]);
+        else if (arg == "--slow-delay-ms" && has_value) slow_delay_ms = atoi(argv[++i]);
+        else if (arg == "--frames" && has_value) frames = atoi(argv[++i]);
+        else if (arg == "--rate" && has_value) rate = atoi(argv[++i]);
+        else if (arg == "--raw-size" && has_value) raw_size = atoi(argv[++i]);
+        else if (arg == "--queue" && has_value) config.queue_frames = atoi(argv[++i]);
+        else if (arg == "--policy" && has_value) {
+            std::string policy = argv[++i];
+            config.policy = policy == "newest" ? DROP_NEWEST : policy == "client" ? DROP_CLIENT : DROP_OLDEST;
+        } else {
+            std::cerr << "Unknown argument " << arg << "\n";
+            return 1;
+        }
+    }
+
+    DashboardServer server;
+    if (!server.start(config)) return 1;
+
+    std::atomic<bool> done{false};
+    std::vector<ClientResult> results(clients);
+    std::vector<std::thread> threads;
+    for (int c = 0; c < clients; c++) {
+        int delay = c < slow ? slow_delay_ms : 0;
+        threads.emplace_back(run_client, server.port(), delay, std::ref(done), std::ref(results[c]));
+    }
+    while ((int)server.stats().clients < clients)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    std::vector<double> broadcast_us;
+    auto interval = std::chrono::microseconds(1000000 / std::max(rate, 1));
+    auto next = Clock::now();
+    for (int f = 0; f < frames; f++) {
+        auto frame = std::make_shared<DashboardFrame>();
+        frame->raw_jpg.assign(raw_size, static_cast<uint8_t>(f));
+        frame->processed_jpg.assign(600, static_cast<uint8_t>(f));
+        frame->softmax[0] = f;
+        frame->finish();
+
+        auto t0 = Clock::now();
+        server.broadcast(std::move(frame));
+        broadcast_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+
+        next += interval;
+        std::this_thread::sleep_until(next);
+    }
+    // let the fast clients drain
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    done = true;
+    DashboardStats stats = server.stats();
+    server.stop();
+    for (std::thread &t : threads) t.join();
+
+    std::sort(broadcast_us.begin(), broadcast_us.end());
+    std::cout << "frames " << frames << " at " << rate << " Hz, " << raw_size << " B raw\n";
+    std::cout << "broadcast(): median " << broadcast_us[broadcast_us.size() / 2]
+              << " us, max " << broadcast_us.back() << " us\n";
+    for (int c = 0; c < clients; c++) {
+        std::cout << "client " << c << (c < slow ? " (slow)" : "       ")
+                  << ": received " << results[c].frames << ", skipped " << results[c].gaps
+                  << ", errors " << results[c].errors
+                  << (results[c].disconnected ? ", disconnected" : "") << "\n";
+    }
+    std::cout << "server: sent " << stats.frames_sent << ", dropped " << stats.frames_dropped
+              << ", clients dropped " << stats.clients_dropped << "\n";
+    return 0;
+}
@@ -0,0 +1,166 @@
+// Submit images to the inference service over its Unix socket.
+//
+//   infer_client.exe [--socket PATH] image.jpg [image.png ...]
+//   infer_client.exe --random N [--window W] [--deadline-ms MS]
+//
+// Image files are sent as encoded input and go through the full preprocessing
+// pipeline; --random sends N random 24x24 inputs, keeping up to W requests
+// outstanding, and reports throughput, latency and the batch sizes the
+// service formed.
+
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "inference_service.h"
+
+using Clock = std::chrono::steady_clock;
+
+static bool write_all(int fd, const void *data, size_t len) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void *data, size_t len) {
+    uint8_t *p = static_cast<uint8_t *>(data);
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool send_request(int fd, uint32_t id, int input, const std::vector<uint8_t> &payload, int deadline_ms) {
+    InferenceRequestHeader header = {};
+    header.magic = INFERENCE_REQUEST_MAGIC;
+    header.id = id;
+    header.input = input;
+    header.deadline_ms = deadline_ms;
+    header.payload_len = payload.size();
+    return write_all(fd, &header, sizeof(header)) && write_all(fd, payload.data(), payload.size());
+}
+
+static const char *status_name(int status) {
+    switch (status) {
+    case INFER_OK: return "ok";
+    case INFER_BAD_REQUEST: return "bad request";
+    case INFER_DECODE_FAILED: return "decode failed";
+    case INFER_BUSY: return "busy";
+    case INFER_TIMEOUT: return "timeout";
+    default: return "failed";
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string socket_path = INFERENCE_SOCKET_PATH;
+    std::vector<std::string> files;
+    int random_count = 0;
+    int window = 16;
+    int deadline_ms = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--socket" && has_value) socket_path = argv[++i];
+        else if (arg == "--random" && has_value) random_count = atoi(argv[++i]);
+        else if (arg == "--window" && has_value) window = std::max(1, atoi(argv[++i]));
+        else if (arg == "--deadline-ms" && has_value) deadline_ms = atoi(argv[++i]);
+        else files.push_back(arg);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+        std::cerr << "Failed to connect to " << socket_path << "\n";
+        return 1;
+    }
+
+    // one request per image file, answered in any order
+    if (random_count == 0) {
+        for (size_t i = 0; i < files.size(); i++) {
+            std::ifstream in(files[i], std::ios::binary);
+            std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+            if (data.empty() || !send_request(fd, i, INPUT_ENCODED, data, deadline_ms)) {
+                std::cerr << "Failed to send " << files[i] << "\n";
+                return 1;
+            }
+        }
+        for (size_t i = 0; i < files.size(); i++) {
+            InferenceReply reply;
+            if (!read_all(fd, &reply, sizeof(reply))) return 1;
+            std::cout << files[reply.id] << ": " << status_name(reply.status);
+            if (reply.status == INFER_OK) {
+                int digit = std::max_element(reply.softmax, reply.softmax + SOFTMAX_SIZE) - reply.softmax;
+                std::cout << ", digit " << digit << " (" << reply.softmax[digit] << ")";
+            }
+            std::cout << ", " << reply.latency_us << " us\n";
+        }
+        close(fd);
+        return 0;
+    }
+
+    std::mt19937 rng(1);
+    std::vector<uint8_t> pixels(INFERENCE_PIXELS);
+    std::map<uint32_t, Clock::time_point> outstanding;
+    std::vector<double> rtt_us;
+    std::map<int, int> statuses;
+    uint64_t batch_sum = 0;
+    uint32_t batch_max = 0;
+    int sent = 0, received = 0;
+
+    auto start = Clock::now();
+    while (received < random_count) {
+        while (sent < random_count && (int)outstanding.size() < window) {
+            for (uint8_t &p : pixels) p = rng() & 0xFF;
+            outstanding[sent] = Clock::now();
+            if (!send_request(fd, sent, INPUT_PIXELS, pixels, deadline_ms)) return 1;
+            sent++;
+        }
+        InferenceReply reply;
+        if (!read_all(fd, &reply, sizeof(reply)) || reply.magic != INFERENCE_REPLY_MAGIC) {
+            std::cerr << "Connection lost\n";
+            return 1;
+        }
+        auto it = outstanding.find(reply.id);
+        if (it != outstanding.end()) {
+            rtt_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - it->second).count());
+            outstanding.erase(it);
+        }
+        statuses[reply.status]++;
+        batch_sum += reply.batch_size;
+        batch_max = std::max(batch_max, reply.batch_size);
+        received++;
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    close(fd);
+
+    std::sort(rtt_us.begin(), rtt_us.end());
+    std::cout << received << " requests, window " << window << ": " << received / seconds << " /s\n";
+    std::cout << "round trip: p50 " << rtt_us[rtt_us.size() / 2] << " us, p99 "
+              << rtt_us[std::min(rtt_us.size() - 1, rtt_us.size() * 99 / 100)] << " us\n";
+    std::cout << "batch size: mean " << (double)batch_sum / received << ", max " << batch_max << "\n";
+    for (auto &entry : statuses)
+        std::cout << status_name(entry.first) << ": " << entry.second << "\n";
+    return 0;
+}
@@ -0,0 +1,173 @@
+// Link benchmark: throughput, round-trip latency percentiles and error rate of
+// the framed STM protocol, against real hardware or a pty loopback stand-in.
+//
+//   link_bench.exe --pty [--delay-us N] [--corrupt P]
+//   link_bench.exe --uart /dev/ttyAMA1 [--baud N] [--negotiate]
+//   common: --count N --size BYTES --window N [--infer]
+//
+// --infer sends coefficient frames instead of echo frames, so the STM's
+// evaluation time (or --delay-us on the stand-in) is part of the round trip.
+// A pty moves bytes as fast as the host can, whatever the baud rate, so --pty
+// also prints what the same bytes would take on a wire at that rate.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+#include "uart_transport.h"
+#include "stm_link.h"
+#include "fake_stm.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double percentile(std::vector<double> &v, double p) {
+    if (v.empty())
+        return 0.0;
+    size_t idx = std::min(v.size() - 1, static_cast<size_t>(p * (v.size() - 1) + 0.5));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+int main(int argc, char **argv) {
+    bool use_pty = false;
+    bool negotiate = false;
+    bool infer = false;
+    std::string device = UART_DEFAULT_DEVICE;
+    int baud = UART_DEFAULT_BAUD;
+    int count = 1000;
+    size_t size = 64;
+    int window = 1;
+    int timeout_ms = 500;
+    FakeStmConfig fake;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--pty") use_pty = true;
+        else if (arg == "--negotiate") negotiate = true;
+        else if (arg == "--infer") infer = true;
+        else if (arg == "--uart" && has_value) device = argv[++i];
+        else if (arg == "--baud" && has_value) baud = atoi(argv[++i]);
+        else if (arg == "--count" && has_value) count = atoi(argv[++i]);
+        else if (arg == "--size" && has_value) size = atoi(argv[++i]);
+        else if (arg == "--window" && has_value) window = atoi(argv[++i]);
+        else if (arg == "--timeout-ms" && has_value) timeout_ms = atoi(argv[++i]);
+        else if (arg == "--delay-us" && has_value) fake.infer_delay_us = atoi(argv[++i]);
+        else if (arg == "--corrupt" && has_value) fake.corrupt_probability = atof(argv[++i]);
+        else {
+            std::cerr << "unknown argument " << arg << "\n";
+            return 1;
+        }
+    }
+    size = std::min<size_t>(size, STM_MAX_PAYLOAD);
+
+    PtyPair pty;
+    FakeStm stm;
+    TtyUartTransport uart;
+    if (use_pty) {
+        if (!open_pty_pair(pty) || !stm.start(pty.master_fd, fake)) {
+            std::cerr << "Failed to set up pty stand-in\n";
+            return 1;
+        }
+        device = pty.slave_path;
+    }
+    if (!uart.open(device, baud))
+        return 1;
+
+    StmLink link(uart, window);
+    if (!link.negotiate(timeout_ms)) {
+        std::cerr << "No HELLO reply from " << device << "\n";
+        return 1;
+    }
+    if (negotiate)
+        link.negotiate_baud(STM_BAUD_CANDIDATES, timeout_ms);
+
+    std::vector<uint8_t> payload(size);
+    for (size_t i = 0; i < size; i++)
+        payload[i] = static_cast<uint8_t>(i * 31 + 7);
+    std::vector<double> coefficients(12, 0.0);
+    for (size_t i = 0; i < coefficients.size(); i++)
+        coefficients[i] = 0.05 * (static_cast<int>(i) - 6);
+
+    std::map<uint16_t, Clock::time_point> sent_at;
+    std::vector<double> rtt_us;
+    int sent = 0, failed = 0;
+    uint64_t rx0 = uart.rx_bytes(), tx0 = uart.tx_bytes();
+    Clock::time_point start = Clock::now();
+
+    while (sent < count || !sent_at.empty()) {
+        while (sent < count && !link.window_full()) {
+            int seq = infer ? link.send_coefficients(coefficients, timeout_ms)
+                            : link.send(STM_MSG_ECHO, payload.data(), payload.size(), timeout_ms);
+            if (seq < 0) {
+                failed++;
+                sent++;
+                continue;
+            }
+            sent_at[seq] = Clock::now();
+            sent++;
+        }
+
+        link.poll(timeout_ms);
+        Clock::time_point now = Clock::now();
+
+        StmFrame reply;
+        while (link.take_any(reply)) {
+            auto it = sent_at.find(reply.sequence);
+            if (it == sent_at.end())
+                continue;
+            std::vector<double> softmax;
+            bool ok = infer ? StmLink::decode_softmax(reply, softmax)
+                            : reply.type == STM_MSG_ECHO_REPLY && reply.payload == payload;
+            if (ok)
+                rtt_us.push_back(std::chrono::duration<double, std::micro>(now - it->second).count());
+            else
+                failed++;
+            sent_at.erase(it);
+        }
+
+        // anything outstanding for longer than the timeout is lost
+        for (auto it = sent_at.begin(); it != sent_at.end();) {
+            if (now - it->second > std::chrono::milliseconds(timeout_ms)) {
+                link.cancel(it->first);
+                failed++;
+                it = sent_at.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    uint64_t rx = uart.rx_bytes() - rx0, tx = uart.tx_bytes() - tx0;
+
+    std::cout << "link:        " << device << " @ " << uart.baud() << " baud, protocol v" << link.peer_version() << "\n";
+    if (infer)
+        std::cout << "frames:      " << count << " inferences, " << (link.packed() ? "packed" : "int32")
+                  << " encoding, window " << window << "\n";
+    else
+        std::cout << "frames:      " << count << " x " << size << " B payload, window " << window << "\n";
+    std::cout << "throughput:  tx " << static_cast<uint64_t>(tx / seconds) << " B/s, rx "
+              << static_cast<uint64_t>(rx / seconds) << " B/s, " << static_cast<uint64_t>(rtt_us.size() / seconds)
+              << " round trips/s\n";
+    if (use_pty) {
+        // 8N1: ten bit times per byte, each direction on its own wire
+        double wire_s = std::max(tx, rx) * 10.0 / uart.baud();
+        std::cout << "wire:        the pty ignores the baud rate; at " << uart.baud() << " baud these bytes need "
+                  << wire_s << " s, at most " << static_cast<uint64_t>(rtt_us.size() / std::max(seconds, wire_s))
+                  << " round trips/s\n";
+    }
+    std::cout << "rtt (us):    p50 " << percentile(rtt_us, 0.50) << ", p90 " << percentile(rtt_us, 0.90)
+              << ", p99 " << percentile(rtt_us, 0.99) << ", max " << percentile(rtt_us, 1.0) << "\n";
+    std::cout << "errors:      " << failed << " failed (" << 100.0 * failed / std::max(count, 1) << "%), "
+              << link.parser().crc_errors() << " CRC errors, " << link.parser().dropped_bytes() << " bytes dropped\n";
+
+    uart.close();
+    stm.stop();
+    close_pty_pair(pty);
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,249 @@
+// Open-loop load for a running main.exe, e.g. one started with --sim.
+//
+//   load_gen.exe --button FIFO [--rate HZ] [--seconds S] [--drain S] [--telemetry DIR]
+//   load_gen.exe --socket PATH [--rate HZ] [--seconds S] [--deadline-ms MS]
+//
+// Requests go out on a fixed schedule whether or not earlier ones have been
+// answered, and latency is counted from when each one was due, so a stalled
+// daemon shows up as latency instead of as a slower sender.
+//
+// --button writes presses to the daemon's --button-pipe and reads the results
+// back from its telemetry segments: press to published result, per outcome.
+// --socket sends random 24x24 inputs to the inference service and times the
+// replies.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+
+#include "inference_service.h"
+#include "telemetry.h"
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+}
+
+// Returns false if the sleep failed for any reason but a signal
+static bool sleep_until(uint64_t ns) {
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000ull;
+    ts.tv_nsec = ns % 1000000000ull;
+    int err;
+    while ((err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr)) == EINTR) {}
+    if (err != 0) {
+        std::cerr << "clock_nanosleep failed: " << strerror(err) << "\n";
+        return false;
+    }
+    return true;
+}
+
+static void print_latency(const char *label, std::vector<double> &v) {
+    std::cout << label;
+    if (v.empty()) {
+        std::cout << " -\n";
+        return;
+    }
+    std::sort(v.begin(), v.end());
+    auto at = [&](double q) { return v[std::min(v.size() - 1, (size_t)(q * v.size()))]; };
+    std::cout << std::fixed << std::setprecision(2)
+              << " p50 " << at(0.50) << "  p90 " << at(0.90) << "  p99 " << at(0.99)
+              << "  max " << v.back() << " ms\n";
+}
+
+// ------------------------------------------------------------------ button
+
+static int run_button(const std::string &fifo, double rate, double seconds, double drain_s, const std::string &dir) {
+    // the daemon holds the FIFO open, so this does not block
+    int fd = open(fifo.c_str(), O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Cannot open " << fifo << " (is main.exe running with --button-pipe or --sim?)\n";
+        return 1;
+    }
+
+    uint64_t interval = static_cast<uint64_t>(1e9 / rate);
+    uint64_t count = static_cast<uint64_t>(rate * seconds);
+    uint64_t start = now_ns() + 10000000ull;
+    std::set<uint64_t> sent;
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t due = start + i * interval;
+        if (!sleep_until(due)) break;
+        if (write(fd, &due, sizeof(due)) != sizeof(due)) {
+            std::cerr << "Press " << i << " not written, the FIFO is full\n";
+            continue;
+        }
+        sent.insert(due);
+    }
+    close(fd);
+    double sent_s = (now_ns() - start) / 1e9;
+
+    // whatever is still in flight finishes or times out within the deadline
+    sleep_until(now_ns() + static_cast<uint64_t>(drain_s * 1e9));
+
+    TelemetrySegments collected;
+    for (const std::string &file : segment_files(dir, TELEMETRY_PREFIX))
+        segment_for_each(file, telemetry_collect, &collected);
+    const std::vector<TelemetryRecord> &all = collected.records;
+
+    std::map<int, uint64_t> statuses;
+    std::vector<double> ok, timed_out;
+    uint64_t found = 0;
+    for (const TelemetryRecord &r : all) {
+        if (r.source != TELEMETRY_BUTTON || !sent.count(r.stamp_ns[STAMP_START])) continue;
+        found++;
+        statuses[r.status]++;
+        if (!r.stamp_ns[STAMP_PUBLISHED]) continue;
+        double ms = (r.stamp_ns[STAMP_PUBLISHED] - r.stamp_ns[STAMP_START]) / 1e6;
+        (r.status == INFER_OK ? ok : timed_out).push_back(ms);
+    }
+
+    std::cout << sent.size() << " presses at " << rate << " /s over " << std::fixed << std::setprecision(1)
+              << sent_s << " s, " << found << " in telemetry, " << sent.size() - found << " missing\n";
+    std::cout << "completed " << std::setprecision(1) << ok.size() / sent_s << " /s\n";
+    for (auto &entry : statuses)
+        std::cout << "  " << std::left << std::setw(14) << inference_status_name(entry.first) << std::right << entry.second << "\n";
+    print_latency("press to result (ok):", ok);
+    print_latency("press to result (late):", timed_out);
+    return 0;
+}
+
+// ------------------------------------------------------------------ socket
+
+static bool write_all(int fd, const void *data, size_t len) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void *data, size_t len) {
+    uint8_t *p = static_cast<uint8_t *>(data);
+    while (len > 0) {
+        ssize_t n = recv(fd, p, len, 0);
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static int run_socket(const std::string &path, double rate, double seconds, int deadline_ms) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) < 0) {
+        std::cerr << "Failed to connect to " << path << "\n";
+        return 1;
+    }
+
+    uint32_t count = static_cast<uint32_t>(rate * seconds);
+    uint64_t interval = static_cast<uint64_t>(1e9 / rate);
+    uint64_t start = now_ns() + 10000000ull;
+    std::vector<uint64_t> due(count);
+    for (uint32_t i = 0; i < count; i++) due[i] = start + i * interval;
+
+    // a reply that never comes ends the run instead of hanging it
+    struct timeval tv;
+    tv.tv_sec = interval / 1000000000ull + 5;
+    tv.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    // replies come back on their own thread so a slow one never delays the schedule
+    std::map<int, uint64_t> statuses;
+    std::vector<double> rtt_ms;
+    uint32_t received = 0;
+    std::thread receiver([&] {
+        InferenceReply reply;
+        while (received < count && read_all(fd, &reply, sizeof(reply)) && reply.magic == INFERENCE_REPLY_MAGIC) {
+            uint64_t now = now_ns();
+            statuses[reply.status]++;
+            if (reply.status == INFER_OK && reply.id < count) rtt_ms.push_back((now - due[reply.id]) / 1e6);
+            received++;
+        }
+    });
+
+    std::mt19937 rng(1);
+    std::vector<uint8_t> pixels(INFERENCE_PIXELS);
+    InferenceRequestHeader header = {};
+    header.magic = INFERENCE_REQUEST_MAGIC;
+    header.input = INPUT_PIXELS;
+    header.deadline_ms = deadline_ms;
+    header.payload_len = pixels.size();
+    uint32_t sent = 0;
+    for (; sent < count; sent++) {
+        for (uint8_t &p : pixels) p = rng() & 0xFF;
+        header.id = sent;
+        if (!sleep_until(due[sent])) break;
+        if (!write_all(fd, &header, sizeof(header)) || !write_all(fd, pixels.data(), pixels.size())) {
+            std::cerr << "Connection lost after " << sent << " requests\n";
+            break;
+        }
+    }
+    double sent_s = (now_ns() - start) / 1e9;
+    // the receiver stops after the last reply; a lost connection ends it too
+    if (sent < count) shutdown(fd, SHUT_RDWR);
+    receiver.join();
+    close(fd);
+
+    std::cout << sent << " requests at " << rate << " /s over " << std::fixed << std::setprecision(1)
+              << sent_s << " s, " << received << " answered\n";
+    for (auto &entry : statuses)
+        std::cout << "  " << std::left << std::setw(14) << inference_status_name(entry.first) << std::right << entry.second << "\n";
+    print_latency("round trip (ok):", rtt_ms);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    std::string fifo;
+    std::string socket_path;
+    std::string telemetry_dir = TELEMETRY_DIR;
+    double rate = 10;
+    double seconds = 10;
+    double drain_s = 3;
+    int deadline_ms = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--button" && has_value) fifo = argv[++i];
+        else if (arg == "--socket" && has_value) socket_path = argv[++i];
+        else if (arg == "--rate" && has_value) rate = atof(argv[++i]);
+        else if (arg == "--seconds" && has_value) seconds = atof(argv[++i]);
+        else if (arg == "--drain" && has_value) drain_s = atof(argv[++i]);
+        else if (arg == "--telemetry" && has_value) telemetry_dir = argv[++i];
+        else if (arg == "--deadline-ms" && has_value) deadline_ms = atoi(argv[++i]);
+        else {
+            fifo.clear();
+            socket_path.clear();
+            break;
+        }
+    }
+    if ((fifo.empty() == socket_path.empty()) || rate <= 0 || seconds <= 0) {
+        std::cerr << "Usage: " << argv[0] << " --button FIFO [--rate HZ] [--seconds S] [--drain S] [--telemetry DIR]\n"
+                  << "       " << argv[0] << " --socket PATH [--rate HZ] [--seconds S] [--deadline-ms MS]\n";
+        return 1;
+    }
+    if (!fifo.empty()) return run_button(fifo, rate, seconds, drain_s, telemetry_dir);
+    return run_socket(socket_path, rate, seconds, deadline_ms);
+}
@@ -0,0 +1,148 @@
+// Preprocessing benchmark: runs a stage list on replayed captures planned
+// twice, fused and with every stage in a pass of its own, checks that both
+// give the same PCA input and reports the time per frame of each. Use it to
+// compare stage lists before putting one on a unit.
+//
+//   preprocess_bench.exe [--config data/preprocess.csv] [--images PATH]
+//                        [--size 1440] [--runs N] [--taps NAME,...|all]
+//
+// --images is one image or a directory of .jpg/.png files, as for --sim-camera.
+// --taps copies those stage outputs on every frame, as a tap would, and also
+// checks that the fused plan's copies match the unfused plan's.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+#include "preprocess_graph.h"
+#include "camera_source.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double percentile(std::vector<double> &v, double p) {
+    if (v.empty())
+        return 0.0;
+    size_t idx = std::min(v.size() - 1, static_cast<size_t>(p * (v.size() - 1) + 0.5));
+    std::nth_element(v.begin(), v.begin() + idx, v.end());
+    return v[idx];
+}
+
+struct Result {
+    std::vector<double> ms;
+    std::vector<std::vector<uint8_t>> outputs;     // one per frame
+    std::vector<std::vector<TapImage>> taps;
+};
+
+// Stage bits for tap names (the two plans number their stages the same)
+static uint64_t tap_mask(const PreprocessPlan &plan, const std::string &list) {
+    uint64_t mask = 0;
+    std::stringstream listStream(list);
+    std::string name;
+    while (getline(listStream, name, ',')) {
+        for (size_t i = 0; i < plan.taps.size(); i++) {
+            if (name == "all" || name == plan.taps[i]) mask |= 1ull << i;
+        }
+    }
+    return mask;
+}
+
+static Result run(const std::shared_ptr<const PreprocessPlan> &plan, const std::vector<std::vector<uint8_t>> &frames,
+                  int size, int runs, uint64_t taps) {
+    Result result;
+    PreprocessWorkspace workspace;
+    std::vector<uint8_t> out;
+    BoundingBox bbox;
+    PipelineImages images;
+    images.tap_mask = taps;
+    images.tap_plan = plan->version;
+    result.outputs.resize(frames.size());
+    result.taps.resize(frames.size());
+    for (int r = 0; r < runs; r++) {
+        for (size_t f = 0; f < frames.size(); f++) {
+            auto start = Clock::now();
+            workspace.run(plan, frames[f], size, size, out, &bbox, Deadline::never(), taps ? &images : nullptr);
+            result.ms.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+            result.outputs[f] = out;
+            result.taps[f] = images.taps;
+        }
+    }
+    return result;
+}
+
+static void report(const char *name, const PreprocessPlan &plan, Result &result) {
+    std::cout << std::left << std::setw(8) << name << std::right << std::setw(3) << plan.passes.size() << " passes"
+              << std::fixed << std::setprecision(2)
+              << "  p50 " << std::setw(7) << percentile(result.ms, 0.50)
+              << "  p99 " << std::setw(7) << percentile(result.ms, 0.99) << " ms\n";
+}
+
+int main(int argc, char **argv) {
+    std::string config = PREPROCESS_CONFIG_PATH;
+    std::string images = "./data/720p_test_8.jpg";
+    int size = PREPROCESS_CHECK_SIZE;
+    int runs = 20;
+    std::string taps;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--config" && has_value) config = argv[++i];
+        else if (arg == "--images" && has_value) images = argv[++i];
+        else if (arg == "--size" && has_value) size = atoi(argv[++i]);
+        else if (arg == "--runs" && has_value) runs = atoi(argv[++i]);
+        else if (arg == "--taps" && has_value) taps = argv[++i];
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--config PATH] [--images PATH] [--size N] [--runs N]"
+                      << " [--taps NAME,...]\n";
+            return 1;
+        }
+    }
+
+    ReplayCamera camera;
+    if (!camera.open(images, size, size))
+        return 1;
+    std::vector<std::vector<uint8_t>> frames(camera.frames());
+    for (std::vector<uint8_t> &frame : frames)
+        camera.capture(frame, Deadline::never());
+
+    auto fused = std::static_pointer_cast<const PreprocessPlan>(load_preprocess_plan(config, true));
+    auto unfused = std::static_pointer_cast<const PreprocessPlan>(load_preprocess_plan(config, false));
+    if (!fused || !unfused)
+        return 1;
+
+    uint64_t mask = tap_mask(*fused, taps);
+    if (!taps.empty() && !mask) {
+        std::cerr << "No such taps; the plan has:";
+        for (const std::string &name : fused->taps) std::cerr << " " << name;
+        std::cerr << "\n";
+        return 1;
+    }
+
+    std::cout << frames.size() << " frames of " << size << "x" << size << ", " << runs << " runs";
+    if (mask) std::cout << ", tapping " << __builtin_popcountll(mask) << " stages";
+    std::cout << "\n";
+    Result a = run(unfused, frames, size, runs, mask);
+    Result b = run(fused, frames, size, runs, mask);
+    report("unfused", *unfused, a);
+    report("fused", *fused, b);
+
+    size_t differ = 0;
+    for (size_t f = 0; f < frames.size(); f++) {
+        bool same = a.outputs[f] == b.outputs[f] && a.taps[f].size() == b.taps[f].size();
+        for (size_t t = 0; same && t < a.taps[f].size(); t++) {
+            same = a.taps[f][t].width == b.taps[f][t].width && a.taps[f][t].height == b.taps[f][t].height &&
+                   a.taps[f][t].pixels == b.taps[f][t].pixels;
+        }
+        differ += !same;
+    }
+    if (differ) {
+        std::cout << differ << " of " << frames.size() << " frames differ between the two\n";
+        return 1;
+    }
+    std::cout << "outputs identical\n";
+    return 0;
+}
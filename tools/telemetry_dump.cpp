@@ -0,0 +1,217 @@
+// Read the telemetry segments written by main.exe.
+//
+//   telemetry_dump.exe [--records] [--last N] [--source button|socket] [DIR | segment.bin ...]
+//
+// Prints a summary of every record found: outcomes, where requests ran out of
+// time, per-stage latency percentiles, per-board link latency and CRC errors,
+// how often each digit was recognized, and the temperature, clock and
+// throttling samples with latency per thermal level. --records also prints
+// one line per record; --last N only looks at the N most recent records.
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cstdlib>
+#include <sys/stat.h>
+
+#include "inference_service.h"
+#include "telemetry.h"
+#include "thermal_monitor.h"
+
+static const char *source_name(int source) {
+    return source == TELEMETRY_BUTTON ? "button" : source == TELEMETRY_SOCKET ? "socket" : "unknown";
+}
+
+static const char *level_name(int level) {
+    return level == THERMAL_NORMAL ? "normal" : level == THERMAL_WARM ? "warm" : level == THERMAL_HOT ? "hot" : "unknown";
+}
+
+// Milliseconds between two stamps, or -1 if either is missing
+static double span_ms(const TelemetryRecord &r, int from, int to) {
+    if (!r.stamp_ns[from] || !r.stamp_ns[to] || r.stamp_ns[to] < r.stamp_ns[from]) return -1.0;
+    return (r.stamp_ns[to] - r.stamp_ns[from]) / 1e6;
+}
+
+static void print_percentiles(const char *label, std::vector<double> &v) {
+    std::cout << "  " << std::left << std::setw(14) << label << std::right;
+    if (v.empty()) {
+        std::cout << "-\n";
+        return;
+    }
+    std::sort(v.begin(), v.end());
+    auto at = [&](double q) { return v[std::min(v.size() - 1, (size_t)(q * v.size()))]; };
+    std::cout << std::fixed << std::setprecision(2)
+              << "n " << std::setw(6) << v.size()
+              << "  p50 " << std::setw(8) << at(0.50)
+              << "  p90 " << std::setw(8) << at(0.90)
+              << "  p99 " << std::setw(8) << at(0.99)
+              << "  max " << std::setw(8) << v.back() << " ms\n";
+}
+
+static void print_record(const TelemetryRecord &r) {
+    std::cout << r.seq << " " << source_name(r.source) << " " << inference_status_name(r.status);
+    if (r.timeout_stage >= 0) std::cout << "@" << stage_name(r.timeout_stage);
+    std::cout << " board " << (int)r.board << " digit " << (int)r.digit;
+    if (r.digit >= 0) std::cout << " (" << std::fixed << std::setprecision(3) << r.softmax[r.digit] / 65535.0 << ")";
+    std::cout << " total " << std::setprecision(2) << span_ms(r, STAMP_START, STAMP_PUBLISHED)
+              << " link " << r.link_latency_us << "us x" << (int)r.attempts
+              << " batch " << (int)r.batch_size
+              << " bbox " << r.bbox[0] << "," << r.bbox[1] << "," << r.bbox[2] << "," << r.bbox[3] << "\n";
+}
+
+int main(int argc, char **argv) {
+    bool records = false;
+    long last = 0;
+    int source = 0;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--records") records = true;
+        else if (arg == "--last" && i + 1 < argc) last = atol(argv[++i]);
+        else if (arg == "--source" && i + 1 < argc) {
+            std::string s = argv[++i];
+            source = s == "button" ? TELEMETRY_BUTTON : s == "socket" ? TELEMETRY_SOCKET : -1;
+        } else if (arg[0] == '-') {
+            std::cerr << "Usage: " << argv[0] << " [--records] [--last N] [--source button|socket] [DIR | segment.bin ...]\n";
+            return 1;
+        } else {
+            struct stat st;
+            if (stat(arg.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+                std::vector<std::string> found = segment_files(arg, TELEMETRY_PREFIX);
+                files.insert(files.end(), found.begin(), found.end());
+            } else {
+                files.push_back(arg);
+            }
+        }
+    }
+    if (files.empty()) files = segment_files(TELEMETRY_DIR, TELEMETRY_PREFIX);
+    if (files.empty()) {
+        std::cerr << "No telemetry segments found\n";
+        return 1;
+    }
+
+    TelemetrySegments collected;
+    for (const std::string &file : files) {
+        if (!segment_for_each(file, telemetry_collect, &collected))
+            std::cerr << "Skipping " << file << ": not a segment\n";
+    }
+    std::vector<TelemetryRecord> &all = collected.records;
+    std::vector<ThermalRecord> &thermal = collected.thermal;
+    if (source) {
+        all.erase(std::remove_if(all.begin(), all.end(),
+                                 [&](const TelemetryRecord &r) { return r.source != source; }), all.end());
+    }
+    if (last > 0 && (size_t)last < all.size())
+        all.erase(all.begin(), all.end() - last);
+    if (last > 0 && !all.empty()) {
+        uint64_t since = all.front().stamp_ns[STAMP_START];
+        thermal.erase(std::remove_if(thermal.begin(), thermal.end(),
+                                     [&](const ThermalRecord &t) { return t.stamp_ns < since; }), thermal.end());
+    }
+
+    std::map<int, uint64_t> statuses;
+    uint64_t timeouts[STAGE_COUNT] = {};
+    std::vector<double> capture, preprocess, queue, link, publish, total;
+    std::vector<double> total_by_level[THERMAL_LEVEL_COUNT];
+    struct BoardSummary { uint64_t answered = 0; double latency_us = 0; uint32_t crc_errors = 0; uint64_t retried = 0; };
+    std::map<int, BoardSummary> boards;
+    uint64_t digits[TELEMETRY_SOFTMAX] = {};
+    double confidence[TELEMETRY_SOFTMAX] = {};
+
+    for (const TelemetryRecord &r : all) {
+        if (records) print_record(r);
+        statuses[r.status]++;
+        if (r.timeout_stage >= 0 && r.timeout_stage < STAGE_COUNT) timeouts[r.timeout_stage]++;
+
+        double v;
+        if ((v = span_ms(r, STAMP_START, STAMP_CAPTURED)) >= 0) capture.push_back(v);
+        int from = r.stamp_ns[STAMP_CAPTURED] ? STAMP_CAPTURED : STAMP_START;
+        if ((v = span_ms(r, from, STAMP_PREPROCESSED)) >= 0) preprocess.push_back(v);
+        if ((v = span_ms(r, STAMP_PREPROCESSED, STAMP_SUBMITTED)) >= 0) queue.push_back(v);
+        if ((v = span_ms(r, STAMP_SUBMITTED, STAMP_ANSWERED)) >= 0) link.push_back(v);
+        if ((v = span_ms(r, STAMP_ANSWERED, STAMP_PUBLISHED)) >= 0) publish.push_back(v);
+        if (r.status == INFER_OK && (v = span_ms(r, STAMP_START, STAMP_PUBLISHED)) >= 0) {
+            total.push_back(v);
+            if (r.thermal_level < THERMAL_LEVEL_COUNT) total_by_level[r.thermal_level].push_back(v);
+        }
+
+        if (r.status == INFER_OK) {
+            BoardSummary &b = boards[r.board];
+            b.answered++;
+            b.latency_us += r.link_latency_us;
+            b.crc_errors = std::max(b.crc_errors, r.crc_errors);
+            if (r.attempts > 1) b.retried++;
+            if (r.digit >= 0 && r.digit < TELEMETRY_SOFTMAX) {
+                digits[r.digit]++;
+                confidence[r.digit] += r.softmax[r.digit] / 65535.0;
+            }
+        }
+    }
+
+    std::cout << all.size() << " records from " << files.size() << " segment(s)";
+    if (!all.empty()) std::cout << ", seq " << all.front().seq << ".." << all.back().seq;
+    std::cout << "\n\nOutcomes:\n";
+    for (auto &entry : statuses)
+        std::cout << "  " << std::left << std::setw(14) << inference_status_name(entry.first) << std::right << entry.second << "\n";
+    std::cout << "Timeouts by stage:\n";
+    for (int s = 0; s < STAGE_COUNT; s++)
+        std::cout << "  " << std::left << std::setw(14) << stage_name(s) << std::right << timeouts[s] << "\n";
+
+    std::cout << "Stage latency:\n";
+    print_percentiles("capture", capture);
+    print_percentiles("preprocess", preprocess);
+    print_percentiles("queue", queue);
+    print_percentiles("link", link);
+    print_percentiles("publish", publish);
+    print_percentiles("total (ok)", total);
+
+    std::cout << "Boards:\n";
+    for (auto &entry : boards) {
+        const BoardSummary &b = entry.second;
+        std::cout << "  " << std::setw(3) << entry.first << "  answered " << std::setw(6) << b.answered
+                  << "  mean link " << std::fixed << std::setprecision(0) << std::setw(6) << b.latency_us / b.answered << " us"
+                  << "  retried " << b.retried << "  crc errors " << b.crc_errors << "\n";
+    }
+
+    std::cout << "Digits:\n";
+    for (int d = 0; d < TELEMETRY_SOFTMAX; d++) {
+        std::cout << "  " << d << "  " << std::setw(6) << digits[d];
+        if (digits[d]) std::cout << "  mean p " << std::fixed << std::setprecision(3) << confidence[d] / digits[d];
+        std::cout << "\n";
+    }
+
+    std::cout << "Thermal:\n";
+    if (thermal.empty()) {
+        std::cout << "  no samples\n";
+        return 0;
+    }
+    int32_t temp_min = INT32_MAX, temp_max = INT32_MIN;
+    uint32_t freq_min = UINT32_MAX, freq_max = 0, flags = 0;
+    uint64_t at_level[THERMAL_LEVEL_COUNT] = {};
+    for (const ThermalRecord &t : thermal) {
+        temp_min = std::min(temp_min, t.temp_mc);
+        temp_max = std::max(temp_max, t.temp_mc);
+        freq_min = std::min(freq_min, t.freq_khz);
+        freq_max = std::max(freq_max, t.freq_khz);
+        flags |= t.throttled;
+        if (t.level < THERMAL_LEVEL_COUNT) at_level[t.level]++;
+    }
+    std::cout << "  " << thermal.size() << " samples, " << std::fixed << std::setprecision(1)
+              << temp_min / 1000.0 << "-" << temp_max / 1000.0 << " C, "
+              << freq_min / 1000 << "-" << freq_max / 1000 << " MHz, throttle flags seen 0x" << std::hex << flags << std::dec;
+    if (flags & THROTTLE_UNDERVOLTAGE) std::cout << " under-voltage";
+    if (flags & THROTTLE_FREQ_CAPPED) std::cout << " capped";
+    if (flags & THROTTLE_THROTTLED) std::cout << " throttled";
+    if (flags & THROTTLE_SOFT_TEMP) std::cout << " soft-limit";
+    std::cout << "\n";
+    for (int l = 0; l < THERMAL_LEVEL_COUNT; l++) {
+        std::cout << "  " << std::left << std::setw(8) << level_name(l) << std::right << std::setw(6) << at_level[l] << " samples\n";
+    }
+    std::cout << "Total latency (ok) by thermal level:\n";
+    for (int l = 0; l < THERMAL_LEVEL_COUNT; l++)
+        print_percentiles(level_name(l), total_by_level[l]);
+    return 0;
+}